@@ -0,0 +1,155 @@
+#include "BddSerializer.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace ClassProject {
+
+static const char BddMagic[4] = {'V', 'D', 'S', 'B'};
+
+BddWriter::BddWriter(std::ostream &out, ManagerInterface &mgr)
+    : out(out)
+    , mgr(mgr)
+{
+    out.write(BddMagic, sizeof(BddMagic));
+    writeVarint(BddFormatVersion);
+}
+
+void BddWriter::write(const std::string &name, BDD_ID root) {
+    // Iterative post-order traversal, successors are written before their parents
+    std::vector<std::pair<BDD_ID, bool>> stack{{root, false}};
+    while (!stack.empty()) {
+        auto [id, expanded] = stack.back();
+        stack.pop_back();
+        if (mgr.isConstant(id) || nodeIndex.count(id)) {
+            continue;
+        }
+        if (!expanded) {
+            stack.emplace_back(id, true);
+            stack.emplace_back(mgr.coFactorFalse(id), false);
+            stack.emplace_back(mgr.coFactorTrue(id), false);
+            continue;
+        }
+        BDD_ID var = mgr.topVar(id);
+        auto var_it = varIndex.find(var);
+        if (var_it == varIndex.end()) {
+            out.put('V');
+            writeString(mgr.getTopVarName(var));
+            var_it = varIndex.emplace(var, varIndex.size()).first;
+        }
+        uint64_t index = nodeIndex.size();
+        BDD_ID high = mgr.coFactorTrue(id);
+        BDD_ID low = mgr.coFactorFalse(id);
+        out.put('N');
+        writeVarint(var_it->second);
+        writeVarint(mgr.isConstant(high) ? high : 1 + index - nodeIndex.at(high));
+        writeVarint(mgr.isConstant(low) ? low : 1 + index - nodeIndex.at(low));
+        nodeIndex.emplace(id, index);
+    }
+    out.put('R');
+    writeString(name);
+    writeVarint(ref(root));
+}
+
+void BddWriter::finish() {
+    out.put('E');
+    out.flush();
+}
+
+size_t BddWriter::nodeCount() const {
+    return nodeIndex.size();
+}
+
+void BddWriter::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+void BddWriter::writeString(const std::string &str) {
+    writeVarint(str.size());
+    out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+uint64_t BddWriter::ref(BDD_ID id) const {
+    return mgr.isConstant(id) ? id : 2 + nodeIndex.at(id);
+}
+
+static uint64_t readVarint(std::istream &in) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            throw std::runtime_error("BddReader: unexpected end of file");
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("BddReader: malformed varint");
+}
+
+static std::string readString(std::istream &in) {
+    std::string str(readVarint(in), '\0');
+    if (!in.read(str.data(), static_cast<std::streamsize>(str.size()))) {
+        throw std::runtime_error("BddReader: unexpected end of file");
+    }
+    return str;
+}
+
+std::vector<std::pair<std::string, BDD_ID>> BddReader::read(std::istream &in, ManagerInterface &mgr) {
+    char magic[sizeof(BddMagic)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), BddMagic)) {
+        throw std::runtime_error("BddReader: not a BDD file");
+    }
+    uint64_t version = readVarint(in);
+    if (version != BddFormatVersion) {
+        throw std::runtime_error("BddReader: unsupported format version " + std::to_string(version));
+    }
+
+    std::vector<BDD_ID> vars;
+    std::vector<BDD_ID> nodes;
+    std::vector<std::pair<std::string, BDD_ID>> roots;
+    auto successor = [&](uint64_t ref) -> BDD_ID {
+        if (ref <= mgr.True()) {
+            return ref;
+        }
+        if (ref - 1 > nodes.size()) {
+            throw std::runtime_error("BddReader: invalid successor");
+        }
+        return nodes[nodes.size() - (ref - 1)];
+    };
+
+    while (true) {
+        int tag = in.get();
+        if (tag == 'V') {
+            vars.push_back(mgr.createVar(readString(in)));
+        } else if (tag == 'N') {
+            uint64_t var = readVarint(in);
+            if (var >= vars.size()) {
+                throw std::runtime_error("BddReader: invalid variable");
+            }
+            BDD_ID high = successor(readVarint(in));
+            BDD_ID low = successor(readVarint(in));
+            nodes.push_back(mgr.ite(vars[var], high, low));
+        } else if (tag == 'R') {
+            std::string name = readString(in);
+            uint64_t ref = readVarint(in);
+            if (ref > mgr.True() && ref - 2 >= nodes.size()) {
+                throw std::runtime_error("BddReader: invalid root");
+            }
+            roots.emplace_back(std::move(name), ref <= mgr.True() ? ref : nodes[ref - 2]);
+        } else if (tag == 'E') {
+            return roots;
+        } else if (tag == std::char_traits<char>::eof()) {
+            throw std::runtime_error("BddReader: unexpected end of file");
+        } else {
+            throw std::runtime_error("BddReader: invalid record");
+        }
+    }
+}
+
+} // namespace ClassProject
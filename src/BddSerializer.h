@@ -0,0 +1,85 @@
+// Binary serialization of named BDD roots
+//
+// File layout (all integers are LEB128 varints unless noted otherwise):
+//   header  "VDSB" (4 bytes), format version
+//   records tag byte followed by the payload
+//     'V' label                    variable, numbered in order of appearance
+//     'N' var high low             node, numbered in order of appearance
+//     'R' name ref                 named root
+//     'E'                          end of file
+// Nodes are written in topological order (successors first). A successor ref is 0 for False, 1 for True,
+// otherwise 1 + the distance back to the successor node. Root refs are 0/1 for the terminals,
+// otherwise 2 + the node number.
+
+#ifndef VDSPROJECT_BDDSERIALIZER_H
+#define VDSPROJECT_BDDSERIALIZER_H
+
+#include "ManagerInterface.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+namespace ClassProject {
+
+static const uint32_t BddFormatVersion = 1;
+
+/**
+ * @brief Streaming writer for the binary BDD format
+ * Nodes shared between roots are written only once.
+ */
+class BddWriter {
+public:
+    /**
+     * @brief Writes the header to the stream
+     * @param out The output stream, should be opened in binary mode
+     * @param mgr The manager owning the BDDs
+     */
+    BddWriter(std::ostream &out, ManagerInterface &mgr);
+
+    /**
+     * @brief Writes all not yet written nodes of the BDD and the named root
+     */
+    void write(const std::string &name, BDD_ID root);
+
+    /**
+     * @brief Writes the end marker, the writer must not be used afterwards
+     */
+    void finish();
+
+    /**
+     * @brief Returns the number of nodes written so far (without terminals)
+     */
+    size_t nodeCount() const;
+
+private:
+    void writeVarint(uint64_t value);
+    void writeString(const std::string &str);
+    uint64_t ref(BDD_ID id) const;
+
+    std::ostream &out;
+    ManagerInterface &mgr;
+    std::unordered_map<BDD_ID, uint64_t> varIndex;  ///< BDD_ID of a variable -> number in the file
+    std::unordered_map<BDD_ID, uint64_t> nodeIndex; ///< BDD_ID of a node -> number in the file
+};
+
+/**
+ * @brief Loader for the binary BDD format
+ * The BDDs are rebuilt with ite, so the target manager may already contain nodes and use another variable order.
+ */
+class BddReader {
+public:
+    /**
+     * @brief Reads all roots from the stream into the manager
+     * @return The named roots in the order they were written
+     * @throws std::runtime_error if the stream is not a valid BDD file
+     */
+    static std::vector<std::pair<std::string, BDD_ID>> read(std::istream &in, ManagerInterface &mgr);
+};
+
+} // namespace ClassProject
+
+#endif
@@ -1,4 +1,5 @@
 #include "Manager.h"
+#include "Tracer.h"
 
 #include <iostream>
 #include <set>
@@ -6,6 +7,20 @@
 #include <unordered_map>
 #include <array>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #if CLASSPROJECT_VISUALIZE == 1 && CLASSPROJECT_GRAPHVIZ == 1
 #include <graphviz/gvc.h>
@@ -18,6 +33,13 @@ namespace ClassProject {
 static GVC_t *gvc = gvContext();
 #endif
 
+// Updates an operation statistics counter, compiled out if CLASSPROJECT_STATS is 0
+#if CLASSPROJECT_STATS == 1
+#define CLASSPROJECT_COUNT(statement) statement
+#else
+#define CLASSPROJECT_COUNT(statement)
+#endif
+
 Manager::Manager()
     : nextID(2)
 #if CLASSPROJECT_USECACHE == 1
@@ -26,27 +48,365 @@ Manager::Manager()
     , coFalseCache(std::bind(&Manager::coFactorFalse_impl, this, std::placeholders::_1, std::placeholders::_2))
 #endif
 {
-    uniqueTable.emplace(True(), Node{True(), True(), True()});
-    reverseTable.emplace(Node{True(), True(), True()}, True());
-    uniqueTable.emplace(False(), Node{False(), False(), False()});
-    reverseTable.emplace(Node{False(), False(), False()}, False());
-    labelTable.emplace(True(), "True");
-    reverselabelTable.emplace("True", True());
-    labelTable.emplace(False(), "False");
-    reverselabelTable.emplace("False", False());
+    // Adds the terminal nodes
+    clear();
+#if CLASSPROJECT_USECACHE == 1
+    sampleMask = std::max<BDD_ID>(MinSampleInterval, std::min<BDD_ID>(SampleInterval, iteCache.capacity())) - 1;
+#endif
+}
+
+Manager::Manager(const Manager &mgr)
+    : Manager()
+{
+    *this = mgr;
+}
+
+Manager::Manager(Manager &&mgr)
+    : Manager()
+{
+    *this = std::move(mgr);
+}
+
+Manager Manager::fork() {
+    if (opDepth > 0) {
+        throw std::logic_error("fork: called while an operation is running");
+    }
+    freeze();
+    Manager child;
+    child.store = store;
+    child.uniqueTable = NodeVector(MappedAllocator<Node>(store));
+    child.reverseTable = NodeMap(0, NodeHash(), std::equal_to<Node>(), MappedAllocator<Node>(store));
+    child.base = base;
+    child.baseSize = baseSize;
+    child.labelTable = labelTable;
+    child.reverselabelTable = reverselabelTable;
+    child.nextID = nextID;
+    child.engine = engine;
+    child.setLimits(limits);
+    child.setCachePolicy(cachePolicy);
+    return child;
+}
+
+void Manager::freeze() {
+    if (uniqueTable.empty()) {
+        return;
+    }
+    auto segment = std::make_shared<Segment>();
+    segment->parent = base;
+    segment->begin = baseSize;
+    segment->end = nextID;
+    segment->storage = std::move(uniqueTable);
+    segment->nodes = segment->storage.data();
+    segment->reverse = std::move(reverseTable);
+    uniqueTable = NodeVector(MappedAllocator<Node>(store));
+    reverseTable = NodeMap(0, NodeHash(), std::equal_to<Node>(), MappedAllocator<Node>(store));
+    base = std::move(segment);
+    baseSize = nextID;
+}
+
+const Manager::Node &Manager::Segment::node(BDD_ID id) const {
+    const Segment *segment = this;
+    while (id < segment->begin) {
+        segment = segment->parent.get();
+    }
+    return segment->nodes[id - segment->begin];
+}
+
+// Snapshot file layout, all fields are 64 bit words in host byte order:
+//   header   SnapshotHeader
+//   nodes    nodeCount x (topVar, high, low)
+//   levels   levelCount x (topVar, first slot, slot mask), sorted by topVar
+//   index    indexSize slots holding BDD_ID + 1 (0 = empty), one open-addressing hash table per level
+//   labels   labelCount x (BDD_ID, arena offset, length)
+//   roots    rootCount x (BDD_ID, arena offset, length)
+//   arena    characters of the labels and root names
+static const char SnapshotMagic[8] = {'V', 'D', 'S', 'S', 'N', 'A', 'P', '\0'};
+static const uint64_t SnapshotVersion = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t version;
+    uint64_t nodeCount;
+    uint64_t levelCount;
+    uint64_t indexSize;
+    uint64_t labelCount;
+    uint64_t rootCount;
+    uint64_t arenaSize;
+};
+
+struct SnapshotLevel {
+    uint64_t topVar;
+    uint64_t first;
+    uint64_t mask;
+};
+
+struct SnapshotString {
+    uint64_t id;
+    uint64_t offset;
+    uint64_t length;
+};
+
+static_assert(sizeof(BDD_ID) == sizeof(uint64_t), "snapshots store BDD_IDs as 64 bit words");
+
+struct Manager::Snapshot {
+    static_assert(sizeof(Node) == 3 * sizeof(uint64_t), "snapshots store nodes as three 64 bit words");
+
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    const SnapshotHeader *header = nullptr;
+    const Node *nodes = nullptr;
+    const SnapshotLevel *levels = nullptr;
+    const uint64_t *index = nullptr;
+    const SnapshotString *labels = nullptr;
+    const SnapshotString *roots = nullptr;
+    const char *arena = nullptr;
+
+    Snapshot() = default;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    ~Snapshot() {
+        if (data != MAP_FAILED) {
+            munmap(data, size);
+        }
+    }
+
+    std::string string(const SnapshotString &str) const {
+        return std::string(arena + str.offset, str.length);
+    }
+
+    bool find(const Node &node, BDD_ID &id) const {
+        const SnapshotLevel *end = levels + header->levelCount;
+        const SnapshotLevel *level = std::lower_bound(levels, end, node.topVar,
+            [](const SnapshotLevel &l, BDD_ID topVar) { return l.topVar < topVar; });
+        if (level == end || level->topVar != node.topVar) {
+            return false;
+        }
+        // Bounded by the slots of the level, a damaged index may have no empty slot
+        uint64_t slot = NodeHash()(node) & level->mask;
+        for (uint64_t probe = 0; probe <= level->mask; probe++, slot = (slot + 1) & level->mask) {
+            uint64_t entry = index[level->first + slot];
+            if (entry == 0 || entry > header->nodeCount) {
+                return false;
+            }
+            if (nodes[entry - 1] == node) {
+                id = entry - 1;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+bool Manager::Segment::find(const Node &node, BDD_ID &id) const {
+    for (const Segment *segment = this; segment; segment = segment->parent.get()) {
+        if (segment->snapshot) {
+            if (segment->snapshot->find(node, id)) {
+                return true;
+            }
+            continue;
+        }
+        auto it = segment->reverse.find(node);
+        if (it != segment->reverse.end()) {
+            id = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Manager::saveSnapshot(const std::string &path, const std::vector<std::pair<std::string, BDD_ID>> &roots) {
+    TraceSpan span("saveSnapshot", "dump");
+    if (opDepth > 0) {
+        throw std::logic_error("saveSnapshot: called while an operation is running");
+    }
+
+    // One hash table per level with a load factor of at most 1/2
+    std::map<BDD_ID, SnapshotLevel> levels;
+    for (BDD_ID id = 0; id < nextID; id++) {
+        levels[getNode(id).topVar].mask++;
+    }
+    uint64_t indexSize = 0;
+    for (auto &entry : levels) {
+        uint64_t slots = 2;
+        while (slots < 2 * entry.second.mask) {
+            slots *= 2;
+        }
+        entry.second.topVar = entry.first;
+        entry.second.first = indexSize;
+        entry.second.mask = slots - 1;
+        indexSize += slots;
+    }
+    std::vector<uint64_t> index(indexSize, 0);
+    for (BDD_ID id = 0; id < nextID; id++) {
+        const Node &node = getNode(id);
+        const SnapshotLevel &level = levels[node.topVar];
+        uint64_t slot = NodeHash()(node) & level.mask;
+        while (index[level.first + slot] != 0) {
+            slot = (slot + 1) & level.mask;
+        }
+        index[level.first + slot] = id + 1;
+    }
+
+    std::string arena;
+    std::vector<SnapshotString> labels;
+    for (const auto &entry : labelTable) {
+        labels.push_back(SnapshotString{entry.first, arena.size(), entry.second.size()});
+        arena += entry.second;
+    }
+    std::vector<SnapshotString> names;
+    for (const auto &root : roots) {
+        names.push_back(SnapshotString{root.second, arena.size(), root.first.size()});
+        arena += root.first;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("saveSnapshot: unable to open " + path);
+    }
+    SnapshotHeader header{};
+    std::copy(SnapshotMagic, SnapshotMagic + sizeof(SnapshotMagic), header.magic);
+    header.version = SnapshotVersion;
+    header.nodeCount = nextID;
+    header.levelCount = levels.size();
+    header.indexSize = indexSize;
+    header.labelCount = labels.size();
+    header.rootCount = names.size();
+    header.arenaSize = arena.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (BDD_ID id = 0; id < nextID; id++) {
+        out.write(reinterpret_cast<const char *>(&getNode(id)), sizeof(Node));
+    }
+    for (const auto &entry : levels) {
+        out.write(reinterpret_cast<const char *>(&entry.second), sizeof(SnapshotLevel));
+    }
+    out.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char *>(labels.data()), labels.size() * sizeof(SnapshotString));
+    out.write(reinterpret_cast<const char *>(names.data()), names.size() * sizeof(SnapshotString));
+    out.write(arena.data(), arena.size());
+    if (!out.flush()) {
+        throw std::runtime_error("saveSnapshot: unable to write " + path);
+    }
+}
+
+Manager Manager::mapSnapshot(const std::string &path, std::vector<std::pair<std::string, BDD_ID>> *roots) {
+    auto snapshot = std::make_shared<Snapshot>();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("mapSnapshot: unable to open " + path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        snapshot->size = static_cast<size_t>(st.st_size);
+        snapshot->data = mmap(nullptr, snapshot->size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (snapshot->data == MAP_FAILED) {
+        throw std::runtime_error("mapSnapshot: unable to map " + path);
+    }
+
+    // Locate and validate the sections, the byte order is checked implicitly by the version
+    const char *data = static_cast<const char *>(snapshot->data);
+    auto header = reinterpret_cast<const SnapshotHeader *>(data);
+    if (snapshot->size < sizeof(SnapshotHeader)
+        || !std::equal(SnapshotMagic, SnapshotMagic + sizeof(SnapshotMagic), header->magic)
+        || header->version != SnapshotVersion) {
+        throw std::runtime_error("mapSnapshot: " + path + " is not a snapshot of this version");
+    }
+    size_t offset = sizeof(SnapshotHeader);
+    auto section = [&](uint64_t count, size_t size) {
+        const char *begin = data + offset;
+        if (count > (snapshot->size - offset) / size) {
+            throw std::runtime_error("mapSnapshot: " + path + " is truncated");
+        }
+        offset += count * size;
+        return begin;
+    };
+    snapshot->header = header;
+    snapshot->nodes = reinterpret_cast<const Node *>(section(header->nodeCount, sizeof(Node)));
+    snapshot->levels = reinterpret_cast<const SnapshotLevel *>(section(header->levelCount, sizeof(SnapshotLevel)));
+    snapshot->index = reinterpret_cast<const uint64_t *>(section(header->indexSize, sizeof(uint64_t)));
+    snapshot->labels = reinterpret_cast<const SnapshotString *>(section(header->labelCount, sizeof(SnapshotString)));
+    snapshot->roots = reinterpret_cast<const SnapshotString *>(section(header->rootCount, sizeof(SnapshotString)));
+    snapshot->arena = section(header->arenaSize, 1);
+    if (header->nodeCount < 2) {
+        throw std::runtime_error("mapSnapshot: " + path + " has no terminal nodes");
+    }
+    // The terminals refer to themselves, every other node to earlier nodes only, so walks terminate
+    const Node *nodes = snapshot->nodes;
+    if (!(nodes[FalseId] == Node{FalseId, FalseId, FalseId}) || !(nodes[TrueId] == Node{TrueId, TrueId, TrueId})) {
+        throw std::runtime_error("mapSnapshot: " + path + " has invalid terminal nodes");
+    }
+    for (uint64_t i = 2; i < header->nodeCount; i++) {
+        const Node &node = nodes[i];
+        if (node.high >= i || node.low >= i) {
+            throw std::runtime_error("mapSnapshot: " + path + " has a node with an invalid child");
+        }
+        const Node &var = nodes[std::min<uint64_t>(node.topVar, i)];
+        if (node.topVar > i || node.topVar < 2 || var.topVar != node.topVar || var.high != TrueId || var.low != FalseId) {
+            throw std::runtime_error("mapSnapshot: " + path + " has a node with an invalid variable");
+        }
+    }
+    for (uint64_t i = 0; i < header->levelCount; i++) {
+        const SnapshotLevel &level = snapshot->levels[i];
+        if ((level.mask & (level.mask + 1)) != 0 || level.first > header->indexSize
+            || level.mask >= header->indexSize - level.first || (i > 0 && snapshot->levels[i - 1].topVar >= level.topVar)) {
+            throw std::runtime_error("mapSnapshot: " + path + " has an invalid level index");
+        }
+    }
+
+    Manager mgr;
+    mgr.uniqueTable.clear();
+    mgr.reverseTable.clear();
+    mgr.labelTable.clear();
+    mgr.reverselabelTable.clear();
+    for (uint64_t i = 0; i < header->labelCount; i++) {
+        const SnapshotString &label = snapshot->labels[i];
+        if (label.id >= header->nodeCount || label.offset > header->arenaSize || label.length > header->arenaSize - label.offset) {
+            throw std::runtime_error("mapSnapshot: " + path + " has an invalid label");
+        }
+        mgr.labelTable.emplace(label.id, snapshot->string(label));
+        mgr.reverselabelTable.emplace(snapshot->string(label), label.id);
+    }
+    if (roots) {
+        roots->clear();
+        for (uint64_t i = 0; i < header->rootCount; i++) {
+            const SnapshotString &root = snapshot->roots[i];
+            if (root.id >= header->nodeCount || root.offset > header->arenaSize || root.length > header->arenaSize - root.offset) {
+                throw std::runtime_error("mapSnapshot: " + path + " has an invalid root");
+            }
+            roots->emplace_back(snapshot->string(root), root.id);
+        }
+    }
+
+    auto segment = std::make_shared<Segment>();
+    segment->begin = 0;
+    segment->end = header->nodeCount;
+    segment->nodes = snapshot->nodes;
+    segment->snapshot = std::move(snapshot);
+    mgr.base = std::move(segment);
+    mgr.baseSize = mgr.base->end;
+    mgr.nextID = mgr.base->end;
+    return mgr;
 }
 
 BDD_ID Manager::createVar(const std::string &label) {
     auto it = reverselabelTable.find(label);
+    BDD_ID id;
     if (it == reverselabelTable.end()) {
-        uniqueTable.emplace(nextID, Node{nextID, True(), False()});
+        uniqueTable.push_back(Node{nextID, True(), False()});
         reverseTable.emplace(Node{nextID, True(), False()}, nextID);
         labelTable.emplace(nextID, label); // label + " ? 1 : 0";
         reverselabelTable.emplace(label, nextID);
-        return nextID++;
+        CLASSPROJECT_COUNT(statistics.nodesCreated++);
+        CLASSPROJECT_COUNT(statistics.peakNodes = std::max(statistics.peakNodes, nextID + 1));
+        id = nextID++;
     } else {
-        return it->second;
+        id = it->second;
     }
+    if (recordingOperation()) {
+        recording.recorder->writeVar(label, id);
+    }
+    return id;
 }
 
 const BDD_ID &Manager::True() {
@@ -62,14 +422,19 @@ bool Manager::isConstant(BDD_ID f) {
 }
 
 bool Manager::isVariable(BDD_ID x) {
-    return uniqueTable.at(x).topVar == x && !isConstant(x);
+    return getNode(x).topVar == x && !isConstant(x);
 }
 
 BDD_ID Manager::topVar(BDD_ID f) {
-    return uniqueTable.at(f).topVar;
+    return getNode(f).topVar;
 }
 
 BDD_ID Manager::ite_impl(BDD_ID i, BDD_ID t, BDD_ID e) {
+    CLASSPROJECT_COUNT(statistics.iteExpansions++);
+    if (budgetActive && (++steps & 0x3FF) == 0) {
+        checkTimeBudget();
+    }
+
     // Find the top variable with the lowest index
     BDD_ID top = topVar(i);
     if (topVar(t) < top && isVariable(topVar(t))){
@@ -88,11 +453,29 @@ BDD_ID Manager::ite_impl(BDD_ID i, BDD_ID t, BDD_ID e) {
         return high;
     }
 
-    // Check if the node already exists
+    return makeNode(top, high, low);
+}
+
+BDD_ID Manager::makeNode(BDD_ID top, BDD_ID high, BDD_ID low) {
+    CLASSPROJECT_COUNT(statistics.uniqueLookups++);
+    // Check if the node already exists, in the own nodes or in the shared base
     auto it = reverseTable.find(Node{top, high, low});
+    BDD_ID id;
+    if (it == reverseTable.end() && base && base->find(Node{top, high, low}, id)) {
+        CLASSPROJECT_COUNT(statistics.uniqueHits++);
+        return id;
+    }
     if (it == reverseTable.end()) {
+        if (budgetActive) {
+            checkNodeBudget();
+        }
+        CLASSPROJECT_COUNT(statistics.nodesCreated++);
+        CLASSPROJECT_COUNT(statistics.peakNodes = std::max(statistics.peakNodes, nextID + 1));
+        if ((nextID & sampleMask) == 0) {
+            sample();
+        }
         // add node
-        uniqueTable.emplace(nextID, Node{top, high, low});
+        uniqueTable.push_back(Node{top, high, low});
         reverseTable.emplace(Node{top, high, low}, nextID);
 #if CLASSPROJECT_VISUALIZE == 1 && CLASSPROJECT_VISUALIZE_FUNCTIONS == 1
         // add label
@@ -103,11 +486,15 @@ BDD_ID Manager::ite_impl(BDD_ID i, BDD_ID t, BDD_ID e) {
         return nextID++;
     } else {
         // node found
+        CLASSPROJECT_COUNT(statistics.uniqueHits++);
         return it->second;
     }
 }
 
 BDD_ID Manager::ite(BDD_ID i, BDD_ID t, BDD_ID e) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Ite, {i, t, e}, [&] { return ite(i, t, e); });
+    }
     // Terminal cases
     if (i == True()) {
         return t;
@@ -118,6 +505,21 @@ BDD_ID Manager::ite(BDD_ID i, BDD_ID t, BDD_ID e) {
     } else if (t == True() && e == False()) {
         return i;
     } else {
+        // The outermost call of an operation arms the deadline of the time budget
+        if (opDepth == 0 && budgetActive && limits.timeout.count() > 0) {
+            deadline = std::chrono::steady_clock::now() + limits.timeout;
+        }
+        struct DepthGuard {
+            size_t &depth;
+            explicit DepthGuard(size_t &depth) : depth(depth) { ++depth; }
+            ~DepthGuard() { --depth; }
+        } guard(opDepth);
+        CLASSPROJECT_COUNT(statistics.maxDepth = std::max(statistics.maxDepth, opDepth));
+        if (engine == ApplyEngine::BreadthFirst && opDepth == 1) {
+            // Counts its requests like the recursive calls of the depth-first engine
+            return ite_bfs(i, t, e);
+        }
+        CLASSPROJECT_COUNT(statistics.iteCalls++);
 #if CLASSPROJECT_USECACHE == 1
         return iteCache(i, t, e);
 #else
@@ -126,32 +528,180 @@ BDD_ID Manager::ite(BDD_ID i, BDD_ID t, BDD_ID e) {
     }
 }
 
+BDD_ID Manager::ite_bfs(BDD_ID i, BDD_ID t, BDD_ID e) {
+    std::vector<Request> &requests = bfs.requests;
+    requests.clear();
+    for (size_t level = 0; level < bfs.levelCount; level++) {
+        bfs.levels[level].clear();
+    }
+    bfs.levelCount = 0;
+    bfs.levelOrder.clear();
+    // Empty all pending slots, they are zeroed once every 2^32 calls
+    if (++bfs.epoch == 0) {
+        std::fill(bfs.pending.begin(), bfs.pending.end(), BfsScratch::Slot{});
+        bfs.epoch = 1;
+    }
+    if (bfs.pending.empty()) {
+        bfs.pending.resize(1024);
+    }
+
+    auto slotOf = [this](const Request &r) {
+        uint64_t hash = NodeHash()(Node{r.i, r.t, r.e}) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash >> 32) & (bfs.pending.size() - 1);
+    };
+    // Returns the pending request with these arguments, or the empty slot to insert it into
+    auto findPending = [&](const Request &r) -> BfsScratch::Slot & {
+        size_t mask = bfs.pending.size() - 1;
+        for (size_t s = slotOf(r);; s = (s + 1) & mask) {
+            BfsScratch::Slot &slot = bfs.pending[s];
+            if (slot.epoch != bfs.epoch) {
+                return slot;
+            }
+            const Request &other = requests[slot.request];
+            if (other.i == r.i && other.t == r.t && other.e == r.e) {
+                return slot;
+            }
+        }
+    };
+    // Request indices of the level of a top variable, new levels are inserted in the order of the variables
+    auto level = [&](BDD_ID top) -> std::vector<size_t> & {
+        auto it = std::lower_bound(bfs.levelOrder.begin(), bfs.levelOrder.end(), top,
+                                   [](const std::pair<BDD_ID, size_t> &entry, BDD_ID var) { return entry.first < var; });
+        if (it == bfs.levelOrder.end() || it->first != top) {
+            if (bfs.levelCount == bfs.levels.size()) {
+                bfs.levels.emplace_back();
+            }
+            it = bfs.levelOrder.insert(it, {top, bfs.levelCount++});
+        }
+        return bfs.levels[it->second];
+    };
+
+    // Resolves terminal cases, pending requests and cached results, otherwise returns the flagged index of a new request
+    auto request = [&](BDD_ID i, BDD_ID t, BDD_ID e) -> BDD_ID {
+        if (i == True()) {
+            return t;
+        } else if (i == False()) {
+            return e;
+        } else if (t == e) {
+            return t;
+        } else if (t == True() && e == False()) {
+            return i;
+        }
+        CLASSPROJECT_COUNT(statistics.iteCalls++);
+        Request r{i, t, e, 0, 0, 0};
+        BfsScratch::Slot *slot = &findPending(r);
+        if (slot->epoch == bfs.epoch) {
+            return slot->request | RequestFlag;
+        }
+#if CLASSPROJECT_USECACHE == 1
+        BDD_ID cached;
+        if (iteCache.lookup(cached, i, t, e)) {
+            return cached;
+        }
+#endif
+        CLASSPROJECT_COUNT(statistics.iteExpansions++);
+        // Keep the pending table at most half full
+        if (2 * (requests.size() + 1) > bfs.pending.size()) {
+            std::vector<BfsScratch::Slot>(2 * bfs.pending.size()).swap(bfs.pending);
+            for (uint32_t index = 0; index < requests.size(); index++) {
+                findPending(requests[index]) = BfsScratch::Slot{bfs.epoch, index};
+            }
+            slot = &findPending(r);
+        }
+        size_t index = requests.size();
+        *slot = BfsScratch::Slot{bfs.epoch, static_cast<uint32_t>(index)};
+        requests.push_back(r);
+        BDD_ID top = topVar(i);
+        if (topVar(t) < top && isVariable(topVar(t))) {
+            top = topVar(t);
+        }
+        if (topVar(e) < top && isVariable(topVar(e))) {
+            top = topVar(e);
+        }
+        level(top).push_back(index);
+        return index | RequestFlag;
+    };
+    auto resolve = [&](BDD_ID ref) {
+        return (ref & RequestFlag) ? requests[ref & ~RequestFlag].result : ref;
+    };
+
+    BDD_ID root = request(i, t, e);
+
+    // Expand top-down: the successors of a request always belong to a later level, so levels are only
+    // inserted behind the one being expanded
+    for (size_t k = 0; k < bfs.levelOrder.size(); k++) {
+        BDD_ID top = bfs.levelOrder[k].first;
+        size_t current = bfs.levelOrder[k].second;
+        if (store) {
+            // Read the pages of all own operand nodes of the level ahead, instead of faulting them in one by one
+            bfs.prefetch.clear();
+            for (size_t index : bfs.levels[current]) {
+                for (BDD_ID f : {requests[index].i, requests[index].t, requests[index].e}) {
+                    if (f >= baseSize) {
+                        bfs.prefetch.push_back(&uniqueTable[f - baseSize]);
+                    }
+                }
+            }
+            store->prefetch(bfs.prefetch);
+        }
+        for (size_t n = 0; n < bfs.levels[current].size(); n++) {
+            if (budgetActive && (++steps & 0x3FF) == 0) {
+                checkTimeBudget();
+            }
+            size_t index = bfs.levels[current][n];
+            BDD_ID ri = requests[index].i, rt = requests[index].t, re = requests[index].e;
+            BDD_ID high = request(coFactorTrue(ri, top), coFactorTrue(rt, top), coFactorTrue(re, top));
+            BDD_ID low = request(coFactorFalse(ri, top), coFactorFalse(rt, top), coFactorFalse(re, top));
+            requests[index].high = high;
+            requests[index].low = low;
+        }
+    }
+
+    // Reduce bottom-up: all successors of a level are resolved before the level itself
+    for (size_t k = bfs.levelOrder.size(); k-- > 0;) {
+        BDD_ID top = bfs.levelOrder[k].first;
+        for (size_t index : bfs.levels[bfs.levelOrder[k].second]) {
+            Request &r = requests[index];
+            BDD_ID high = resolve(r.high);
+            BDD_ID low = resolve(r.low);
+            r.result = (high == low) ? high : makeNode(top, high, low);
+        }
+    }
+
+    BDD_ID result = resolve(root);
+#if CLASSPROJECT_USECACHE == 1
+    iteCache.insert(result, i, t, e);
+#endif
+    return result;
+}
+
+size_t Manager::BfsScratch::memoryUsage() const {
+    size_t bytes = requests.capacity() * sizeof(Request) + levels.capacity() * sizeof(std::vector<size_t>)
+                   + levelOrder.capacity() * sizeof(std::pair<BDD_ID, size_t>) + pending.capacity() * sizeof(Slot)
+                   + prefetch.capacity() * sizeof(const void *);
+    for (const auto &level : levels) {
+        bytes += level.capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
 BDD_ID Manager::coFactorTrue_impl(BDD_ID f, BDD_ID x) {
-    BDD_ID high = coFactorTrue(uniqueTable.at(f).high, x);
-    BDD_ID low = coFactorTrue(uniqueTable.at(f).low, x);
+    BDD_ID high = coFactorTrue(getNode(f).high, x);
+    BDD_ID low = coFactorTrue(getNode(f).low, x);
     if (high == low) {
         return high;
     }
-    auto it = reverseTable.find(Node{topVar(f), high, low});
-    if (it == reverseTable.end()) {
-        uniqueTable.emplace(nextID, Node{topVar(f), high, low});
-        reverseTable.emplace(Node{topVar(f), high, low}, nextID);
-#if CLASSPROJECT_VISUALIZE == 1 && CLASSPROJECT_VISUALIZE_FUNCTIONS == 1
-        auto label = labelTable.at(topVar(f)).substr(0, 1) + " ? (" + labelTable.at(high) + ") : (" + labelTable.at(low) + ")";
-        labelTable.emplace(nextID, label);
-        reverselabelTable.emplace(label, nextID);
-#endif
-        return nextID++;
-    } else {
-        return it->second;
-    }
+    return makeNode(topVar(f), high, low);
 }
 
 BDD_ID Manager::coFactorTrue(BDD_ID f, BDD_ID x) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::CoFactorTrue, {f, x}, [&] { return coFactorTrue(f, x); });
+    }
     if (topVar(f) > x || isConstant(f)) {
         return f;
     } if (topVar(f) == x) {
-        return uniqueTable.at(f).high;
+        return getNode(f).high;
     } else {
 #if CLASSPROJECT_USECACHE == 1
         return coTrueCache(f, x);
@@ -162,32 +712,23 @@ BDD_ID Manager::coFactorTrue(BDD_ID f, BDD_ID x) {
 }
 
 BDD_ID Manager::coFactorFalse_impl(BDD_ID f, BDD_ID x) {
-    BDD_ID high = coFactorFalse(uniqueTable.at(f).high, x);
-    BDD_ID low = coFactorFalse(uniqueTable.at(f).low, x);
+    BDD_ID high = coFactorFalse(getNode(f).high, x);
+    BDD_ID low = coFactorFalse(getNode(f).low, x);
     if (high == low) {
         return high;
     }
-    auto it = reverseTable.find({topVar(f), high, low});
-    if (it == reverseTable.end()) {
-        uniqueTable.emplace(nextID, Node{topVar(f), high, low});
-        reverseTable.emplace(Node{topVar(f), high, low}, nextID);
-#if CLASSPROJECT_VISUALIZE == 1 && CLASSPROJECT_VISUALIZE_FUNCTIONS == 1
-        auto label = labelTable.at(topVar(f)).substr(0, 1) + " ? (" + labelTable.at(high) + ") : (" + labelTable.at(low) + ")";
-        labelTable.emplace(nextID, label);
-        reverselabelTable.emplace(label, nextID);
-#endif
-        return nextID++;
-    } else {
-        return it->second;
-    }
+    return makeNode(topVar(f), high, low);
 }
 
 BDD_ID Manager::coFactorFalse(BDD_ID f, BDD_ID x) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::CoFactorFalse, {f, x}, [&] { return coFactorFalse(f, x); });
+    }
     if (topVar(f) > x || isConstant(f)) {
         return f;
     }
     if (topVar(f) == x) {
-        return uniqueTable.at(f).low;
+        return getNode(f).low;
     } else {
 #if CLASSPROJECT_USECACHE == 1
         return coFalseCache(f, x);
@@ -198,38 +739,65 @@ BDD_ID Manager::coFactorFalse(BDD_ID f, BDD_ID x) {
 }
 
 BDD_ID Manager::coFactorTrue(BDD_ID f) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::CoFactorTopTrue, {f}, [&] { return coFactorTrue(f); });
+    }
     return coFactorTrue(f, topVar(f));
 }
 
 BDD_ID Manager::coFactorFalse(BDD_ID f) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::CoFactorTopFalse, {f}, [&] { return coFactorFalse(f); });
+    }
     return coFactorFalse(f, topVar(f));
 }
 
 BDD_ID Manager::and2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::And2, {a, b}, [&] { return and2(a, b); });
+    }
     return ite(a, b, False());
 }
 
 BDD_ID Manager::or2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Or2, {a, b}, [&] { return or2(a, b); });
+    }
     return ite(a, True(), b);
 }
 
 BDD_ID Manager::xor2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Xor2, {a, b}, [&] { return xor2(a, b); });
+    }
     return ite(a, neg(b), b);
 }
 
 BDD_ID Manager::neg(BDD_ID a) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Neg, {a}, [&] { return neg(a); });
+    }
     return ite(a, False(), True());
 }
 
 BDD_ID Manager::nand2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Nand2, {a, b}, [&] { return nand2(a, b); });
+    }
     return ite(a, neg(b), True());
 }
 
 BDD_ID Manager::nor2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Nor2, {a, b}, [&] { return nor2(a, b); });
+    }
     return ite(a, False(), neg(b));
 }
 
 BDD_ID Manager::xnor2(BDD_ID a, BDD_ID b) {
+    if (recordingOperation()) {
+        return recordOperation(Operation::Xnor2, {a, b}, [&] { return xnor2(a, b); });
+    }
     return ite(a, b, neg(b));
 }
 
@@ -243,8 +811,8 @@ void Manager::findNodes(const BDD_ID &root, std::set<BDD_ID> &nodes_of_root) {
         // No insertion or constant value
         return; 
     } else {
-        findNodes(uniqueTable.at(root).high, nodes_of_root);
-        findNodes(uniqueTable.at(root).low, nodes_of_root);
+        findNodes(getNode(root).high, nodes_of_root);
+        findNodes(getNode(root).low, nodes_of_root);
         return;
     }
 }
@@ -264,6 +832,638 @@ size_t Manager::uniqueTableSize() {
     return nextID;
 }
 
+void Manager::setLimits(const ResourceLimits &newLimits) {
+    limits = newLimits;
+    budgetActive = limits.maxNodes > 0 || limits.maxMemory > 0 || limits.timeout.count() > 0;
+    if (opDepth > 0 && limits.timeout.count() > 0) {
+        // Changed while an operation is running, restart its deadline
+        deadline = std::chrono::steady_clock::now() + limits.timeout;
+    }
+}
+
+const ResourceLimits &Manager::getLimits() const {
+    return limits;
+}
+
+// Bytes glibc malloc takes for a block: an 8 byte header, rounded up to 16 bytes, at least 32
+static size_t heapBlock(size_t bytes) {
+    return std::max<size_t>(32, (bytes + sizeof(size_t) + 15) / 16 * 16);
+}
+
+// Bytes the MappedArena takes for a block: 16 byte size classes up to 512 bytes, whole pages above, see MappedArena::allocate()
+static size_t storeBlock(size_t bytes) {
+    return bytes > 512 ? (bytes + 4095) / 4096 * 4096 : std::max<size_t>(16, (bytes + 15) / 16 * 16);
+}
+
+// Hash map entries are single blocks holding the next pointer, the value and the cached hash if the hash is not trivial
+// (NodeHash and std::hash<std::string>, but not std::hash<size_t>). The bucket array is one more block.
+template<typename Map>
+static size_t hashMapBytes(const Map &map, bool cachedHash, size_t (*block)(size_t)) {
+    size_t entry = sizeof(void *) + sizeof(typename Map::value_type) + (cachedHash ? sizeof(size_t) : 0);
+    return map.size() * block(entry) + block(map.bucket_count() * sizeof(void *));
+}
+
+size_t Manager::estimatedMemory() const {
+    // Only the own nodes are counted, a shared base is paid for by the manager it was forked from.
+    size_t (*block)(size_t) = store ? storeBlock : heapBlock;
+    size_t bytes = block(uniqueTable.capacity() * sizeof(Node)) + hashMapBytes(reverseTable, true, block);
+#if CLASSPROJECT_USECACHE == 1
+    bytes += iteCache.memoryUsage() + coTrueCache.memoryUsage() + coFalseCache.memoryUsage();
+#endif
+    return bytes;
+}
+
+MemoryBreakdown Manager::memoryBreakdown() const {
+    MemoryBreakdown breakdown;
+    auto add = [&](const char *name, const char *location, size_t bytes, size_t entries, size_t slots) {
+        breakdown.structures.push_back(StructureMemory{name, location, bytes, entries, slots,
+                                                       slots ? double(entries) / double(slots) : 0});
+    };
+
+    const char *nodeLocation = store ? "node store" : "heap";
+    size_t (*block)(size_t) = store ? storeBlock : heapBlock;
+    add("uniqueTable", nodeLocation, block(uniqueTable.capacity() * sizeof(Node)), uniqueTable.size(), uniqueTable.capacity());
+    add("reverseTable", nodeLocation, hashMapBytes(reverseTable, true, block), reverseTable.size(), reverseTable.bucket_count());
+
+#if CLASSPROJECT_USECACHE == 1
+    add("iteCache", "heap", iteCache.memoryUsage(), iteCache.size(), iteCache.capacity());
+    add("coTrueCache", "heap", coTrueCache.memoryUsage(), coTrueCache.size(), coTrueCache.capacity());
+    add("coFalseCache", "heap", coFalseCache.memoryUsage(), coFalseCache.size(), coFalseCache.capacity());
+#endif
+
+    // Labels longer than the small string buffer have a block of their own
+    size_t labelBytes = 0;
+    for (const auto &entry : labelTable) {
+        labelBytes += entry.second.capacity() > 15 ? heapBlock(entry.second.capacity() + 1) : 0;
+    }
+    add("labelTable", "heap", hashMapBytes(labelTable, false, heapBlock) + labelBytes, labelTable.size(), labelTable.bucket_count());
+    add("reverselabelTable", "heap", hashMapBytes(reverselabelTable, true, heapBlock) + labelBytes,
+        reverselabelTable.size(), reverselabelTable.bucket_count());
+
+    // Shared segments of forks, possibly shared with other managers, and mapped snapshots
+    size_t segmentBytes = 0, segmentNodes = 0, segmentSlots = 0;
+    for (const Segment *segment = base.get(); segment; segment = segment->parent.get()) {
+        if (segment->snapshot) {
+            add("snapshot", "snapshot", segment->snapshot->size, segment->end - segment->begin, segment->end - segment->begin);
+        } else {
+            segmentBytes += block(segment->storage.capacity() * sizeof(Node)) + hashMapBytes(segment->reverse, true, block);
+            segmentNodes += segment->storage.size();
+            segmentSlots += segment->storage.capacity();
+        }
+    }
+    if (bfs.memoryUsage() > 0) {
+        add("bfsScratch", "heap", bfs.memoryUsage(), bfs.requests.size(), bfs.requests.capacity());
+    }
+    if (segmentNodes > 0) {
+        add("sharedSegments", nodeLocation, segmentBytes, segmentNodes, segmentSlots);
+    }
+    return breakdown;
+}
+
+size_t MemoryBreakdown::total() const {
+    size_t bytes = 0;
+    for (const auto &structure : structures) {
+        bytes += structure.bytes;
+    }
+    return bytes;
+}
+
+void MemoryBreakdown::writeJson(std::ostream &out) const {
+    out << "{\"total\": " << total() << ", \"structures\": [";
+    for (size_t i = 0; i < structures.size(); i++) {
+        const StructureMemory &structure = structures[i];
+        out << (i ? ", " : "") << "{\"name\": \"" << structure.name << "\", \"location\": \"" << structure.location
+            << "\", \"bytes\": " << structure.bytes << ", \"entries\": " << structure.entries
+            << ", \"slots\": " << structure.slots << ", \"load_factor\": " << structure.loadFactor << "}";
+    }
+    out << "]}";
+}
+
+size_t LevelProfile::nodes() const {
+    size_t nodes = 0;
+    for (size_t count : total) {
+        nodes += count;
+    }
+    return nodes;
+}
+
+void LevelProfile::writeCsv(std::ostream &out, const std::vector<std::string> &names, ManagerInterface &mgr) const {
+    auto writeRow = [&](const std::string &name, const std::vector<size_t> &counts) {
+        for (size_t level = 0; level < counts.size(); level++) {
+            if (counts[level] > 0) {
+                out << name << "," << level << "," << mgr.getTopVarName(vars[level]) << "," << counts[level] << "\n";
+            }
+        }
+    };
+    for (size_t r = 0; r < roots.size(); r++) {
+        writeRow(r < names.size() ? names[r] : std::to_string(r), roots[r]);
+    }
+    writeRow("shared", shared);
+    writeRow("total", total);
+}
+
+LevelProfile Manager::levelProfile(const std::vector<BDD_ID> &roots, bool perRoot) {
+    LevelProfile profile;
+    for (const auto &label : labelTable) {
+        if (isVariable(label.first)) {
+            profile.vars.push_back(label.first);
+        }
+    }
+    // Variables are ordered by their BDD_ID
+    std::sort(profile.vars.begin(), profile.vars.end());
+    profile.total.assign(profile.vars.size(), 0);
+    auto level = [&](BDD_ID f) {
+        return std::lower_bound(profile.vars.begin(), profile.vars.end(), topVar(f)) - profile.vars.begin();
+    };
+
+    std::vector<BDD_ID> stack;
+    if (!perRoot) {
+        std::vector<bool> visited(nextID, false);
+        for (BDD_ID root : roots) {
+            stack.push_back(root);
+            while (!stack.empty()) {
+                BDD_ID f = stack.back();
+                stack.pop_back();
+                if (isConstant(f) || visited[f]) {
+                    continue;
+                }
+                visited[f] = true;
+                profile.total[level(f)]++;
+                stack.push_back(getNode(f).high);
+                stack.push_back(getNode(f).low);
+            }
+        }
+        return profile;
+    }
+    profile.shared.assign(profile.vars.size(), 0);
+    profile.roots.assign(roots.size(), std::vector<size_t>(profile.vars.size(), 0));
+
+    // Owner of every visited node: index of the first root reaching it + 1, or Shared. A node changes its owner
+    // at most twice, so every node is expanded at most twice.
+    const uint32_t Shared = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> owner(nextID, 0);
+    for (size_t r = 0; r < roots.size(); r++) {
+        const uint32_t own = static_cast<uint32_t>(r + 1);
+        stack.push_back(roots[r]);
+        while (!stack.empty()) {
+            BDD_ID f = stack.back();
+            stack.pop_back();
+            if (isConstant(f) || owner[f] == own || owner[f] == Shared) {
+                continue;
+            }
+            auto l = level(f);
+            if (owner[f] == 0) {
+                owner[f] = own;
+                profile.roots[r][l]++;
+                profile.total[l]++;
+            } else {
+                // Reached by an earlier root, all its successors were reached by that root as well
+                profile.roots[owner[f] - 1][l]--;
+                profile.shared[l]++;
+                owner[f] = Shared;
+            }
+            stack.push_back(getNode(f).high);
+            stack.push_back(getNode(f).low);
+        }
+    }
+    return profile;
+}
+
+Checkpoint Manager::checkpoint() {
+    if (recording.recorder) {
+        recording.recorder->write(Operation::Checkpoint, {checkpoints.size()});
+    }
+    checkpoints.push_back(nextID);
+    return Checkpoint{checkpoints.size() - 1, nextID};
+}
+
+void Manager::checkCheckpoint(const Checkpoint &token, const char *caller) const {
+    if (token.index >= checkpoints.size() || checkpoints[token.index] != token.nextID) {
+        throw std::logic_error(std::string(caller) + ": checkpoint is not open");
+    }
+}
+
+void Manager::rollback(const Checkpoint &token) {
+    TraceSpan span("rollback", "gc");
+    checkCheckpoint(token, "rollback");
+    if (opDepth > 0) {
+        throw std::logic_error("rollback: called while an operation is running");
+    }
+    if (token.nextID < baseSize) {
+        throw std::logic_error("rollback: nodes since the checkpoint are shared with a fork");
+    }
+    checkpoints.resize(token.index);
+    if (recording.recorder) {
+        recording.recorder->write(Operation::Rollback, {token.index});
+    }
+
+    // IDs are allocated monotonically, so everything created since the checkpoint is at the end of the node store
+    const BDD_ID mark = token.nextID;
+    for (BDD_ID id = mark; id < nextID; id++) {
+        reverseTable.erase(getNode(id));
+        auto label = labelTable.find(id);
+        if (label != labelTable.end()) {
+            reverselabelTable.erase(label->second);
+            labelTable.erase(label);
+        }
+    }
+    uniqueTable.erase(uniqueTable.begin() + (mark - baseSize), uniqueTable.end());
+    nextID = mark;
+
+#if CLASSPROJECT_USECACHE == 1
+    // Drop the cache entries with an argument or a result created since the checkpoint
+    auto newer = [mark](const auto &args, BDD_ID result) {
+        return result >= mark || std::apply([mark](auto... ids) { return ((ids >= mark) || ...); }, args);
+    };
+    iteCache.eraseIf(newer);
+    coTrueCache.eraseIf(newer);
+    coFalseCache.eraseIf(newer);
+#endif
+    shrinkCaches();
+}
+
+void Manager::commit(const Checkpoint &token) {
+    checkCheckpoint(token, "commit");
+    if (recording.recorder) {
+        recording.recorder->write(Operation::Commit, {token.index});
+    }
+    checkpoints.resize(token.index);
+}
+
+void Manager::clear() {
+    if (opDepth > 0) {
+        throw std::logic_error("clear: called while an operation is running");
+    }
+    if (recording.recorder) {
+        recording.recorder->write(Operation::Clear, {});
+    }
+    base.reset();
+    baseSize = 0;
+    checkpoints.clear();
+
+    // clear() keeps the capacity of vectors and the bucket arrays of the hash maps
+    uniqueTable.clear();
+    reverseTable.clear();
+    labelTable.clear();
+    reverselabelTable.clear();
+    uniqueTable.push_back(Node{False(), False(), False()});
+    reverseTable.emplace(Node{False(), False(), False()}, False());
+    uniqueTable.push_back(Node{True(), True(), True()});
+    reverseTable.emplace(Node{True(), True(), True()}, True());
+    labelTable.emplace(True(), "True");
+    reverselabelTable.emplace("True", True());
+    labelTable.emplace(False(), "False");
+    reverselabelTable.emplace("False", False());
+    nextID = 2;
+
+#if CLASSPROJECT_USECACHE == 1
+    iteCache.clear();
+    coTrueCache.clear();
+    coFalseCache.clear();
+#endif
+    resetStats();
+}
+
+void Manager::reserve(size_t nodes, size_t vars) {
+    uniqueTable.reserve(nodes);
+    reverseTable.reserve(nodes);
+    labelTable.reserve(vars + 2);
+    reverselabelTable.reserve(vars + 2);
+}
+
+void Manager::compact(std::vector<BDD_ID> &roots) {
+    TraceSpan span("compact", "gc");
+    if (opDepth > 0) {
+        throw std::logic_error("compact: called while an operation is running");
+    }
+    if (!checkpoints.empty()) {
+        throw std::logic_error("compact: called while a checkpoint is open");
+    }
+    std::vector<BDD_ID> recordedRoots;
+    if (recording.recorder) {
+        recordedRoots = roots;
+    }
+
+    // Mark the terminals, all variables and every node reachable from the roots
+    std::vector<bool> live(nextID, false);
+    live[False()] = true;
+    live[True()] = true;
+    std::vector<BDD_ID> vars;
+    for (BDD_ID id = True() + 1; id < nextID; id++) {
+        if (isVariable(id)) {
+            live[id] = true;
+            vars.push_back(id);
+        }
+    }
+    std::vector<BDD_ID> stack(roots.begin(), roots.end());
+    std::vector<BDD_ID> nodes;
+    while (!stack.empty()) {
+        BDD_ID f = stack.back();
+        stack.pop_back();
+        if (live.at(f)) {
+            continue;
+        }
+        live[f] = true;
+        nodes.push_back(f);
+        stack.push_back(getNode(f).high);
+        stack.push_back(getNode(f).low);
+    }
+
+    // New layout: terminals, variables, then the other nodes level by level starting at the bottom level,
+    // so that the successors of a node are stored before the node itself
+    std::sort(nodes.begin(), nodes.end(), [this](BDD_ID a, BDD_ID b) {
+        return getNode(a).topVar != getNode(b).topVar ? getNode(a).topVar > getNode(b).topVar : a < b;
+    });
+    std::vector<BDD_ID> order{False(), True()};
+    order.insert(order.end(), vars.begin(), vars.end());
+    order.insert(order.end(), nodes.begin(), nodes.end());
+    std::vector<BDD_ID> remap(nextID, 0);
+    for (BDD_ID id = 0; id < order.size(); id++) {
+        remap[order[id]] = id;
+    }
+
+    // Rebuild the tables at their exact size, the shared base of a fork is copied into them
+    NodeVector newUniqueTable(uniqueTable.get_allocator());
+    newUniqueTable.reserve(order.size());
+    NodeMap newReverseTable(order.size(), NodeHash(), std::equal_to<Node>(), reverseTable.get_allocator());
+    for (BDD_ID id = 0; id < order.size(); id++) {
+        const Node &node = getNode(order[id]);
+        newUniqueTable.push_back(Node{remap[node.topVar], remap[node.high], remap[node.low]});
+        newReverseTable.emplace(newUniqueTable.back(), id);
+    }
+    std::unordered_map<BDD_ID, std::string> newLabelTable;
+    std::unordered_map<std::string, BDD_ID> newReverselabelTable;
+    for (const auto &entry : labelTable) {
+        if (live[entry.first]) {
+            newLabelTable.emplace(remap[entry.first], entry.second);
+            newReverselabelTable.emplace(entry.second, remap[entry.first]);
+        }
+    }
+    uniqueTable.swap(newUniqueTable);
+    reverseTable.swap(newReverseTable);
+    base.reset(); // the compacted tables hold all nodes, no longer shared with forks
+    baseSize = 0;
+    labelTable.swap(newLabelTable);
+    reverselabelTable.swap(newReverselabelTable);
+    nextID = order.size();
+
+    // Cached results may refer to freed nodes
+#if CLASSPROJECT_USECACHE == 1
+    iteCache.clear();
+    coTrueCache.clear();
+    coFalseCache.clear();
+#endif
+    shrinkCaches();
+
+    for (auto &root : roots) {
+        root = remap[root];
+    }
+    if (recording.recorder) {
+        recording.recorder->writeCompact(recordedRoots, roots);
+    }
+
+    // Release the old tables and hand the freed memory back to the OS
+    NodeVector().swap(newUniqueTable);
+    NodeMap().swap(newReverseTable);
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+void Manager::setNodeStore(const std::string &directory) {
+    if (opDepth > 0) {
+        throw std::logic_error("setNodeStore: called while an operation is running");
+    }
+    std::shared_ptr<MappedArena> newStore = directory.empty() ? nullptr : std::make_shared<MappedArena>(directory);
+    NodeVector newUniqueTable{MappedAllocator<Node>(newStore)};
+    newUniqueTable.reserve(uniqueTable.capacity());
+    newUniqueTable.insert(newUniqueTable.end(), uniqueTable.begin(), uniqueTable.end());
+    NodeMap newReverseTable(reverseTable.begin(), reverseTable.end(), reverseTable.bucket_count(),
+                            NodeHash(), std::equal_to<Node>(), MappedAllocator<Node>(newStore));
+    // The allocators propagate, the old tables are released through their own allocator
+    uniqueTable = std::move(newUniqueTable);
+    reverseTable = std::move(newReverseTable);
+    store = std::move(newStore);
+}
+
+void Manager::setCachePolicy(const CachePolicy &policy) {
+    if (opDepth > 0) {
+        throw std::logic_error("setCachePolicy: called while an operation is running");
+    }
+    cachePolicy = policy;
+    size_t entries = 1;
+    while (entries < cachePolicy.entries) {
+        entries *= 2;
+    }
+    cachePolicy.entries = entries;
+#if CLASSPROJECT_USECACHE == 1
+    resizeCache(iteCache, "ite", entries);
+    resizeCache(coTrueCache, "coFactorTrue", entries);
+    resizeCache(coFalseCache, "coFactorFalse", entries);
+#endif
+}
+
+const CachePolicy &Manager::getCachePolicy() const {
+    return cachePolicy;
+}
+
+template<typename C>
+void Manager::resizeCache(C &cache, const char *name, size_t entries) {
+    if (entries == cache.capacity()) {
+        return;
+    }
+    CLASSPROJECT_COUNT(statistics.cacheResizes.push_back(CacheResize{name, cache.capacity(), entries, cache.conflictRate(), nextID}));
+    cache.resize(entries);
+    size_t smallest = std::min({iteCache.capacity(), coTrueCache.capacity(), coFalseCache.capacity()});
+    sampleMask = std::max<BDD_ID>(MinSampleInterval, std::min<BDD_ID>(SampleInterval, smallest)) - 1;
+}
+
+void Manager::sample() {
+#if CLASSPROJECT_USECACHE == 1
+    if (Tracer::enabled() && iteCache.hits() + iteCache.misses() > 0) {
+        Tracer::counter("ite cache hit rate", double(iteCache.hits()) / double(iteCache.hits() + iteCache.misses()));
+    }
+    if (cachePolicy.adaptive) {
+        growCaches();
+    }
+#endif
+    Tracer::counter("live nodes", double(nextID));
+}
+
+void Manager::growCaches() {
+#if CLASSPROJECT_USECACHE == 1
+    auto grow = [this](auto &cache, const char *name) {
+        if (cache.lookupsInWindow() >= std::min<size_t>(SampleInterval, cache.capacity()) && cache.conflictRate() > 0.4) {
+            // Twice the size, or about one entry per node, as far as the memory ceiling allows
+            size_t others = iteCache.memoryUsage() + coTrueCache.memoryUsage() + coFalseCache.memoryUsage()
+                            - cache.memoryUsage();
+            size_t entryBytes = cache.memoryUsage() / cache.capacity();
+            size_t entries = 2 * cache.capacity();
+            while (entries < nextID && others + 2 * entries * entryBytes <= cachePolicy.maxMemory) {
+                entries *= 2;
+            }
+            if (others + entries * entryBytes <= cachePolicy.maxMemory) {
+                resizeCache(cache, name, entries);
+            }
+        }
+        cache.resetWindow();
+    };
+    grow(iteCache, "ite");
+    grow(coTrueCache, "coFactorTrue");
+    grow(coFalseCache, "coFactorFalse");
+#endif
+}
+
+void Manager::shrinkCaches() {
+#if CLASSPROJECT_USECACHE == 1
+    // About one entry per node, but not below the initial size
+    size_t entries = cachePolicy.entries;
+    while (entries < nextID) {
+        entries *= 2;
+    }
+    auto shrink = [&](auto &cache, const char *name) {
+        if (cache.capacity() > entries) {
+            resizeCache(cache, name, entries);
+        }
+    };
+    shrink(iteCache, "ite");
+    shrink(coTrueCache, "coFactorTrue");
+    shrink(coFalseCache, "coFactorFalse");
+#endif
+}
+
+ManagerStats Manager::stats() const {
+    ManagerStats result = statistics;
+#if CLASSPROJECT_USECACHE == 1
+    result.iteCacheHits = iteCache.hits();
+    result.iteCacheMisses = iteCache.misses();
+    result.coFactorCacheHits = coTrueCache.hits() + coFalseCache.hits();
+    result.coFactorCacheMisses = coTrueCache.misses() + coFalseCache.misses();
+    result.iteCacheEntries = iteCache.size();
+    result.coFactorCacheEntries = coTrueCache.size() + coFalseCache.size();
+    result.iteCacheCapacity = iteCache.capacity();
+    result.coFactorCacheCapacity = coTrueCache.capacity() + coFalseCache.capacity();
+#endif
+    result.nodes = nextID;
+    result.peakNodes = std::max(result.peakNodes, nextID);
+
+    // The bucket lengths are measured here instead of on every lookup
+    size_t usedBuckets = 0;
+    for (size_t bucket = 0; bucket < reverseTable.bucket_count(); bucket++) {
+        size_t length = reverseTable.bucket_size(bucket);
+        if (length > 0) {
+            usedBuckets++;
+            result.uniqueChainMax = std::max(result.uniqueChainMax, length);
+        }
+    }
+    result.uniqueChainAvg = usedBuckets ? double(reverseTable.size()) / double(usedBuckets) : 0;
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+    result.nodesPerSecond = result.seconds > 0 ? double(result.nodesCreated) / result.seconds : 0;
+    return result;
+}
+
+void Manager::resetStats() {
+    statistics = ManagerStats();
+    statsStart = std::chrono::steady_clock::now();
+#if CLASSPROJECT_USECACHE == 1
+    iteCache.resetCounters();
+    coTrueCache.resetCounters();
+    coFalseCache.resetCounters();
+#endif
+}
+
+void ManagerStats::writeJson(std::ostream &out) const {
+    out << "{\"enabled\": " << (enabled ? "true" : "false")
+        << ", \"ite_calls\": " << iteCalls
+        << ", \"ite_expansions\": " << iteExpansions
+        << ", \"ite_cache_hits\": " << iteCacheHits
+        << ", \"ite_cache_misses\": " << iteCacheMisses
+        << ", \"cofactor_cache_hits\": " << coFactorCacheHits
+        << ", \"cofactor_cache_misses\": " << coFactorCacheMisses
+        << ", \"unique_lookups\": " << uniqueLookups
+        << ", \"unique_hits\": " << uniqueHits
+        << ", \"nodes_created\": " << nodesCreated
+        << ", \"peak_nodes\": " << peakNodes
+        << ", \"max_depth\": " << maxDepth
+        << ", \"nodes\": " << nodes
+        << ", \"ite_cache_entries\": " << iteCacheEntries
+        << ", \"cofactor_cache_entries\": " << coFactorCacheEntries
+        << ", \"ite_cache_capacity\": " << iteCacheCapacity
+        << ", \"cofactor_cache_capacity\": " << coFactorCacheCapacity
+        << ", \"unique_chain_avg\": " << uniqueChainAvg
+        << ", \"unique_chain_max\": " << uniqueChainMax
+        << ", \"seconds\": " << seconds
+        << ", \"nodes_per_second\": " << nodesPerSecond
+        << ", \"cache_resizes\": [";
+    for (size_t i = 0; i < cacheResizes.size(); i++) {
+        const CacheResize &resize = cacheResizes[i];
+        out << (i ? ", " : "") << "{\"cache\": \"" << resize.cache << "\", \"from\": " << resize.from
+            << ", \"to\": " << resize.to << ", \"conflict_rate\": " << resize.conflictRate
+            << ", \"nodes\": " << resize.nodes << "}";
+    }
+    out << "]}";
+}
+
+void Manager::setApplyEngine(ApplyEngine newEngine) {
+    engine = newEngine;
+}
+
+ApplyEngine Manager::getApplyEngine() const {
+    return engine;
+}
+
+void Manager::startRecording(const std::string &path) {
+    if (recording.recorder) {
+        throw std::logic_error("startRecording: already recording");
+    }
+    if (opDepth > 0) {
+        throw std::logic_error("startRecording: called while an operation is running");
+    }
+    if (!checkpoints.empty()) {
+        throw std::logic_error("startRecording: called while a checkpoint is open");
+    }
+    auto recorder = std::make_unique<OperationRecorder>(path);
+    // The existing variables and nodes in the order of their BDD_IDs, successors come before their parents
+    for (BDD_ID id = True() + 1; id < nextID; id++) {
+        if (isVariable(id)) {
+            recorder->writeVar(labelTable.at(id), id);
+        } else {
+            const Node &node = getNode(id);
+            recorder->write(Operation::Node, {node.topVar, node.high, node.low}, id);
+        }
+    }
+    recording.recorder = std::move(recorder);
+}
+
+size_t Manager::stopRecording() {
+    if (!recording.recorder) {
+        return 0;
+    }
+    recording.recorder->finish();
+    size_t records = recording.recorder->operations();
+    recording.recorder.reset();
+    return records;
+}
+
+void Manager::checkNodeBudget() {
+    if (limits.maxNodes > 0 && nextID >= limits.maxNodes) {
+        throw BudgetExceeded(BudgetExceeded::Reason::Nodes,
+            "node budget exceeded (" + std::to_string(limits.maxNodes) + " nodes)");
+    }
+    if (limits.maxMemory > 0 && estimatedMemory() >= limits.maxMemory) {
+        throw BudgetExceeded(BudgetExceeded::Reason::Memory,
+            "memory budget exceeded (" + std::to_string(limits.maxMemory) + " bytes)");
+    }
+}
+
+void Manager::checkTimeBudget() {
+    if (opDepth > 0 && limits.timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline) {
+        throw BudgetExceeded(BudgetExceeded::Reason::Time,
+            "time budget exceeded (" + std::to_string(limits.timeout.count()) + " ms)");
+    }
+}
+
 void Manager::visualizeBDD(std::string filepath, BDD_ID &root) {
 #if CLASSPROJECT_VISUALIZE == 1
     char name[] = "BDD";
@@ -285,8 +1485,8 @@ void Manager::visualizeBDD(std::string filepath, BDD_ID &root) {
                 // Skip terminal nodes
                 continue;
             }
-            BDD_ID high = uniqueTable.at(i).high;
-            BDD_ID low = uniqueTable.at(i).low;
+            BDD_ID high = getNode(i).high;
+            BDD_ID low = getNode(i).low;
             Agedge_t *h = agedge(g, nodeMap.at(i), nodeMap.at(high), 0, 1);
             Agedge_t *l = agedge(g, nodeMap.at(i), nodeMap.at(low), 0, 1);
             char stylename[] = "style";
@@ -363,11 +1563,12 @@ void Manager::visualizeBDD(std::string filepath, BDD_ID &root) {
     void Manager::printTable() {
         std::cout << "ID || High | Low | Top-Var | Label" << std::endl;
         std::cout << "----------------------------------" << std::endl;
-        for (const auto &it : uniqueTable) {
+        for (BDD_ID id = 0; id < nextID; id++) {
+            const Node &node = getNode(id);
             #if CLASSPROJECT_VISUALIZE_FUNCTIONS == 1
-                std::cout << " " << it.first << " ||   " << it.second.high << "  |  " << it.second.low << "  |    " << it.second.topVar << "    | " << labelTable.at(it.first) << std::endl;
+                std::cout << " " << id << " ||   " << node.high << "  |  " << node.low << "  |    " << node.topVar << "    | " << labelTable.at(id) << std::endl;
             #else
-                std::cout << " " << it.first << " ||   " << it.second.high << "  |  " << it.second.low << "  |    " << it.second.topVar << "    | " << getTopVarName(topVar(it.first)) << std::endl;
+                std::cout << " " << id << " ||   " << node.high << "  |  " << node.low << "  |    " << node.topVar << "    | " << getTopVarName(topVar(id)) << std::endl;
             #endif
         }
     }
@@ -6,60 +6,350 @@
 #define VDSPROJECT_MANAGER_H
 
 #include "ManagerInterface.h"
+#include "MappedArena.h"
+#include "OperationLog.h"
 #include "config.h"
 
 #include <iostream>
 #include <string>
 #include <unordered_map>
 #include <map>
+#include <vector>
 #include <array>
 #include <functional>
+#include <memory>
 #include <tuple>
 #include <set>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
 
 namespace ClassProject {
 
 #if CLASSPROJECT_USECACHE == 1
+/**
+ * @brief Memoizing computed table of a function
+ * The results are stored in a direct-mapped table of a power of two entries. A result whose slot is taken by
+ * other arguments replaces them, so the table is lossy and its memory bounded by its capacity.
+ */
 template<typename Return, typename ... Args>
 class Cache {
 public:
+    static constexpr size_t DefaultCapacity = size_t(1) << 10;
 // Constructors
-    Cache(std::function<Return(Args...)> f) 
+    Cache(std::function<Return(Args...)> f, size_t capacity = DefaultCapacity)
         : f(f)
-    {}
+    {
+        resize(capacity);
+    }
 // Default constructors
     Cache(const Cache &c) = default;
     Cache(Cache &&c) = default;
-// Assignment operators
-    Cache &operator=(const Cache &c) = default;
-    Cache &operator=(Cache &&c) = default;
+// Assignment operators, only the cached results are transferred. The cache stays bound to its own function,
+// so an owner that binds its cache to itself stays correct when it is copied or moved.
+    Cache &operator=(const Cache &c) {
+        table = c.table;
+        used = c.used;
+        shift = c.shift;
+        return *this;
+    }
+    Cache &operator=(Cache &&c) {
+        table = std::move(c.table);
+        used = c.used;
+        shift = c.shift;
+        return *this;
+    }
 // Destructor
     ~Cache() = default; // LCOV_EXCL_LINE
+// Number of cached results
+    size_t size() const {
+        return used;
+    }
+// Number of entries of the table
+    size_t capacity() const {
+        return table.size();
+    }
+// Memory of the table in bytes
+    size_t memoryUsage() const {
+        return table.capacity() * sizeof(Entry);
+    }
 // Cache operator overload
     Return operator()(Args... args) {
-        auto it = cache.find(std::make_tuple(args...));
-        if (it == cache.end()) {
-            Return result = f(args...);
-            cache.emplace(std::make_tuple(args...), result);
+        Return result;
+        if (lookup(result, args...)) {
             return result;
-        } else {
-            return it->second;
         }
+        // The slot is computed again after the call, the table may have been resized meanwhile
+        result = f(args...);
+        insert(result, args...);
+        return result;
+    }
+// Lookup without computing, returns true and sets result on a hit
+    bool lookup(Return &result, Args... args) const {
+        const Entry &entry = table[slot(args...)];
+        windowLookups++;
+        if (!entry.used || entry.args != std::make_tuple(args...)) {
+#if CLASSPROJECT_STATS == 1
+            misses_++;
+#endif
+            // A miss on a slot taken by other arguments would have been a hit in a larger table
+            windowConflicts += entry.used;
+            return false;
+        }
+#if CLASSPROJECT_STATS == 1
+        hits_++;
+#endif
+        result = entry.result;
+        return true;
+    }
+// Stores a result computed outside of the cache
+    void insert(Return result, Args... args) {
+        Entry &entry = table[slot(args...)];
+        used += !entry.used;
+        entry = Entry{std::make_tuple(args...), result, true};
+    }
+// Drops all cached results
+    void clear() {
+        std::fill(table.begin(), table.end(), Entry{});
+        used = 0;
+    }
+// Drops all cached results for which pred(args, result) returns true
+    template<typename Pred>
+    void eraseIf(Pred pred) {
+        for (auto &entry : table) {
+            if (entry.used && pred(entry.args, entry.result)) {
+                entry = Entry{};
+                used--;
+            }
+        }
+    }
+// Changes the number of entries to the given power of two, keeping as many results as fit
+    void resize(size_t newCapacity) {
+        std::vector<Entry> old(newCapacity);
+        old.swap(table);
+        shift = 8 * sizeof(uint64_t);
+        for (size_t n = newCapacity; n > 1; n >>= 1) {
+            shift--;
+        }
+        used = 0;
+        for (const auto &entry : old) {
+            if (entry.used) {
+                std::apply([&](auto... args) { insert(entry.result, args...); }, entry.args);
+            }
+        }
+        resetWindow();
+    }
+// Share of the lookups since the last resetWindow() that missed because their slot was taken
+    double conflictRate() const {
+        return windowLookups ? double(windowConflicts) / double(windowLookups) : 0;
+    }
+    size_t lookupsInWindow() const {
+        return windowLookups;
+    }
+    void resetWindow() {
+        windowLookups = 0;
+        windowConflicts = 0;
+    }
+// Number of lookups that found a result / had to compute it, always 0 if CLASSPROJECT_STATS is 0
+    size_t hits() const {
+        return hits_;
+    }
+    size_t misses() const {
+        return misses_;
+    }
+    void resetCounters() {
+        hits_ = 0;
+        misses_ = 0;
     }
 private:
+    struct Entry {
+        std::tuple<Args...> args;
+        Return result;
+        bool used = false;
+    };
+
+    // Fibonacci hashing of the combined arguments, the top bits select the slot
+    size_t slot(Args... args) const {
+        uint64_t hash = 5381;
+        ((hash = hash * 33 + static_cast<uint64_t>(args)), ...);
+        return shift < 64 ? static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift) : 0;
+    }
+
     std::function<Return(Args...)> f;
-    std::map<std::tuple<Args...>, Return> cache;
+    std::vector<Entry> table;
+    size_t used = 0;
+    unsigned shift = 64;
+    mutable size_t windowLookups = 0;
+    mutable size_t windowConflicts = 0;
+    mutable size_t hits_ = 0;
+    mutable size_t misses_ = 0;
 };
 #endif
 
 static const BDD_ID FalseId = 0;
 static const BDD_ID TrueId = 1;
+
+/**
+ * @brief Resource limits of a Manager. A limit of 0 disables the respective check.
+ */
+struct ResourceLimits {
+    size_t maxNodes = 0;                  ///< Maximum number of nodes in the unique table
+    size_t maxMemory = 0;                 ///< Maximum estimated memory of the node tables and caches in bytes
+    std::chrono::milliseconds timeout{0}; ///< Maximum wall-clock time of a single top-level ite call
+};
+
+/**
+ * @brief Exception thrown when an operation exceeds one of the configured ResourceLimits.
+ * The manager stays consistent: nodes created before the abort remain valid, but are unreferenced.
+ */
+class BudgetExceeded : public std::runtime_error {
+public:
+    enum class Reason { Nodes, Memory, Time };
+    BudgetExceeded(Reason reason, const std::string &what)
+        : std::runtime_error(what)
+        , reason_(reason)
+    {}
+    Reason reason() const {
+        return reason_;
+    }
+private:
+    Reason reason_;
+};
+
+/**
+ * @brief Algorithm used by ite (and all logical operations built on it)
+ */
+enum class ApplyEngine {
+    DepthFirst,  ///< Recursive Shannon expansion
+    BreadthFirst ///< Level-by-level expansion of all requests, followed by a bottom-up reduction
+};
+
+/**
+ * @brief Sizing of the computed tables (ite and cofactor caches) of a Manager
+ */
+struct CachePolicy {
+    size_t entries = size_t(1) << 10;    ///< Initial number of entries of each cache, rounded up to a power of two
+    bool adaptive = true;                ///< Grow a cache while it loses results to conflicts and nodes are being created
+    size_t maxMemory = size_t(1) << 30;  ///< Ceiling of the memory of all caches together in adaptive mode, in bytes
+};
+
+/**
+ * @brief A resize of a computed table, see ManagerStats::cacheResizes
+ */
+struct CacheResize {
+    std::string cache;   ///< "ite", "coFactorTrue" or "coFactorFalse"
+    size_t from;         ///< Entries before the resize
+    size_t to;           ///< Entries after the resize
+    double conflictRate; ///< Share of the recent lookups that missed because their slot was taken
+    size_t nodes;        ///< Unique table size at the time of the resize
+};
+
+/**
+ * @brief Operation statistics of a Manager, see Manager::stats()
+ * The counters are plain members of the manager, so they cost no synchronization. They are only maintained
+ * if CLASSPROJECT_STATS is 1 and stay 0 otherwise, the fields describing the current state are always filled in.
+ */
+struct ManagerStats {
+    // Counters since the manager was created or the statistics were reset
+    size_t iteCalls = 0;            ///< ite calls that are not a terminal case
+    size_t iteExpansions = 0;       ///< Shannon expansions, recursive or breadth-first requests
+    size_t iteCacheHits = 0;
+    size_t iteCacheMisses = 0;
+    size_t coFactorCacheHits = 0;
+    size_t coFactorCacheMisses = 0;
+    size_t uniqueLookups = 0;       ///< Lookups of a node in the unique table
+    size_t uniqueHits = 0;          ///< Lookups finding an existing node
+    size_t nodesCreated = 0;
+    size_t peakNodes = 0;           ///< Largest unique table size
+    size_t maxDepth = 0;            ///< Deepest nesting of ite calls
+    // Current state
+    size_t nodes = 0;               ///< Unique table size
+    size_t iteCacheEntries = 0;
+    size_t coFactorCacheEntries = 0;
+    double uniqueChainAvg = 0;      ///< Average entries per used bucket of the own unique table, the probe length of a hit
+    size_t uniqueChainMax = 0;      ///< Longest bucket of the own unique table
+    size_t iteCacheCapacity = 0;
+    size_t coFactorCacheCapacity = 0;
+    std::vector<CacheResize> cacheResizes; ///< Resize decisions of the computed tables
+    double seconds = 0;             ///< Wall-clock time covered by the counters
+    double nodesPerSecond = 0;      ///< nodesCreated / seconds
+    bool enabled = CLASSPROJECT_STATS == 1;
+
+    /**
+     * @brief Writes the statistics as one JSON object
+     */
+    void writeJson(std::ostream &out) const;
+};
+
+/**
+ * @brief Memory of one internal structure of a Manager, see Manager::memoryBreakdown()
+ */
+struct StructureMemory {
+    std::string name;
+    std::string location;   ///< "heap", "node store" (file-backed, see Manager::setNodeStore()) or "snapshot" (mapped file)
+    size_t bytes = 0;       ///< Estimated bytes including the allocator overhead of every block
+    size_t entries = 0;     ///< Stored elements
+    size_t slots = 0;       ///< Allocated elements, buckets of hash tables
+    double loadFactor = 0;  ///< entries / slots
+};
+
+/**
+ * @brief Memory of the internal structures of a Manager
+ */
+struct MemoryBreakdown {
+    std::vector<StructureMemory> structures;
+
+    /**
+     * @brief Returns the sum of the bytes of all structures
+     */
+    size_t total() const;
+
+    /**
+     * @brief Writes the breakdown as one JSON object
+     */
+    void writeJson(std::ostream &out) const;
+};
+
+/**
+ * @brief Nodes per variable level of a set of BDDs, see Manager::levelProfile()
+ *
+ * Every node reachable from the roots is counted once, either for the only root reaching it or as shared,
+ * so that total[l] is the sum of roots[r][l] over all roots plus shared[l]. Terminals are not counted.
+ */
+struct LevelProfile {
+    std::vector<BDD_ID> vars;               ///< Variable of each level, top level first
+    std::vector<size_t> total;              ///< Distinct nodes per level
+    std::vector<size_t> shared;             ///< Nodes per level reachable from more than one root, empty for totals only
+    std::vector<std::vector<size_t>> roots; ///< Nodes per level reachable from this root only, one row per root, empty for totals only
+
+    /**
+     * @brief Returns the number of distinct nodes
+     */
+    size_t nodes() const;
+
+    /**
+     * @brief Writes one "root,level,variable,nodes" line per root and non-empty level, followed by the
+     * lines of the rows "shared" and "total"
+     * @param names Name of every root, the labels of the variables are taken from the manager
+     */
+    void writeCsv(std::ostream &out, const std::vector<std::string> &names, ManagerInterface &mgr) const;
+};
+
+/**
+ * @brief Token of an open checkpoint, see Manager::checkpoint()
+ */
+struct Checkpoint {
+    size_t index;  ///< Position in the stack of open checkpoints
+    BDD_ID nextID; ///< First BDD_ID created after the checkpoint
+};
+
 class Manager : public ManagerInterface {
 public:
 // Constructor
     Manager(); // default constructor
-    Manager(const Manager &mgr) = default; // copy constructor
-    Manager(Manager &&mgr) = default; // move constructor
+    Manager(const Manager &mgr); // copy constructor, deep copy of the own nodes and the caches
+    Manager(Manager &&mgr); // move constructor
     Manager &operator=(const Manager &mgr) = default; // copy assignment
     Manager &operator=(Manager &&mgr) = default; // move assignment
 // Destructor
@@ -180,12 +470,263 @@ public:
      * @brief Visualizes the BDD rooted at the given root node
      */
     void visualizeBDD(std::string filepath, BDD_ID &root) override;
+
+// Resource governor
+    /**
+     * @brief Sets the resource limits checked while building BDDs.
+     * Exceeding a limit aborts the running operation with a BudgetExceeded exception.
+     */
+    void setLimits(const ResourceLimits &limits);
+
+    /**
+     * @brief Returns the currently configured resource limits
+     */
+    const ResourceLimits &getLimits() const;
+
+    /**
+     * @brief Returns the estimated memory of the node tables and caches in bytes
+     */
+    size_t estimatedMemory() const;
+
+    /**
+     * @brief Returns the memory of every internal structure: node store, unique table, caches, label tables
+     * and shared segments. Hash table entries are counted with their allocator block, load factors are included.
+     */
+    MemoryBreakdown memoryBreakdown() const;
+
+    /**
+     * @brief Counts the nodes of the given BDDs per variable level, shared and per root, in one pass over
+     * the reachable nodes.
+     * @param perRoot Also fill LevelProfile::roots and LevelProfile::shared. Without them only the totals are
+     * counted, with memory independent of the number of roots, cheap enough to be sampled while the BDDs are being built.
+     */
+    LevelProfile levelProfile(const std::vector<BDD_ID> &roots, bool perRoot = true);
+
+// Forking
+    /**
+     * @brief Returns a new manager that shares all current nodes of this manager read-only.
+     * Nodes created afterwards by either manager are stored in its own overlay and are not visible to the other.
+     * The fork starts with empty caches, labels are copied. Unlike the copy constructor no node is copied.
+     * A node store set with setNodeStore() is shared with the fork, its allocations are serialized by a mutex,
+     * so this manager and its forks may be used on different threads. A single manager is not thread-safe.
+     */
+    Manager fork();
+
+// Snapshots
+    /**
+     * @brief Writes all nodes, labels and the given named roots into a snapshot file that can be mapped by mapSnapshot().
+     * The nodes are stored as a plain array together with a hash index per level, so the file is used without parsing.
+     * Snapshots are only portable between builds with the same BDD_ID size and byte order.
+     * @throws std::logic_error if an operation is running, std::runtime_error if the file can not be written
+     */
+    void saveSnapshot(const std::string &path, const std::vector<std::pair<std::string, BDD_ID>> &roots = {});
+
+    /**
+     * @brief Returns a manager that uses the nodes of the snapshot file read-only and in place, like a fork.
+     * New nodes are stored in the heap of the returned manager. The file is mapped shared, so processes
+     * mapping the same snapshot share its pages in the page cache. Node BDD_IDs are the same as when saving.
+     * @param roots If not null, receives the named roots stored in the snapshot
+     * @throws std::runtime_error if the file can not be mapped or is not a valid snapshot
+     */
+    static Manager mapSnapshot(const std::string &path, std::vector<std::pair<std::string, BDD_ID>> *roots = nullptr);
+
+// Transactions
+    /**
+     * @brief Opens a checkpoint. All nodes and variables created afterwards can be dropped again with rollback().
+     * Checkpoints nest, closing a checkpoint also closes all checkpoints opened after it.
+     */
+    Checkpoint checkpoint();
+
+    /**
+     * @brief Drops all nodes and variables created since the checkpoint and the cache entries referring to them,
+     * then closes the checkpoint. BDD_IDs created since the checkpoint become invalid.
+     * @throws std::logic_error if the checkpoint is not open or the nodes were shared by fork() in the meantime
+     */
+    void rollback(const Checkpoint &token);
+
+    /**
+     * @brief Keeps all nodes created since the checkpoint and closes it
+     * @throws std::logic_error if the checkpoint is not open
+     */
+    void commit(const Checkpoint &token);
+
+// Memory management
+    /**
+     * @brief Drops all nodes, variables and cached results, leaving only the two terminals.
+     * The allocated capacity of the tables, including the entries of the computed tables, is kept for the next use.
+     * Limits, engine and cache policy settings are kept,
+     * the statistics are reset.
+     */
+    void clear();
+
+    /**
+     * @brief Pre-sizes the node store and unique table for the given number of nodes and the label tables
+     * for the given number of variables
+     */
+    void reserve(size_t nodes, size_t vars);
+
+    /**
+     * @brief Renumbers the nodes reachable from the given roots into a dense, level-ordered layout and frees all others.
+     * Variables are always kept and keep their relative order. The roots are rewritten in place,
+     * all other BDD_IDs obtained before the call become invalid. The caches are cleared.
+     * @param roots The BDDs to keep, updated to their new BDD_IDs
+     */
+    void compact(std::vector<BDD_ID> &roots);
+
+// Node store
+    /**
+     * @brief Moves the own nodes and the unique table into memory mapped from a temporary file in the given directory,
+     * or back into the heap if the directory is empty. The kernel can then write cold pages back to the file
+     * and drop them under memory pressure, instead of the process running out of memory.
+     * Nodes created later, also by forks of this manager, are stored in the same place. The caches stay in the heap.
+     * The store is shared with the forks and locks its allocations, each fork may run on a thread of its own.
+     * @throws std::logic_error if an operation is running, std::runtime_error if the file can not be created
+     */
+    void setNodeStore(const std::string &directory);
+
+// Computed tables
+    /**
+     * @brief Sets the sizing of the caches and resizes them to the initial number of entries, dropping results that do not fit.
+     * In adaptive mode a cache grows when more than 40% of its recent lookups missed because their slot
+     * was taken by other arguments while the unique table grew: to twice its size, or about one entry per node
+     * if that is more, as long as all caches stay below the memory ceiling. The caches start small, so managers
+     * with few nodes, forks and copies of them stay cheap, and the check runs more often while they are small.
+     * Caches larger than needed for the remaining nodes are shrunk again by compact() and rollback(). clear() keeps
+     * their size, so a manager reused for circuits of a similar size does not grow them again.
+     */
+    void setCachePolicy(const CachePolicy &policy);
+
+    /**
+     * @brief Returns the sizing of the caches
+     */
+    const CachePolicy &getCachePolicy() const;
+
+// Statistics
+    /**
+     * @brief Returns the operation statistics, see ManagerStats
+     */
+    ManagerStats stats() const;
+
+    /**
+     * @brief Resets the counters of the operation statistics and restarts their clock
+     */
+    void resetStats();
+
+// Apply engine
+    /**
+     * @brief Selects the algorithm used by ite. Both engines share the unique table and the ite cache.
+     */
+    void setApplyEngine(ApplyEngine engine);
+
+    /**
+     * @brief Returns the algorithm used by ite
+     */
+    ApplyEngine getApplyEngine() const;
+
+// Operation log
+    /**
+     * @brief Starts writing the public operations with their arguments and results to an operation log,
+     * see OperationLog.h. The nodes that already exist are written first, so the log replays on an empty manager.
+     * Copies of the manager do not record.
+     * @throws std::logic_error if already recording, during an operation or while a checkpoint is open
+     * @throws std::runtime_error if the file can not be created
+     */
+    void startRecording(const std::string &path);
+
+    /**
+     * @brief Ends the log started by startRecording()
+     * @return The number of records written
+     */
+    size_t stopRecording();
 protected:
 // Protected methods and variables
     BDD_ID ite_impl(BDD_ID i, BDD_ID t, BDD_ID e);
     BDD_ID coFactorTrue_impl(BDD_ID f, BDD_ID x);
     BDD_ID coFactorFalse_impl(BDD_ID f, BDD_ID x);
 
+    /**
+     * @brief Breadth-first ite: expands the requests level by level, then reduces them bottom-up.
+     * The arguments must not be a terminal case. Requests are looked up in the ite cache, but only the result of
+     * the top-level call is stored: the pending table already shares the requests within the call, and storing
+     * every reduced request would drive the adaptive growth of the cache for little reuse across calls.
+     */
+    BDD_ID ite_bfs(BDD_ID i, BDD_ID t, BDD_ID e);
+
+    /**
+     * @brief Moves the own nodes into a new read-only segment on top of the shared base
+     */
+    void freeze();
+
+    /**
+     * @brief Returns true if a public operation called now is the outermost one while recording
+     */
+    bool recordingOperation() const {
+        return recording.recorder && recordDepth == 0;
+    }
+
+    /**
+     * @brief Runs the operation and writes it with its arguments and result to the operation log.
+     * The operations it calls itself are not recorded.
+     */
+    template<typename F>
+    BDD_ID recordOperation(Operation op, std::initializer_list<uint64_t> args, F &&body) {
+        BDD_ID result;
+        {
+            RecordGuard guard(recordDepth);
+            result = body();
+        }
+        recording.recorder->write(op, args, result);
+        return result;
+    }
+
+    struct RecordGuard {
+        size_t &depth;
+        explicit RecordGuard(size_t &depth) : depth(depth) { ++depth; }
+        ~RecordGuard() { --depth; }
+    };
+
+    /**
+     * @brief Throws std::logic_error if the token does not belong to an open checkpoint
+     */
+    void checkCheckpoint(const Checkpoint &token, const char *caller) const;
+
+    /**
+     * @brief Returns the node (top, high, low), creating it if it does not exist yet.
+     * The high and low successors must differ.
+     */
+    BDD_ID makeNode(BDD_ID top, BDD_ID high, BDD_ID low);
+
+    /**
+     * @brief Called every sampleMask + 1 created nodes, adapts the cache sizes and records the trace counters
+     */
+    void sample();
+
+    /**
+     * @brief Grows the caches that lose too many results to conflicts, see setCachePolicy()
+     */
+    void growCaches();
+
+    /**
+     * @brief Shrinks the caches to the size needed for the current number of nodes
+     */
+    void shrinkCaches();
+
+    /**
+     * @brief Resizes a cache and records the decision in the statistics
+     */
+    template<typename C>
+    void resizeCache(C &cache, const char *name, size_t entries);
+
+    /**
+     * @brief Throws BudgetExceeded if the node or memory limit is reached
+     */
+    void checkNodeBudget();
+
+    /**
+     * @brief Throws BudgetExceeded if the deadline of the running top-level operation has passed
+     */
+    void checkTimeBudget();
+
     /**
      * @brief Node struct
      * Container for the BDD node information
@@ -214,10 +755,51 @@ protected:
         }
     };
 
-    // BDD_ID -> Node
-    std::unordered_map<BDD_ID, Node> uniqueTable;
-    // Node -> BDD_ID
-    std::unordered_map<Node, BDD_ID, NodeHash> reverseTable;
+    // Node store and unique table, allocated from the heap or from the file-backed arena, see setNodeStore()
+    using NodeVector = std::vector<Node, MappedAllocator<Node>>;
+    using NodeMap = std::unordered_map<Node, BDD_ID, NodeHash, std::equal_to<Node>, MappedAllocator<std::pair<const Node, BDD_ID>>>;
+
+    /**
+     * @brief Memory-mapped snapshot file, see saveSnapshot()
+     */
+    struct Snapshot;
+
+    /**
+     * @brief Read-only segment of nodes shared between forked managers
+     * Holds the nodes [begin, end) on top of the older nodes of its parent segment.
+     * The nodes and their unique table are either owned by the segment (freeze()) or by a mapped snapshot.
+     */
+    struct Segment {
+        std::shared_ptr<const Segment> parent;
+        BDD_ID begin = 0;
+        BDD_ID end = 0;
+        const Node *nodes = nullptr;
+        NodeVector storage;
+        NodeMap reverse;
+        std::shared_ptr<const Snapshot> snapshot;
+        const Node &node(BDD_ID id) const;
+        bool find(const Node &node, BDD_ID &id) const;
+    };
+
+    // Shared nodes [0, baseSize)
+    std::shared_ptr<const Segment> base;
+    BDD_ID baseSize = 0;
+
+    // File-backed memory of the own nodes, null if they are stored in the heap
+    std::shared_ptr<MappedArena> store;
+
+    // BDD_ID - baseSize -> Node, dense store of the own nodes
+    NodeVector uniqueTable;
+    // Node -> BDD_ID of the own nodes
+    NodeMap reverseTable;
+
+    /**
+     * @brief Returns the node with the given BDD_ID, from the own nodes or from the shared base
+     * @throws std::out_of_range if the node does not exist
+     */
+    const Node &getNode(BDD_ID id) const {
+        return id >= baseSize ? uniqueTable.at(id - baseSize) : base->node(id);
+    }
 
     // BDD_ID -> Label
     std::unordered_map<BDD_ID, std::string> labelTable;
@@ -227,6 +809,77 @@ protected:
     // next available BDD_ID, BDD_ID
     BDD_ID nextID = 0;
 
+    ApplyEngine engine = ApplyEngine::DepthFirst;
+
+    // nextID of the open checkpoints, innermost last
+    std::vector<BDD_ID> checkpoints;
+
+    /**
+     * @brief Request of the breadth-first engine
+     * The successors are either a BDD_ID or, with RequestFlag set, the index of another request.
+     */
+    struct Request {
+        BDD_ID i, t, e;
+        BDD_ID high, low;
+        BDD_ID result;
+    };
+    static constexpr BDD_ID RequestFlag = BDD_ID(1) << (8 * sizeof(BDD_ID) - 1);
+
+    /**
+     * @brief Working memory of the breadth-first engine, reused by all top-level calls
+     * The levels are flat vectors of request indices, kept in the order of their top variable by levelOrder.
+     * Pending requests are found through an open addressing table whose slots are emptied all at once by
+     * advancing the epoch. Copies of the manager start without it.
+     */
+    struct BfsScratch {
+        struct Slot {
+            uint32_t epoch = 0;   // The slot is empty unless it equals the current epoch
+            uint32_t request = 0;
+        };
+        std::vector<Request> requests;
+        std::vector<std::vector<size_t>> levels;           // Request indices of every level, the first levelCount in use
+        std::vector<std::pair<BDD_ID, size_t>> levelOrder; // Top variable and index into levels, ordered by the variable
+        size_t levelCount = 0;
+        std::vector<Slot> pending;
+        uint32_t epoch = 0;
+        std::vector<const void *> prefetch;
+        BfsScratch() = default;
+        BfsScratch(const BfsScratch &) {}
+        BfsScratch(BfsScratch &&) = default;
+        BfsScratch &operator=(const BfsScratch &) { return *this; }
+        BfsScratch &operator=(BfsScratch &&) = default;
+        size_t memoryUsage() const;
+    } bfs;
+
+    // Operation statistics, only the counters are kept up to date
+    ManagerStats statistics;
+    std::chrono::steady_clock::time_point statsStart = std::chrono::steady_clock::now();
+
+    CachePolicy cachePolicy;
+    // Nodes created between two calls of sample(), a power of two. Small caches are checked after
+    // as many nodes as their number of entries, but at least MinSampleInterval
+    static constexpr BDD_ID SampleInterval = BDD_ID(1) << 14;
+    static constexpr BDD_ID MinSampleInterval = BDD_ID(1) << 8;
+    BDD_ID sampleMask = SampleInterval - 1;
+
+    // Operation log, it stays with the manager it was started on: copies do not record, moves take it along
+    struct Recording {
+        std::unique_ptr<OperationRecorder> recorder;
+        Recording() = default;
+        Recording(const Recording &) {}
+        Recording(Recording &&) = default;
+        Recording &operator=(const Recording &) { return *this; }
+        Recording &operator=(Recording &&) = default;
+    } recording;
+    size_t recordDepth = 0; // nesting depth of recorded operations
+
+    // Resource governor
+    ResourceLimits limits;
+    bool budgetActive = false;
+    size_t opDepth = 0; // nesting depth of ite calls, 0 outside of any operation
+    size_t steps = 0;   // ite_impl calls, used to throttle the deadline check
+    std::chrono::steady_clock::time_point deadline;
+
 #if CLASSPROJECT_USECACHE
     // Caches
     Cache<BDD_ID, BDD_ID, BDD_ID, BDD_ID> iteCache;
@@ -0,0 +1,123 @@
+#include "MappedArena.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ClassProject {
+
+MappedArena::MappedArena(const std::string &directory)
+    : pageSize(static_cast<size_t>(sysconf(_SC_PAGESIZE)))
+    , freeLists(MaxSmall / Granularity + 1, nullptr)
+{
+    std::string path = (directory.empty() ? std::string(".") : directory) + "/vdsproject-nodes-XXXXXX";
+    fd = mkstemp(path.data());
+    if (fd < 0) {
+        throw std::runtime_error("MappedArena: unable to create " + path + ": " + std::strerror(errno));
+    }
+    // Only the open descriptor keeps the file alive, it disappears with the process
+    unlink(path.c_str());
+}
+
+MappedArena::~MappedArena() {
+    for (const auto &region : regions) {
+        munmap(region.first, region.second.second);
+    }
+    close(fd);
+}
+
+void *MappedArena::allocate(size_t bytes) {
+    std::lock_guard<std::mutex> guard(mutex);
+    bytes = std::max<size_t>(Granularity, (bytes + Granularity - 1) / Granularity * Granularity);
+    if (bytes > MaxSmall) {
+        return mapRegion(bytes);
+    }
+    void *&freeList = freeLists[bytes / Granularity];
+    if (freeList) {
+        void *ptr = freeList;
+        freeList = *static_cast<void **>(ptr);
+        return ptr;
+    }
+    if (chunkLeft < bytes) {
+        // The rest of the old chunk is lost, at most MaxSmall bytes per chunk
+        chunkPos = static_cast<char *>(mapRegion(ChunkSize));
+        chunkLeft = ChunkSize;
+    }
+    void *ptr = chunkPos;
+    chunkPos += bytes;
+    chunkLeft -= bytes;
+    return ptr;
+}
+
+void MappedArena::deallocate(void *ptr, size_t bytes) {
+    std::lock_guard<std::mutex> guard(mutex);
+    bytes = std::max<size_t>(Granularity, (bytes + Granularity - 1) / Granularity * Granularity);
+    if (bytes > MaxSmall) {
+        unmapRegion(ptr);
+        return;
+    }
+    void *&freeList = freeLists[bytes / Granularity];
+    *static_cast<void **>(ptr) = freeList;
+    freeList = ptr;
+}
+
+void MappedArena::prefetch(std::vector<const void *> &addresses) const {
+    const uintptr_t pageMask = ~static_cast<uintptr_t>(pageSize - 1);
+    for (auto &address : addresses) {
+        address = reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(address) & pageMask);
+    }
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+    // One madvise per run of adjacent pages
+    for (size_t first = 0; first < addresses.size();) {
+        size_t last = first;
+        while (last + 1 < addresses.size()
+               && reinterpret_cast<uintptr_t>(addresses[last + 1]) == reinterpret_cast<uintptr_t>(addresses[last]) + pageSize) {
+            last++;
+        }
+        madvise(const_cast<void *>(addresses[first]), (last - first + 1) * pageSize, MADV_WILLNEED);
+        first = last + 1;
+    }
+}
+
+size_t MappedArena::mappedBytes() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return mapped;
+}
+
+void *MappedArena::mapRegion(size_t bytes) {
+    bytes = (bytes + pageSize - 1) / pageSize * pageSize;
+    // Regions are appended to the file, the holes left by freed regions keep the file sparse
+    if (ftruncate(fd, fileSize + static_cast<off_t>(bytes)) != 0) {
+        throw std::bad_alloc();
+    }
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, fileSize);
+    if (ptr == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    regions.emplace(ptr, std::make_pair(fileSize, bytes));
+    fileSize += static_cast<off_t>(bytes);
+    mapped += bytes;
+    return ptr;
+}
+
+void MappedArena::unmapRegion(void *ptr) {
+    auto it = regions.find(ptr);
+    munmap(ptr, it->second.second);
+#ifdef FALLOC_FL_PUNCH_HOLE
+    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, it->second.first, static_cast<off_t>(it->second.second));
+#endif
+    mapped -= it->second.second;
+    regions.erase(it);
+}
+
+} // namespace ClassProject
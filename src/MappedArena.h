@@ -0,0 +1,118 @@
+// File-backed memory for the node store of the Manager
+//
+// Memory handed out by a MappedArena is a shared mapping of an unlinked temporary file. Under memory pressure
+// the kernel writes cold pages back to the file and drops them instead of having to keep them resident,
+// so a BDD larger than RAM slows down instead of getting the process killed.
+
+#ifndef VDSPROJECT_MAPPEDARENA_H
+#define VDSPROJECT_MAPPEDARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace ClassProject {
+
+/**
+ * @brief Allocator of file-backed memory.
+ * Small blocks are carved out of mapped chunks and recycled through free lists per size class,
+ * large blocks (arrays and hash buckets) get a mapping of their own that is unmapped and punched out of the file when freed.
+ * Allocation and release are serialized by a mutex, so forks of a manager sharing the arena can be used on different threads.
+ */
+class MappedArena {
+public:
+    /**
+     * @brief Creates the backing file in the given directory, the file is removed right away
+     * @throws std::runtime_error if the file can not be created
+     */
+    explicit MappedArena(const std::string &directory);
+    MappedArena(const MappedArena &) = delete;
+    MappedArena &operator=(const MappedArena &) = delete;
+    ~MappedArena();
+
+    void *allocate(size_t bytes);
+    void deallocate(void *ptr, size_t bytes);
+
+    /**
+     * @brief Asks the kernel to read the pages holding the given addresses ahead, the addresses are sorted in place
+     */
+    void prefetch(std::vector<const void *> &addresses) const;
+
+    /**
+     * @brief Returns the number of bytes currently mapped from the backing file
+     */
+    size_t mappedBytes() const;
+
+private:
+    static constexpr size_t Granularity = 16;
+    static constexpr size_t MaxSmall = 512;
+    static constexpr size_t ChunkSize = size_t(4) << 20;
+
+    void *mapRegion(size_t bytes);
+    void unmapRegion(void *ptr);
+
+    mutable std::mutex mutex;
+    int fd = -1;
+    off_t fileSize = 0;
+    size_t pageSize;
+    size_t mapped = 0;
+    std::unordered_map<void *, std::pair<off_t, size_t>> regions; // start of a mapping -> offset in the file, size
+    std::vector<void *> freeLists; // size class -> first free block, the next pointer is stored in the block
+    char *chunkPos = nullptr;
+    size_t chunkLeft = 0;
+};
+
+/**
+ * @brief Standard allocator on top of a MappedArena. Without an arena it allocates from the heap.
+ * The arena travels with the containers when they are copied, moved or swapped.
+ */
+template<typename T>
+class MappedAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    MappedAllocator() = default;
+    explicit MappedAllocator(std::shared_ptr<MappedArena> arena)
+        : arena(std::move(arena))
+    {}
+    template<typename U>
+    MappedAllocator(const MappedAllocator<U> &other)
+        : arena(other.arena)
+    {}
+
+    T *allocate(size_t n) {
+        return arena ? static_cast<T *>(arena->allocate(n * sizeof(T))) : std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *ptr, size_t n) {
+        if (arena) {
+            arena->deallocate(ptr, n * sizeof(T));
+        } else {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const MappedAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+    template<typename U>
+    bool operator!=(const MappedAllocator<U> &other) const {
+        return arena != other.arena;
+    }
+
+    std::shared_ptr<MappedArena> arena;
+};
+
+} // namespace ClassProject
+
+#endif
@@ -0,0 +1,335 @@
+#include "OperationLog.h"
+#include "Manager.h"
+
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace ClassProject {
+
+static const char OperationLogMagic[4] = {'V', 'D', 'S', 'O'};
+static const size_t FlushSize = size_t(1) << 16;
+
+OperationRecorder::OperationRecorder(const std::string &path)
+    : out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!out) {
+        throw std::runtime_error("OperationRecorder: unable to create " + path);
+    }
+    buffer.reserve(2 * FlushSize);
+    buffer.insert(buffer.end(), OperationLogMagic, OperationLogMagic + sizeof(OperationLogMagic));
+    writeVarint(OperationLogVersion);
+}
+
+OperationRecorder::~OperationRecorder() {
+    if (out.is_open()) {
+        finish();
+    }
+}
+
+void OperationRecorder::write(Operation op, std::initializer_list<uint64_t> args) {
+    buffer.push_back(static_cast<char>(op));
+    for (uint64_t arg : args) {
+        writeVarint(arg);
+    }
+    endRecord();
+}
+
+void OperationRecorder::write(Operation op, std::initializer_list<uint64_t> args, BDD_ID result) {
+    buffer.push_back(static_cast<char>(op));
+    for (uint64_t arg : args) {
+        writeVarint(arg);
+    }
+    writeVarint(result);
+    endRecord();
+}
+
+void OperationRecorder::writeVar(const std::string &label, BDD_ID result) {
+    buffer.push_back(static_cast<char>(Operation::CreateVar));
+    writeVarint(label.size());
+    buffer.insert(buffer.end(), label.begin(), label.end());
+    writeVarint(result);
+    endRecord();
+}
+
+void OperationRecorder::writeCompact(const std::vector<BDD_ID> &before, const std::vector<BDD_ID> &after) {
+    buffer.push_back(static_cast<char>(Operation::Compact));
+    writeVarint(before.size());
+    for (BDD_ID id : before) {
+        writeVarint(id);
+    }
+    for (BDD_ID id : after) {
+        writeVarint(id);
+    }
+    endRecord();
+}
+
+void OperationRecorder::finish() {
+    buffer.push_back(static_cast<char>(Operation::End));
+    flush();
+    out.close();
+}
+
+size_t OperationRecorder::operations() const {
+    return records;
+}
+
+void OperationRecorder::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+void OperationRecorder::endRecord() {
+    records++;
+    if (buffer.size() >= FlushSize) {
+        flush();
+    }
+}
+
+void OperationRecorder::flush() {
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+namespace {
+
+// Decoder over the loaded log
+struct LogReader {
+    const unsigned char *pos;
+    const unsigned char *end;
+
+    bool atEnd() const {
+        return pos == end;
+    }
+
+    uint8_t byte() {
+        if (pos == end) {
+            throw std::runtime_error("OperationReplayer: truncated log");
+        }
+        return *pos++;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("OperationReplayer: malformed varint");
+    }
+
+    std::string string() {
+        uint64_t size = varint();
+        if (size > static_cast<uint64_t>(end - pos)) {
+            throw std::runtime_error("OperationReplayer: truncated log");
+        }
+        std::string str(reinterpret_cast<const char *>(pos), size);
+        pos += size;
+        return str;
+    }
+};
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Structural hash of a BDD: variables by their label, nodes by the hashes of their top variable and successors.
+// Memoized per BDD_ID of the replaying manager.
+struct StructuralHasher {
+    Manager &mgr;
+    std::vector<uint64_t> memo;
+
+    uint64_t hash(BDD_ID f) {
+        if (mgr.isConstant(f)) {
+            return f + 1;
+        }
+        if (f < memo.size() && memo[f] != 0) {
+            return memo[f];
+        }
+        uint64_t h;
+        if (mgr.isVariable(f)) {
+            // FNV-1a of the label
+            h = 0xCBF29CE484222325ull;
+            for (char c : mgr.getTopVarName(f)) {
+                h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+            }
+            h = mix(h);
+        } else {
+            h = mix(hash(mgr.topVar(f)) * 0x9E3779B97F4A7C15ull ^ mix(hash(mgr.coFactorTrue(f)) + 1) ^ hash(mgr.coFactorFalse(f)));
+        }
+        h += (h == 0);
+        if (f >= memo.size()) {
+            memo.resize(f + 1, 0);
+        }
+        memo[f] = h;
+        return h;
+    }
+};
+
+} // namespace
+
+ReplayResult OperationReplayer::replay(const std::string &path, Manager &mgr, bool checksum) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("OperationReplayer: unable to read " + path);
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    LogReader reader{reinterpret_cast<const unsigned char *>(data.data()),
+                     reinterpret_cast<const unsigned char *>(data.data()) + data.size()};
+    for (char c : OperationLogMagic) {
+        if (reader.atEnd() || reader.byte() != static_cast<uint8_t>(c)) {
+            throw std::runtime_error("OperationReplayer: " + path + " is not an operation log");
+        }
+    }
+    if (reader.varint() != OperationLogVersion) {
+        throw std::runtime_error("OperationReplayer: unsupported log version");
+    }
+
+    // Recorded BDD_ID -> BDD_ID of the replay
+    const BDD_ID Unmapped = std::numeric_limits<BDD_ID>::max();
+    std::vector<BDD_ID> ids{mgr.False(), mgr.True()};
+    auto id = [&](uint64_t recorded) {
+        if (recorded >= ids.size() || ids[recorded] == Unmapped) {
+            throw std::runtime_error("OperationReplayer: operand " + std::to_string(recorded) + " was not created by the log");
+        }
+        return ids[recorded];
+    };
+    auto map = [&](uint64_t recorded, BDD_ID replayed) {
+        if (recorded >= ids.size()) {
+            ids.resize(recorded + 1, Unmapped);
+        }
+        ids[recorded] = replayed;
+    };
+
+    ReplayResult result;
+    StructuralHasher hasher{mgr, {}};
+    std::vector<Checkpoint> checkpoints;
+    auto finish = [&](BDD_ID replayed) {
+        map(reader.varint(), replayed);
+        if (checksum) {
+            result.checksum = mix(result.checksum ^ hasher.hash(replayed));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    bool ended = false;
+    while (!ended && !reader.atEnd()) {
+        auto op = static_cast<Operation>(reader.byte());
+        switch (op) {
+        case Operation::CreateVar: {
+            std::string label = reader.string();
+            finish(mgr.createVar(label));
+            break;
+        }
+        case Operation::Ite:
+        case Operation::Node: {
+            BDD_ID i = id(reader.varint());
+            BDD_ID t = id(reader.varint());
+            BDD_ID e = id(reader.varint());
+            finish(mgr.ite(i, t, e));
+            break;
+        }
+        case Operation::CoFactorTrue:
+        case Operation::CoFactorFalse:
+        case Operation::And2:
+        case Operation::Or2:
+        case Operation::Xor2:
+        case Operation::Nand2:
+        case Operation::Nor2:
+        case Operation::Xnor2: {
+            BDD_ID a = id(reader.varint());
+            BDD_ID b = id(reader.varint());
+            BDD_ID r = op == Operation::CoFactorTrue ? mgr.coFactorTrue(a, b)
+                     : op == Operation::CoFactorFalse ? mgr.coFactorFalse(a, b)
+                     : op == Operation::And2 ? mgr.and2(a, b)
+                     : op == Operation::Or2 ? mgr.or2(a, b)
+                     : op == Operation::Xor2 ? mgr.xor2(a, b)
+                     : op == Operation::Nand2 ? mgr.nand2(a, b)
+                     : op == Operation::Nor2 ? mgr.nor2(a, b)
+                     : mgr.xnor2(a, b);
+            finish(r);
+            break;
+        }
+        case Operation::CoFactorTopTrue:
+        case Operation::CoFactorTopFalse:
+        case Operation::Neg: {
+            BDD_ID a = id(reader.varint());
+            finish(op == Operation::CoFactorTopTrue ? mgr.coFactorTrue(a)
+                   : op == Operation::CoFactorTopFalse ? mgr.coFactorFalse(a)
+                   : mgr.neg(a));
+            break;
+        }
+        case Operation::Checkpoint: {
+            uint64_t index = reader.varint();
+            checkpoints.resize(index);
+            checkpoints.push_back(mgr.checkpoint());
+            break;
+        }
+        case Operation::Rollback:
+        case Operation::Commit: {
+            uint64_t index = reader.varint();
+            if (index >= checkpoints.size()) {
+                throw std::runtime_error("OperationReplayer: checkpoint " + std::to_string(index) + " is not open");
+            }
+            Checkpoint token = checkpoints[index];
+            checkpoints.resize(index);
+            if (op == Operation::Rollback) {
+                mgr.rollback(token);
+                // The freed BDD_IDs are handed out again
+                if (hasher.memo.size() > token.nextID) {
+                    hasher.memo.resize(token.nextID);
+                }
+            } else {
+                mgr.commit(token);
+            }
+            break;
+        }
+        case Operation::Clear:
+            mgr.clear();
+            ids.assign({mgr.False(), mgr.True()});
+            hasher.memo.clear();
+            checkpoints.clear();
+            break;
+        case Operation::Compact: {
+            uint64_t count = reader.varint();
+            std::vector<BDD_ID> roots;
+            for (uint64_t i = 0; i < count; i++) {
+                roots.push_back(id(reader.varint()));
+            }
+            mgr.compact(roots);
+            // Variables keep their relative order, after a compaction they are numbered from 2 in both managers
+            ids.assign({mgr.False(), mgr.True()});
+            for (BDD_ID var = 2; var < mgr.uniqueTableSize() && mgr.isVariable(var); var++) {
+                map(var, var);
+            }
+            hasher.memo.clear();
+            for (BDD_ID root : roots) {
+                finish(root);
+            }
+            break;
+        }
+        case Operation::End:
+            ended = true;
+            continue;
+        default:
+            throw std::runtime_error("OperationReplayer: unknown operation " + std::to_string(static_cast<int>(op)));
+        }
+        result.operations++;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // namespace ClassProject
@@ -0,0 +1,124 @@
+// Recording and replay of the operations on a Manager
+//
+// File layout (all integers are LEB128 varints unless noted otherwise):
+//   header  "VDSO" (4 bytes), format version
+//   records operation byte followed by the payload, BDD_IDs are the ones of the recording manager
+//     CreateVar        label result
+//     Ite              i t e result
+//     CoFactorTrue     f x result              CoFactorFalse      f x result
+//     CoFactorTopTrue  f result                CoFactorTopFalse   f result
+//     And2, Or2, Xor2, Nand2, Nor2, Xnor2      a b result
+//     Neg              a result
+//     Node             top high low result     node that existed when the recording started
+//     Checkpoint       index                   Rollback, Commit   index
+//     Clear
+//     Compact          count roots... roots after the compaction...
+//     End
+// Only the outermost operations are recorded, not the calls they make themselves. A replay maps the recorded
+// BDD_IDs to its own, so the log can be replayed with another engine, cache policy or node store.
+
+#ifndef VDSPROJECT_OPERATIONLOG_H
+#define VDSPROJECT_OPERATIONLOG_H
+
+#include "ManagerInterface.h"
+
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace ClassProject {
+
+class Manager;
+
+static const uint32_t OperationLogVersion = 1;
+
+enum class Operation : uint8_t {
+    CreateVar = 1,
+    Ite,
+    CoFactorTrue,
+    CoFactorFalse,
+    CoFactorTopTrue,
+    CoFactorTopFalse,
+    And2,
+    Or2,
+    Xor2,
+    Neg,
+    Nand2,
+    Nor2,
+    Xnor2,
+    Node,
+    Checkpoint,
+    Rollback,
+    Commit,
+    Clear,
+    Compact,
+    End
+};
+
+/**
+ * @brief Buffered writer of an operation log, see Manager::startRecording()
+ */
+class OperationRecorder {
+public:
+    /**
+     * @brief Creates the file and writes the header
+     * @throws std::runtime_error if the file can not be created
+     */
+    explicit OperationRecorder(const std::string &path);
+    OperationRecorder(const OperationRecorder &) = delete;
+    OperationRecorder &operator=(const OperationRecorder &) = delete;
+    ~OperationRecorder();
+
+    void write(Operation op, std::initializer_list<uint64_t> args);
+    void write(Operation op, std::initializer_list<uint64_t> args, BDD_ID result);
+    void writeVar(const std::string &label, BDD_ID result);
+    void writeCompact(const std::vector<BDD_ID> &before, const std::vector<BDD_ID> &after);
+
+    /**
+     * @brief Writes the end marker and closes the file
+     */
+    void finish();
+
+    /**
+     * @brief Returns the number of records written so far
+     */
+    size_t operations() const;
+
+private:
+    void writeVarint(uint64_t value);
+    void endRecord();
+    void flush();
+
+    std::ofstream out;
+    std::vector<char> buffer;
+    size_t records = 0;
+};
+
+/**
+ * @brief Result of a replay
+ */
+struct ReplayResult {
+    size_t operations = 0;  ///< Records executed
+    uint64_t checksum = 0;  ///< Combined structural hash of all results, independent of the BDD_IDs, 0 if not computed
+    double seconds = 0;     ///< Wall-clock time of the execution, without reading the file
+};
+
+/**
+ * @brief Re-executes an operation log
+ */
+class OperationReplayer {
+public:
+    /**
+     * @brief Reads the whole log and executes it on the manager
+     * @param checksum Also hash the result of every operation. The hashes are computed once per node, but they are
+     *                 part of the measured time.
+     * @throws std::runtime_error if the file is not a valid log
+     */
+    static ReplayResult replay(const std::string &path, Manager &mgr, bool checksum = true);
+};
+
+} // namespace ClassProject
+
+#endif
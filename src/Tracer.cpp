@@ -0,0 +1,133 @@
+#include "Tracer.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ClassProject {
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    const char *category; // nullptr for counter events
+    uint64_t begin;
+    uint64_t end;
+    double value;
+    std::string detail;
+};
+
+struct ThreadBuffer {
+    unsigned tid;
+    std::vector<TraceEvent> events;
+};
+
+// All buffers ever created, they outlive their threads so the events can still be written.
+// The mutex is only taken when a thread records its first event and when the trace is written or cleared.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+std::atomic<int64_t> epoch{0};
+
+ThreadBuffer &localBuffer() {
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        buffer = registry.back().get();
+        buffer->tid = static_cast<unsigned>(registry.size());
+    }
+    return *buffer;
+}
+
+void writeString(std::ostream &out, const char *str) {
+    out << '"';
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            out << '\\' << *str;
+        } else if (static_cast<unsigned char>(*str) >= 0x20) {
+            out << *str;
+        }
+    }
+    out << '"';
+}
+
+// Microseconds with all three decimals of the nanoseconds, exact for any length of the trace
+void writeMicroseconds(std::ostream &out, uint64_t nanoseconds) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%03u", nanoseconds / 1000, static_cast<unsigned>(nanoseconds % 1000));
+    out << buffer;
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::active{false};
+
+void Tracer::enable() {
+    int64_t none = 0;
+    epoch.compare_exchange_strong(none, std::chrono::steady_clock::now().time_since_epoch().count());
+    active.store(true);
+}
+
+void Tracer::disable() {
+    active.store(false);
+}
+
+uint64_t Tracer::now() {
+    auto ticks = std::chrono::steady_clock::now().time_since_epoch().count() - epoch.load(std::memory_order_relaxed);
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(ticks)).count());
+}
+
+void Tracer::complete(const char *name, const char *category, uint64_t begin, uint64_t end, const std::string &detail) {
+    localBuffer().events.push_back(TraceEvent{name, category, begin, end, 0, detail});
+}
+
+void Tracer::counter(const char *name, double value) {
+    if (!enabled()) {
+        return;
+    }
+    uint64_t time = now();
+    localBuffer().events.push_back(TraceEvent{name, nullptr, time, time, value, std::string()});
+}
+
+void Tracer::write(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (const auto &buffer : registry) {
+        for (const auto &event : buffer->events) {
+            out << (first ? "\n" : ",\n") << "{\"name\": ";
+            writeString(out, event.name);
+            // Timestamps are in microseconds
+            out << ", \"pid\": 1, \"tid\": " << buffer->tid << ", \"ts\": ";
+            writeMicroseconds(out, event.begin);
+            if (event.category) {
+                out << ", \"ph\": \"X\", \"cat\": ";
+                writeString(out, event.category);
+                out << ", \"dur\": ";
+                writeMicroseconds(out, event.end - event.begin);
+                if (!event.detail.empty()) {
+                    out << ", \"args\": {\"detail\": ";
+                    writeString(out, event.detail.c_str());
+                    out << "}";
+                }
+            } else {
+                out << ", \"ph\": \"C\", \"args\": {\"value\": " << event.value << "}";
+            }
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto &buffer : registry) {
+        buffer->events.clear();
+    }
+}
+
+} // namespace ClassProject
@@ -0,0 +1,97 @@
+// Timeline tracing in the Chrome trace-event format
+//
+// The recorded events are written as JSON that chrome://tracing and ui.perfetto.dev can open.
+// Every thread appends to a buffer of its own, so recording takes no lock. Tracing is off by default,
+// a disabled tracer costs one relaxed atomic load per span.
+
+#ifndef VDSPROJECT_TRACER_H
+#define VDSPROJECT_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace ClassProject {
+
+/**
+ * @brief Process-wide recorder of trace events
+ * Names and categories must be string literals (or otherwise outlive the tracer), details are copied.
+ */
+class Tracer {
+public:
+    /**
+     * @brief Starts recording, the timestamps of the events are relative to the first call
+     */
+    static void enable();
+
+    /**
+     * @brief Stops recording, the recorded events are kept until clear()
+     */
+    static void disable();
+
+    static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the current time in nanoseconds on the clock of the trace
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Records a span [begin, end) of the calling thread
+     */
+    static void complete(const char *name, const char *category, uint64_t begin, uint64_t end, const std::string &detail = "");
+
+    /**
+     * @brief Records a value of a counter track
+     */
+    static void counter(const char *name, double value);
+
+    /**
+     * @brief Writes all recorded events as a trace-event JSON object.
+     * No thread may record events while the trace is written.
+     */
+    static void write(std::ostream &out);
+
+    /**
+     * @brief Drops all recorded events
+     */
+    static void clear();
+
+private:
+    static std::atomic<bool> active;
+};
+
+/**
+ * @brief Records the lifetime of the object as a span, if the tracer is enabled when it is created
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char *name, const char *category, std::string detail = "")
+        : name(name)
+        , category(category)
+        , detail(std::move(detail))
+        , recording(Tracer::enabled())
+        , begin(recording ? Tracer::now() : 0)
+    {}
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+    ~TraceSpan() {
+        if (recording) {
+            Tracer::complete(name, category, begin, Tracer::now(), detail);
+        }
+    }
+private:
+    const char *name;
+    const char *category;
+    std::string detail;
+    bool recording;
+    uint64_t begin;
+};
+
+} // namespace ClassProject
+
+#endif
@@ -0,0 +1,579 @@
+//
+// Hand-written scanner of the ISCAS85/89/99 bench format over a memory-mapped file
+//
+
+#include "BenchLexer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *const gate_type_names[] = {"INPUT", "OUTPUT", "DFF", "BUFF", "NOT", "AND", "OR", "NAND", "NOR", "XOR"};
+
+const char *GateTypeName(GateType type) {
+    return gate_type_names[static_cast<size_t>(type)];
+}
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not read file: " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map file: " + path);
+        }
+        /* The file is read front to back once */
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapped);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char *>(data), size);
+    }
+}
+
+uint64_t LabelTable::Hash(std::string_view label) {
+    /* Eight bytes at a time, most labels fit into one or two words */
+    uint64_t h = label.size() * 0x9E3779B97F4A7C15ull;
+    size_t i = 0;
+    for (; i + 8 <= label.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, label.data() + i, 8);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    if (i < label.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, label.data() + i, label.size() - i);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ull;
+    }
+    h ^= h >> 32;
+    h *= 0x94D049BB133111EBull;
+    return h ^ (h >> 29);
+}
+
+uint32_t LabelTable::Intern(std::string_view label) {
+    uint64_t h = Hash(label);
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        Slot &slot = slots[i];
+        if (slot.id == Empty) {
+            uint32_t id = static_cast<uint32_t>(Size());
+            slot.hash = tag;
+            slot.id = id;
+            chars.insert(chars.end(), label.begin(), label.end());
+            offsets.push_back(chars.size());
+            /* Keep the load factor below 1/2 */
+            if (2 * Size() > slots.size()) {
+                Grow();
+            }
+            return id;
+        }
+        if (slot.hash == tag && Label(slot.id) == label) {
+            return slot.id;
+        }
+    }
+}
+
+bool LabelTable::Find(std::string_view label, uint32_t &id) const {
+    uint64_t h = Hash(label);
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask; slots[i].id != Empty; i = (i + 1) & mask) {
+        if (slots[i].hash == tag && Label(slots[i].id) == label) {
+            id = slots[i].id;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LabelTable::Reserve(size_t count, size_t bytes) {
+    offsets.reserve(count + 1);
+    chars.reserve(bytes);
+    while (2 * count > slots.size()) {
+        Grow();
+    }
+}
+
+void LabelTable::ShrinkToFit() {
+    chars.shrink_to_fit();
+    offsets.shrink_to_fit();
+    /* Lookups only from now on, rebuild the hash table with a load factor up to 3/4 */
+    size_t size = 16;
+    while (4 * Size() > 3 * size) {
+        size *= 2;
+    }
+    if (size < slots.size()) {
+        Rehash(size);
+    }
+}
+
+size_t LabelTable::MemoryUsage() const {
+    return slots.capacity() * sizeof(Slot) + chars.capacity() + offsets.capacity() * sizeof(uint64_t);
+}
+
+void LabelTable::Grow() {
+    Rehash(2 * slots.size());
+}
+
+void LabelTable::Rehash(size_t size) {
+    std::vector<Slot> rehashed(size);
+    slots.swap(rehashed);
+    size_t mask = slots.size() - 1;
+    /* The slots are hashed a few labels ahead and prefetched, so the cache misses overlap */
+    constexpr uint32_t Ahead = 8;
+    uint64_t ahead[Ahead];
+    uint32_t count = static_cast<uint32_t>(Size());
+    for (uint32_t id = 0; id < std::min(count, Ahead); id++) {
+        ahead[id] = Hash(Label(id));
+        __builtin_prefetch(&slots[ahead[id] & mask], 1);
+    }
+    for (uint32_t id = 0; id < count; id++) {
+        uint64_t h = ahead[id % Ahead];
+        if (id + Ahead < count) {
+            ahead[id % Ahead] = Hash(Label(id + Ahead));
+            __builtin_prefetch(&slots[ahead[id % Ahead] & mask], 1);
+        }
+        size_t i = h & mask;
+        while (slots[i].id != Empty) {
+            i = (i + 1) & mask;
+        }
+        slots[i].hash = static_cast<uint32_t>(h >> 32);
+        slots[i].id = id;
+    }
+}
+
+LabelTable LabelTable::FromLabels(std::vector<char> chars, std::vector<uint64_t> offsets) {
+    LabelTable table;
+    table.chars = std::move(chars);
+    table.offsets = std::move(offsets);
+    size_t size = 16;
+    while (2 * table.Size() > size) {
+        size *= 2;
+    }
+    table.Rehash(size);
+    return table;
+}
+
+BenchParseError::BenchParseError(const std::string &file, size_t line, size_t column, const std::string &message)
+    : std::runtime_error(file + ":" + std::to_string(line) + ":" + std::to_string(column) + ": " + message),
+      line(line), column(column), message(message) {}
+
+/* Character classes of the scanner */
+enum : uint8_t { LabelChar = 0, Blank = 1, Delimiter = 2 };
+
+struct CharClasses {
+    uint8_t table[256];
+
+    CharClasses() : table() {
+        for (unsigned char c : std::string_view(" \t\r\f\v")) {
+            table[c] = Blank;
+        }
+        for (unsigned char c : std::string_view("\n#(),=")) {
+            table[c] = Delimiter;
+        }
+    }
+};
+
+static const CharClasses char_classes;
+
+static bool IsBlank(char c) {
+    return char_classes.table[static_cast<unsigned char>(c)] == Blank;
+}
+
+static bool IsLabelChar(char c) {
+    return char_classes.table[static_cast<unsigned char>(c)] == LabelChar;
+}
+
+namespace {
+
+/*
+ * Scans a range of whole lines, the whole file or one chunk of it.
+ *  Lines are counted from the start of the range.
+ */
+class ChunkScanner {
+public:
+    ChunkScanner(std::string_view text, const std::string &file_name)
+        : file_name(file_name), pos(text.data()), end(text.data() + text.size()), line_start(text.data()) {
+        /* Roughly one statement, one new label and two inputs per 32 bytes */
+        statements.reserve(text.size() / 32);
+        inputs.reserve(text.size() / 16);
+        labels.Reserve(text.size() / 32, text.size() / 4);
+    }
+
+    void Scan();
+
+    /* Number of line breaks scanned */
+    uint32_t Lines() const { return line - 1; }
+
+    LabelTable labels;
+    std::vector<BenchStatement> statements;
+    std::vector<uint32_t> inputs;
+
+private:
+    const std::string &file_name;
+    const char *pos;
+    const char *end;
+    const char *line_start;
+    uint32_t line = 1;
+
+    void SkipBlanks();
+    std::string_view Label(const char *expected);
+    void Expect(char c, const char *expected);
+    std::string Found(const char *at) const;
+    [[noreturn]] void Error(const char *at, const std::string &message) const;
+};
+
+void ChunkScanner::Scan() {
+    while (true) {
+        SkipBlanks();
+        if (pos == end) {
+            break;
+        }
+        if (*pos == '\n' || *pos == '#') {
+            /* Empty line or comment line */
+            while (pos != end && *pos != '\n') {
+                ++pos;
+            }
+            if (pos != end) {
+                ++pos;
+                ++line;
+                line_start = pos;
+            }
+            continue;
+        }
+
+        BenchStatement statement{GateType::Input, 0, static_cast<uint32_t>(inputs.size()), 0, line};
+        const char *first_token = pos;
+        std::string_view first = Label("a gate label, INPUT or OUTPUT");
+        SkipBlanks();
+        if (pos != end && *pos == '(') {
+            if (first == "INPUT") {
+                statement.type = GateType::Input;
+            } else if (first == "OUTPUT") {
+                statement.type = GateType::Output;
+            } else {
+                Error(first_token, "expected INPUT or OUTPUT before '(', found '" + std::string(first) + "'");
+            }
+            ++pos;
+            statement.label = labels.Intern(Label("a label"));
+            Expect(')', "')'");
+        } else {
+            statement.label = labels.Intern(first);
+            Expect('=', "'=' after the gate label");
+            SkipBlanks();
+            const char *keyword_start = pos;
+            std::string_view keyword = Label("a gate type");
+            bool single_input = true;
+            if (keyword == "NOT") {
+                statement.type = GateType::Not;
+            } else if (keyword == "BUFF") {
+                statement.type = GateType::Buff;
+            } else if (keyword == "DFF") {
+                statement.type = GateType::Dff;
+            } else {
+                single_input = false;
+                if (keyword == "AND") {
+                    statement.type = GateType::And;
+                } else if (keyword == "OR") {
+                    statement.type = GateType::Or;
+                } else if (keyword == "NAND") {
+                    statement.type = GateType::Nand;
+                } else if (keyword == "NOR") {
+                    statement.type = GateType::Nor;
+                } else if (keyword == "XOR") {
+                    statement.type = GateType::Xor;
+                } else {
+                    Error(keyword_start, "unknown gate type '" + std::string(keyword) + "'");
+                }
+            }
+            Expect('(', "'(' after the gate type");
+            while (true) {
+                inputs.push_back(labels.Intern(Label("an input label")));
+                SkipBlanks();
+                if (pos != end && *pos == ',') {
+                    ++pos;
+                    continue;
+                }
+                Expect(')', "',' or ')' after the input label");
+                break;
+            }
+            statement.input_count = static_cast<uint32_t>(inputs.size()) - statement.first_input;
+            if (single_input && statement.input_count != 1) {
+                Error(keyword_start, std::string(GateTypeName(statement.type)) + " takes exactly one input");
+            } else if (!single_input && statement.input_count < 2) {
+                Error(keyword_start, std::string(GateTypeName(statement.type)) + " takes at least two inputs");
+            }
+        }
+
+        SkipBlanks();
+        if (pos != end && *pos != '\n' && *pos != '#') {
+            Error(pos, "expected the end of the line" + Found(pos));
+        }
+        statements.push_back(statement);
+    }
+}
+
+void ChunkScanner::SkipBlanks() {
+    const char *p = pos;
+    while (p != end && IsBlank(*p)) {
+        ++p;
+    }
+    pos = p;
+}
+
+std::string_view ChunkScanner::Label(const char *expected) {
+    SkipBlanks();
+    const char *start = pos;
+    const char *p = start;
+    while (p != end && IsLabelChar(*p)) {
+        ++p;
+    }
+    pos = p;
+    if (p == start) {
+        Error(p, std::string("expected ") + expected + Found(p));
+    }
+    return {start, static_cast<size_t>(p - start)};
+}
+
+void ChunkScanner::Expect(char c, const char *expected) {
+    SkipBlanks();
+    if (pos == end || *pos != c) {
+        Error(pos, std::string("expected ") + expected + Found(pos));
+    }
+    ++pos;
+}
+
+std::string ChunkScanner::Found(const char *at) const {
+    return at == end ? ", found the end of the file" : *at == '\n' ? ", found the end of the line" : ", found '" + std::string(1, *at) + "'";
+}
+
+void ChunkScanner::Error(const char *at, const std::string &message) const {
+    throw BenchParseError(file_name, line, static_cast<size_t>(at - line_start) + 1, message);
+}
+
+} // namespace
+
+/* Splits the text into about the given number of chunks, each ending after a line break or at the end */
+static std::vector<std::string_view> SplitAtLines(std::string_view text, size_t chunks) {
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    for (size_t i = 1; i <= chunks && start < text.size(); i++) {
+        size_t cut = text.size();
+        if (i < chunks) {
+            size_t line_break = text.find('\n', std::max(start, text.size() / chunks * i));
+            cut = line_break == std::string_view::npos ? text.size() : line_break + 1;
+        }
+        parts.push_back(text.substr(start, cut - start));
+        start = cut;
+    }
+    return parts;
+}
+
+/* Runs task(0) ... task(count - 1) on up to the given number of threads, including the calling one */
+static void RunOnThreads(size_t count, unsigned threads, const std::function<void(size_t)> &task) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min<size_t>(threads, count); t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+/*
+ * Merges the label tables of the chunks into one, with the IDs one pass over the file would hand out:
+ *  in the order of the first occurrence. Returns the file-wide ID of every label of every chunk.
+ *
+ *  1. Every shard, one part of the hash values, interns the labels of all chunks in the order of the
+ *     chunks. The first chunk adding a label to its shard owns the label.
+ *  2. Every chunk numbers the labels it owns in its own order, after all labels owned by earlier chunks,
+ *     and copies their characters into the merged table.
+ *  3. Every chunk looks up the IDs of the labels owned by earlier chunks through the shards.
+ */
+static std::vector<std::vector<uint32_t>> MergeLabels(std::vector<std::unique_ptr<ChunkScanner>> &chunks, unsigned threads,
+                                                      LabelTable &labels) {
+    size_t chunk_count = chunks.size();
+    uint32_t shard_count = std::max(threads, 1u);
+    std::vector<std::vector<uint32_t>> shard_of(chunk_count);   // Shard of every label of every chunk
+    std::vector<std::vector<uint32_t>> shard_ids(chunk_count);  // ID of every label of every chunk in its shard
+    std::vector<std::vector<uint8_t>> owned(chunk_count);       // Whether the chunk owns the label
+    std::vector<std::vector<std::vector<uint32_t>>> by_shard(chunk_count);
+    RunOnThreads(chunk_count, threads, [&](size_t c) {
+        const LabelTable &chunk_labels = chunks[c]->labels;
+        shard_of[c].resize(chunk_labels.Size());
+        shard_ids[c].resize(chunk_labels.Size());
+        owned[c].resize(chunk_labels.Size());
+        by_shard[c].resize(shard_count);
+        for (uint32_t id = 0; id < chunk_labels.Size(); id++) {
+            uint32_t tag = static_cast<uint32_t>(LabelTable::Hash(chunk_labels.Label(id)) >> 32);
+            shard_of[c][id] = static_cast<uint32_t>(uint64_t(tag) * shard_count >> 32);
+            by_shard[c][shard_of[c][id]].push_back(id);
+        }
+    });
+
+    std::vector<LabelTable> shards(shard_count);
+    RunOnThreads(shard_count, threads, [&](size_t s) {
+        for (size_t c = 0; c < chunk_count; c++) {
+            const LabelTable &chunk_labels = chunks[c]->labels;
+            for (uint32_t id : by_shard[c][s]) {
+                size_t known = shards[s].Size();
+                shard_ids[c][id] = shards[s].Intern(chunk_labels.Label(id));
+                owned[c][id] = shard_ids[c][id] == known;
+            }
+        }
+    });
+
+    /* Every chunk's labels start after those of the chunks before it */
+    std::vector<uint32_t> first_ids(chunk_count + 1, 0);
+    std::vector<uint64_t> first_chars(chunk_count + 1, 0);
+    for (size_t c = 0; c < chunk_count; c++) {
+        const LabelTable &chunk_labels = chunks[c]->labels;
+        first_ids[c + 1] = first_ids[c];
+        first_chars[c + 1] = first_chars[c];
+        for (uint32_t id = 0; id < chunk_labels.Size(); id++) {
+            if (owned[c][id]) {
+                first_ids[c + 1]++;
+                first_chars[c + 1] += chunk_labels.Label(id).size();
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> shard_to_file(shard_count);
+    for (uint32_t s = 0; s < shard_count; s++) {
+        shard_to_file[s].resize(shards[s].Size());
+        shards[s] = LabelTable();
+    }
+    std::vector<char> chars(first_chars[chunk_count]);
+    std::vector<uint64_t> offsets(first_ids[chunk_count] + 1, 0);
+    std::vector<std::vector<uint32_t>> file_ids(chunk_count);
+    RunOnThreads(chunk_count, threads, [&](size_t c) {
+        const LabelTable &chunk_labels = chunks[c]->labels;
+        uint32_t file_id = first_ids[c];
+        uint64_t end = first_chars[c];
+        for (uint32_t id = 0; id < chunk_labels.Size(); id++) {
+            if (owned[c][id]) {
+                std::string_view label = chunk_labels.Label(id);
+                std::copy(label.begin(), label.end(), chars.begin() + end);
+                end += label.size();
+                offsets[file_id + 1] = end;
+                shard_to_file[shard_of[c][id]][shard_ids[c][id]] = file_id++;
+            }
+        }
+    });
+    RunOnThreads(chunk_count, threads, [&](size_t c) {
+        file_ids[c].resize(shard_ids[c].size());
+        for (uint32_t id = 0; id < shard_ids[c].size(); id++) {
+            file_ids[c][id] = shard_to_file[shard_of[c][id]][shard_ids[c][id]];
+        }
+        chunks[c]->labels = LabelTable();
+    });
+
+    labels = LabelTable::FromLabels(std::move(chars), std::move(offsets));
+    return file_ids;
+}
+
+BenchLexer::BenchLexer(const std::string &bench_file, unsigned threads, size_t min_chunk_bytes)
+    : file_name(bench_file), file(bench_file) {
+    std::string_view text = file.View();
+    size_t chunk_count = std::min<size_t>(std::max(threads, 1u), text.size() / std::max<size_t>(min_chunk_bytes, 1));
+    if (chunk_count <= 1) {
+        ChunkScanner scanner(text, file_name);
+        scanner.Scan();
+        labels = std::move(scanner.labels);
+        statements = std::move(scanner.statements);
+        inputs = std::move(scanner.inputs);
+        return;
+    }
+
+    /* Statements are single lines, so the chunks can be scanned independently with their own labels */
+    std::vector<std::string_view> parts = SplitAtLines(text, chunk_count);
+    std::vector<std::unique_ptr<ChunkScanner>> chunks(parts.size());
+    std::vector<std::exception_ptr> errors(parts.size());
+    RunOnThreads(parts.size(), threads, [&](size_t i) {
+        try {
+            chunks[i] = std::make_unique<ChunkScanner>(parts[i], file_name);
+            chunks[i]->Scan();
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    /* The first error in the file is reported, with its line counted from the start of the file */
+    std::vector<uint32_t> line_offsets(parts.size(), 0);
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (errors[i]) {
+            try {
+                std::rethrow_exception(errors[i]);
+            } catch (const BenchParseError &e) {
+                throw BenchParseError(file_name, e.Line() + line_offsets[i], e.Column(), e.Message());
+            }
+        }
+        if (i + 1 < parts.size()) {
+            line_offsets[i + 1] = line_offsets[i] + chunks[i]->Lines();
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> chunk_ids = MergeLabels(chunks, threads, labels);
+
+    /* Rewrite the statements and inputs of every chunk to the file-wide IDs and positions */
+    size_t statement_count = 0;
+    size_t input_count = 0;
+    for (const auto &chunk : chunks) {
+        statement_count += chunk->statements.size();
+        input_count += chunk->inputs.size();
+    }
+    std::vector<size_t> statement_offsets(chunks.size(), 0);
+    std::vector<size_t> input_offsets(chunks.size(), 0);
+    for (size_t i = 1; i < chunks.size(); i++) {
+        statement_offsets[i] = statement_offsets[i - 1] + chunks[i - 1]->statements.size();
+        input_offsets[i] = input_offsets[i - 1] + chunks[i - 1]->inputs.size();
+    }
+    statements.resize(statement_count);
+    inputs.resize(input_count);
+    RunOnThreads(chunks.size(), threads, [&](size_t i) {
+        const std::vector<uint32_t> &ids = chunk_ids[i];
+        BenchStatement *statement_out = statements.data() + statement_offsets[i];
+        for (BenchStatement statement : chunks[i]->statements) {
+            statement.label = ids[statement.label];
+            statement.first_input += static_cast<uint32_t>(input_offsets[i]);
+            statement.line += line_offsets[i];
+            *statement_out++ = statement;
+        }
+        uint32_t *input_out = inputs.data() + input_offsets[i];
+        for (uint32_t input : chunks[i]->inputs) {
+            *input_out++ = ids[input];
+        }
+        chunks[i].reset();
+    });
+}
@@ -0,0 +1,186 @@
+//
+// Hand-written scanner of the ISCAS85/89/99 bench format over a memory-mapped file
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Gate types of the bench format
+ */
+enum class GateType : uint8_t { Input, Output, Dff, Buff, Not, And, Or, Nand, Nor, Xor };
+
+/**
+ * \brief Returns the keyword of a gate type, e.g. "NAND"
+ */
+const char *GateTypeName(GateType type);
+
+/**
+ * \class MappedFile
+ *
+ * \brief Read-only memory mapping of a whole file
+ */
+class MappedFile {
+public:
+    /**
+     * \brief Maps the file
+     * \param path of the file
+     *
+     *  Throws std::runtime_error if the file can not be opened or mapped. Empty files are valid.
+     */
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    std::string_view View() const { return {data, size}; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * \class LabelTable
+ *
+ * \brief Interns labels as dense IDs in the order they are first seen
+ *
+ *  The characters of all labels are stored back to back in one array, so comparing a label with
+ *   the interned one stays in cache. Open addressing over a flat array of (hash, ID) slots,
+ *   the characters are compared only when the hashes match.
+ */
+class LabelTable {
+public:
+    /**
+     * \brief Returns the ID of the label, adding it if it is new
+     */
+    uint32_t Intern(std::string_view label);
+
+    /**
+     * \brief Returns true and the ID of the label if it was interned
+     */
+    bool Find(std::string_view label, uint32_t &id) const;
+
+    /**
+     * \brief Returns the label of an ID, the view is valid until the next label is added
+     */
+    std::string_view Label(uint32_t id) const {
+        return {chars.data() + offsets[id], static_cast<size_t>(offsets[id + 1] - offsets[id])};
+    }
+
+    size_t Size() const { return offsets.size() - 1; }
+    void Reserve(size_t count, size_t bytes);
+
+    /**
+     * \brief Releases spare capacity once all labels are added, the hash table may be up to 3/4 full afterwards
+     */
+    void ShrinkToFit();
+
+    /**
+     * \brief Returns the bytes allocated for the labels and the hash table
+     */
+    size_t MemoryUsage() const;
+
+    static uint64_t Hash(std::string_view label);
+
+    /**
+     * \brief Creates a table of distinct labels, given back to back with the start of every label and the end of the last one
+     */
+    static LabelTable FromLabels(std::vector<char> chars, std::vector<uint64_t> offsets);
+
+private:
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t id = Empty;
+    };
+    static constexpr uint32_t Empty = UINT32_MAX;
+
+    std::vector<Slot> slots{16};
+    std::vector<char> chars;
+    std::vector<uint64_t> offsets{0}; ///< Start of every label in chars, followed by the end of the last one
+
+    friend class CircuitGraph; ///< Saves and loads the table as part of the circuit
+
+    void Grow();
+    void Rehash(size_t size);
+};
+
+/**
+ * \brief One INPUT, OUTPUT or gate line of a bench file
+ */
+struct BenchStatement {
+    GateType type;
+    uint32_t label;        ///< Interned label of the gate, input or output
+    uint32_t first_input;  ///< Position of the first input label in BenchLexer::Inputs()
+    uint32_t input_count;  ///< 0 for INPUT and OUTPUT
+    uint32_t line;
+};
+
+/**
+ * \brief Syntax error with its position, what() reads "file:line:column: message"
+ */
+class BenchParseError : public std::runtime_error {
+public:
+    BenchParseError(const std::string &file, size_t line, size_t column, const std::string &message);
+
+    size_t Line() const { return line; }
+    size_t Column() const { return column; }
+    const std::string &Message() const { return message; }
+
+private:
+    size_t line;
+    size_t column;
+    std::string message;
+};
+
+/**
+ * \class BenchLexer
+ *
+ * \brief Scans a bench file into statements over interned labels without copying the file
+ *
+ *  Accepted lines, with blanks between the tokens and '#' starting a comment up to the end of the line:
+ *   INPUT(label), OUTPUT(label), label = NOT|BUFF|DFF(a) and label = AND|OR|NAND|NOR|XOR(a, b, ...).
+ *   Labels consist of all characters but blanks and "#(),=".
+ */
+class BenchLexer {
+public:
+    /**
+     * \brief Maps and scans the whole file
+     * \param bench_file path of the file
+     * \param threads number of threads scanning the file
+     * \param min_chunk_bytes smallest chunk a thread scans
+     *
+     *  With more than one thread, files of several chunks are split at line breaks into one chunk per thread.
+     *   The chunks are scanned with their own label tables, which are merged in the order of the chunks
+     *   afterwards, so the statements, inputs and label IDs are the same as with one thread.
+     *   Throws BenchParseError at the first syntax error, std::runtime_error if the file can not be read.
+     */
+    explicit BenchLexer(const std::string &bench_file, unsigned threads = 1, size_t min_chunk_bytes = MinChunkBytes);
+
+    /// Files are split into chunks of at least this size by default
+    static constexpr size_t MinChunkBytes = size_t(1) << 20;
+
+    const std::vector<BenchStatement> &Statements() const { return statements; }
+    const std::vector<uint32_t> &Inputs() const { return inputs; }
+    const LabelTable &Labels() const { return labels; }
+    size_t Bytes() const { return file.View().size(); }
+
+    /**
+     * \brief Moves the interned labels out of the lexer, Labels() must not be used afterwards
+     */
+    LabelTable ReleaseLabels() { return std::move(labels); }
+
+private:
+    std::string file_name;
+    MappedFile file;
+    LabelTable labels;
+    std::vector<BenchStatement> statements;
+    std::vector<uint32_t> inputs;
+};
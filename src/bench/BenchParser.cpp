@@ -4,29 +4,86 @@
 //
 
 #include "BenchParser.hpp"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <unistd.h>
+
+namespace {
+
+/* Header of a netlist cache, followed by the arrays of CircuitGraph::Save() */
+struct NetlistCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+};
+
+const char NetlistCacheMagic[4] = {'V', 'D', 'S', 'N'};
+const uint32_t NetlistCacheVersion = 2;
+
+std::string netlistCacheFile(const std::string &bench_file) {
+    return bench_file + ".vdsn";
+}
 
-BenchParser::BenchParser(const std::string &bench_file) {
+} // namespace
 
-    id_counter = 0;
+BenchParser::BenchParser(const std::string &bench_file, unsigned parse_threads, bool netlist_cache) {
 
-    if (parseFile(bench_file)) {
+    if (netlist_cache && loadNetlistCache(bench_file)) {
+        return;
+    }
+    /* The key is taken before parsing, a file changed meanwhile is parsed again next time */
+    SourceKey source{};
+    if (netlist_cache) {
+        source = sourceKey(bench_file, true);
+    }
+
+    bool parsed;
+    {
+        ClassProject::TraceSpan span("parse", "bench", bench_file);
+        parsed = parseFile(bench_file, parse_threads);
+    }
+    if (parsed) {
         /* Based on the list of output labels, generate the corresponding circuit */
         std::cout << "- Creating circuit from bench nodes... ";
-        createCircuitFromOutputList();
+        {
+            ClassProject::TraceSpan span("create circuit", "bench");
+            createCircuitFromOutputList();
+        }
         std::cout << "Done!" << std::endl;
 
         /* Sort the circuit */
         std::cout << "- Topologically sorting the circuit... ";
-        TopologicalSortKahnsAlgorithm();
-        std::cout << "Done!" << std::endl;
-
-        label_to_node.clear();
-        labels_to_id.clear();
-        id_to_circuit_node.clear();
-        output_labels.clear();
-        ff_labels.clear();
-        output_circuits.clear();
-        input_circuits.clear();
+        {
+            ClassProject::TraceSpan span("topological sort", "bench");
+            TopologicalSortKahnsAlgorithm();
+        }
+        std::cout << "Done! (" << sorted_circuit.Size() << " nodes, " << sorted_circuit.Edges() << " edges, "
+                  << sorted_circuit.MemoryUsage() / 1024 << " KB)" << std::endl;
+
+        lexer.reset();
+        definitions = {};
+        input_labels = {};
+        output_labels = {};
+        ff_labels = {};
+        gate_nodes = {};
+        output_nodes = {};
+        ff_nodes = {};
+        output_circuits = {};
+        node_types = {};
+        node_labels = {};
+        fanin_offsets = {};
+        fanin_counts = {};
+        fanins = {};
+
+        if (netlist_cache) {
+            saveNetlistCache(bench_file, source);
+        }
     } else {
         throw std::runtime_error("Please check bench file syntax!");
     }
@@ -38,129 +95,13 @@ BenchParser::~BenchParser() = default;
  * Print Functions 
  * ---------------
  */
-void BenchParser::PrintLabelsTable() {
-    std::unordered_map<label_t, bench_node_t>::const_iterator it_label;
-
-    std::cout << "============ [BEGIN] Table of Labels and Nodes ============" << std::endl;
-    std::cout << std::endl << "-----" << std::endl;
-    for (it_label = label_to_node.begin(); it_label != label_to_node.end(); it_label++) {
-        std::cout << std::endl << "Label: " << it_label->first << std::endl;
-        std::cout << "Node Information:" << std::endl;
-        std::cout << "\tNode Label: " << it_label->second.label << std::endl;
-        std::cout << "\tGate Type: " << it_label->second.gate_type << std::endl;
-        std::cout << "\tInputs: ";
-        for (const auto &i : it_label->second.input_node_list)
-            std::cout << i << ' ';
-        std::cout << std::endl << "-----" << std::endl;
-    }
-    std::cout << "============ [END] Table of Labels and Nodes ============" << std::endl;
-}
-
-void BenchParser::PrintUUIDCircuitTable() {
-    std::unordered_map<unique_ID_t, circuit_node_t>::const_iterator it_uuid;
-
-    std::cout << "============ [BEGIN] Table of Labels and Nodes ============" << std::endl;
-    std::cout << std::endl << "-----" << std::endl;
-    for (it_uuid = id_to_circuit_node.begin(); it_uuid != id_to_circuit_node.end(); it_uuid++) {
-        std::cout << std::endl << "UUID: " << it_uuid->first << std::endl;
-        std::cout << "Node Information:" << std::endl;
-        std::cout << "\tNode Circuit Label: " << it_uuid->second.label << std::endl;
-        std::cout << "\tGate Type: " << it_uuid->second.gate_type << std::endl;
-        std::cout << "\tInputs: ";
-        for (unsigned long i : it_uuid->second.input_id_list)
-            std::cout << i << ' ';
-        std::cout << std::endl << "-----" << std::endl;
-        std::cout << "\tOutputs: ";
-        for (unsigned long i : it_uuid->second.output_id_list)
-            std::cout << i << ' ';
-        std::cout << std::endl << "-----" << std::endl;
-    }
-    std::cout << "============ [END] Table of Labels and Nodes ============" << std::endl;
-}
-
-void BenchParser::PrintOutputList() {
-    std::set<label_t>::const_iterator it;
-
-    std::cout << std::endl << "============ [BEGIN] List of Outputs ============" << std::endl << std::endl;
-    std::cout << std::endl << "List of output labels: ";
-    for (it = output_labels.begin(); it != output_labels.end(); it++) {
-        std::cout << (*it) << " -> ";
-    }
-    std::cout << "end;" << std::endl;
-    std::cout << std::endl << "============ [END] List of Outputs ============" << std::endl;
-}
-
-void BenchParser::PrintLabels2UUIDTable() {
-    std::unordered_map<label_t, unique_ID_t>::const_iterator it_label;
-
-    std::cout << "============ [BEGIN] Table of Labels and UUIDs ============" << std::endl;
-    std::cout << std::endl << "-----" << std::endl;
-    for (it_label = labels_to_id.begin(); it_label != labels_to_id.end(); it_label++) {
-        std::cout << std::endl << "Label: " << it_label->first << std::endl;
-        std::cout << std::endl << "UUID: " << it_label->second << std::endl;
-        std::cout << std::endl << "------------------------------" << std::endl;
-    }
-    std::cout << "============ [END] Table of Labels and UUIDs ============" << std::endl;
-}
-
-void BenchParser::PrintCircuit(unique_ID_t circuit_ID, int indent) {
-    std::unordered_map<unique_ID_t, circuit_node_t>::const_iterator got;
-    circuit_node_t node;
-
-    got = (id_to_circuit_node).find(circuit_ID);
-    if (got != id_to_circuit_node.end()) {
-        node = got->second;
-        std::cout << std::string(indent, ' ') << "Node ID: " << node.id << std::endl;
-        std::cout << std::string(indent, ' ') << "Label: " << node.label << std::endl;
-        std::cout << std::string(indent, ' ') << "Type: " << node.gate_type << std::endl;
-
-        std::cout << std::string(indent, ' ') << "Input List: " << std::endl;
-        for (unsigned long i : node.input_id_list)
-            std::cout << std::string(indent, ' ') << "    " << i << std::endl;
-
-        std::cout << std::string(indent, ' ') << "Output List: " << std::endl;
-        for (unsigned long i : node.output_id_list)
-            std::cout << std::string(indent, ' ') << "    " << i << std::endl;
-
-        indent = indent + 4;
-        std::cout << std::string(indent, ' ') << "--------------" << std::endl;
-        for (unsigned long i : node.input_id_list)
-            PrintCircuit(i, indent);
-        std::cout << std::string(indent, ' ') << "--------------" << std::endl;
-    }
-}
-
-void BenchParser::PrintCircuitByLabel(const label_t &node_label) {
-    std::unordered_map<label_t, unique_ID_t>::const_iterator got;
-
-    got = (labels_to_id).find(node_label);
-    if (got != labels_to_id.end()) {
-        PrintCircuit(got->second, 0);
-    } else {
-        throw std::runtime_error("There is no mapping from this label to a circuit node.");
-    }
-
-}
-
-
-void BenchParser::PrintCircuitsOfOutputSet() {
-    for (unsigned long it : output_circuits) {
-        PrintCircuit(it, 0);
-    }
-}
-
 void BenchParser::PrintSortedCircuitList() {
-    list_of_circuit_t::const_iterator it;
-
     std::cout << std::endl << "============ [BEGIN] List of Sorted Circuit Nodes ============" << std::endl
               << std::endl;
     std::cout << std::endl << "List of Sorted Circuit Nodes labels: ";
 
-    list_of_circuit_t ordered_circuit = this->GetSortedCircuit();
-
-
-    for (it = ordered_circuit.begin(); it != ordered_circuit.end(); it++) {
-        std::cout << (*it).id << " -> ";
+    for (uint32_t node = 0; node < sorted_circuit.Size(); node++) {
+        std::cout << GateTypeName(sorted_circuit.Type(node)) << " " << sorted_circuit.Label(node) << " -> ";
     }
     std::cout << "end;" << std::endl;
     std::cout << std::endl << "============ [END] List of Sorted Circuit Nodes ============" << std::endl;
@@ -171,40 +112,11 @@ void BenchParser::PrintSortedCircuitList() {
  * ----------------
  */
 
-set_of_circuit_t BenchParser::GetListOfCircuitsInputs() {
-    return input_circuits;
-}
-
-
-set_of_circuit_t BenchParser::GetListOfCircuitsOutputs() {
-    return output_circuits;
-}
-
 std::set<label_t> BenchParser::GetListOfOutputLabels() {
     return outputs;
 }
 
-
-circuit_node_t BenchParser::GetCircuitNode(unique_ID_t circuit_node_uuid) {
-    /* Iterator for the uuid2circuitNode_table table */
-    std::unordered_map<unique_ID_t, circuit_node_t>::const_iterator got;
-
-    /* Search the node and add the UUID of the current node to this node OUTPUT_LIST */
-    got = id_to_circuit_node.find(circuit_node_uuid);
-
-    if (got != id_to_circuit_node.end()) {
-        return got->second;
-    }//if
-    else {
-        throw std::runtime_error("There is no mapping from this unique_ID_t to a circuit_node_type.");
-    }
-}
-
-std::unordered_map<unique_ID_t, circuit_node_t> BenchParser::GetCircuit() {
-    return id_to_circuit_node;
-}
-
-list_of_circuit_t BenchParser::GetSortedCircuit() {
+const CircuitGraph &BenchParser::GetSortedCircuit() const {
     return sorted_circuit;
 }
 
@@ -212,210 +124,252 @@ list_of_circuit_t BenchParser::GetSortedCircuit() {
  * Read File Functions 
  * ---------------
  */
-bool BenchParser::parseFile(const std::string &bench_file) {
+bool BenchParser::parseFile(const std::string &bench_file, unsigned threads) {
 
-    std::cout << std::endl << "- Reading bench format file... ";
-    std::ifstream in(bench_file);
-    if (!in.is_open()) {
-        throw std::runtime_error("Could not open file: " + bench_file);
-    }
-    in.unsetf(std::ios::skipws);
-    std::cout << "Done!" << std::endl;
-
-    /* Declaring file iterators */
-    boost::spirit::istream_iterator first(in), last;
-
-    /* Declaring skip parser to be used */
-    skip_p::skip_grammar<boost::spirit::istream_iterator> skip;
-
-    /* Declaring bench format grammar */
-    bench_format::bench_parser<boost::spirit::istream_iterator> bench_grammar_parser;
+    std::cout << std::endl << "- Parsing input file '" << bench_file << "'... " << std::flush;
+    auto start = std::chrono::steady_clock::now();
+    lexer = std::make_unique<BenchLexer>(bench_file, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Done! (" << lexer->Bytes() / 1024 << " KB, " << lexer->Statements().size() << " lines in " << seconds
+              << "s)" << std::endl;
 
-    /* Stored result after parsing a file line */
-    bench_format::bench_node_type parsed_bench_node;
-
-    /* Effectively parsing the file. The parser returns a benchnode to be added to the labels table */
-    std::cout << "- Parsing input file '" << bench_file << "'... ";
-    bool successfully_parsed;
-    do {
-        successfully_parsed = phrase_parse(first, last, bench_grammar_parser, skip, parsed_bench_node);
-        if (!successfully_parsed) {
-            std::cout << "Failed parsing input file at: " << std::string(first, last) << std::endl;
-            return false;
-        } else {
-            /* Add the successfully read bench node into the labels table */
-            addToLabelTable(parsed_bench_node);
+    /*
+     * The first INPUT, gate or FLIP FLOP line of a label defines it, later ones are ignored.
+     *  OUTPUT gates have the same label as the gate they name, they are kept apart.
+     */
+    const std::vector<BenchStatement> &statements = lexer->Statements();
+    definitions.assign(lexer->Labels().Size(), CircuitGraph::None);
+    for (uint32_t i = 0; i < statements.size(); i++) {
+        const BenchStatement &statement = statements[i];
+        if (statement.type == GateType::Input) {
+            input_labels.push_back(statement.label);
+        }
+        if (statement.type == GateType::Output) {
+            output_labels.push_back(statement.label);
+        } else if (definitions[statement.label] == CircuitGraph::None) {
+            definitions[statement.label] = i;
+            if (statement.type == GateType::Dff) {
+                ff_labels.push_back(statement.label);
+            }
         }
-        parsed_bench_node = bench_format::bench_node_type();
-    } while (first != last); /* Operations are performed until it is EOF */
-    std::cout << "Done!" << std::endl;
+    }
 
     return true;
 }
 
 
-bool BenchParser::addToLabelTable(bench_node_t bench_node) {
-    bool new_node_added;
-    label_t search_label;
-    /*
-     * Output nodes have to be handle a bit different, since they'll have
-     *  the same label as another gate. Mappings require unique element
-     *  identifiers. By convention, OUTPUT gates will be referenced by its
-     *  original label concatenated with the string "OUTPUT" to differentiate
-     *  from the other gate that has the same label.
-    */
-    if (bench_node.gate_type == OUTPUT_GATE_T) {
-        /* If the gate is an output gate, it must be included into the set_of_output_labels */
-        output_labels.insert(bench_node.label);
-        search_label = bench_node.label + bench_node.gate_type;
-    } else {
-        search_label = bench_node.label;
+/* -------------
+ * Netlist Cache
+ * -------------
+ */
+BenchParser::SourceKey BenchParser::sourceKey(const std::string &bench_file, bool hash) {
+    std::error_code error;
+    SourceKey key{};
+    key.size = std::filesystem::file_size(bench_file, error);
+    if (!error) {
+        key.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::filesystem::last_write_time(bench_file, error).time_since_epoch()).count();
     }
-
-    if (label_to_node.find(search_label) != label_to_node.end()) {
-        new_node_added = false;
-    } else {
-        /*
-         * Otherwise add bench_node to the labels_table
-         */
-        if (bench_node.gate_type == FLIP_FLOP_GATE_T) {
-
-            /* If it is a flip flop, we have to add two nodes:
-               One that will be the output node;
-               Another one as input node.
-               For the searching part it is not necessary to differentiate it,
-               since for each existing flip flop in the circuit we will add
-               to the labels table one node that is an INPUT with the same
-               label as the flip flop, and another one with the "FLIP_FLOP_GATE_T"
-               string concatenated. So if we search for one of them, it is
-               enough to check whether the node exists or not. */
-            ff_labels.insert(search_label);
-            label_to_node.insert(std::pair<label_t, bench_node_t>(search_label + FLIP_FLOP_GATE_T, bench_node));
-            bench_node.gate_type = INPUT_GATE_T;
-            bench_node.input_node_list.clear();
-        }
-        label_to_node.insert(std::pair<label_t, bench_node_t>(search_label, bench_node));
-        new_node_added = true;
+    if (error) {
+        throw std::runtime_error("Could not open file: " + bench_file);
     }
-    return new_node_added;
+    if (hash) {
+        MappedFile file(bench_file);
+        key.hash = LabelTable::Hash(file.View());
+    }
+    return key;
 }
 
-unique_ID_t BenchParser::findOrAddToCircuit(const bench_node_t &bench_node) {
-
-    unique_ID_t CircuitNodeID;
-    std::unordered_map<label_t, unique_ID_t>::const_iterator got;
-    circuit_node_t new_circuit_node;
-    label_t search_label;
-
-    if ((bench_node.gate_type == OUTPUT_GATE_T) || (bench_node.gate_type == FLIP_FLOP_GATE_T)) {
-        search_label = bench_node.label + bench_node.gate_type;
-    } else {
-        search_label = bench_node.label;
+bool BenchParser::loadNetlistCache(const std::string &bench_file) {
+    std::string cache_file = netlistCacheFile(bench_file);
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cache_file, error)) {
+        return false;
     }
 
-    got = labels_to_id.find(search_label);
+    std::cout << std::endl << "- Loading netlist cache '" << cache_file << "'... " << std::flush;
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = false;
+    {
+        ClassProject::TraceSpan span("load netlist cache", "bench", cache_file);
+        SourceKey source = sourceKey(bench_file, false);
+        MappedFile cache(cache_file);
+        std::string_view data = cache.View();
+        NetlistCacheHeader header{};
+        if (data.size() >= sizeof(header)) {
+            std::memcpy(&header, data.data(), sizeof(header));
+            bool current = std::equal(NetlistCacheMagic, NetlistCacheMagic + 4, header.magic) &&
+                           header.version == NetlistCacheVersion && header.source_size == source.size;
+            if (current && header.source_mtime != source.mtime) {
+                /* Touched or copied, but maybe not changed */
+                current = header.source_hash == sourceKey(bench_file, true).hash;
+                if (current) {
+                    header.source_mtime = source.mtime;
+                    std::fstream update(cache_file, std::ios::in | std::ios::out | std::ios::binary);
+                    update.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                }
+            }
+            loaded = current && sorted_circuit.Load(data.substr(sizeof(header)));
+        }
+    }
+    if (!loaded) {
+        std::cout << "Out of date!" << std::endl;
+        return false;
+    }
 
-    if (got != labels_to_id.end()) {
-        /* If the iterator is not pointing to the end of the labels_table,
-           means that already exist another node with the same label. Then
-           simply returns the unique ID from the node. */
-        CircuitNodeID = (got->second);
-    } else {
-        /*
-         * Otherwise add bench_node to the labels_table and returns its UUID
-         */
-        new_circuit_node = benchNodeToCircuitNode(bench_node);
-        CircuitNodeID = new_circuit_node.id;
-        labels_to_id.insert(std::pair<label_t, unique_ID_t>(search_label, CircuitNodeID));
-        id_to_circuit_node.insert(std::pair<unique_ID_t, circuit_node_t>(CircuitNodeID, new_circuit_node));
-    }
-    return CircuitNodeID;
+    /* Same labels as createCircuitFromOutputList(): the OUTPUT gates and the inputs of the FLIP FLOPs */
+    for (uint32_t node = 0; node < sorted_circuit.Size(); node++) {
+        if (sorted_circuit.Type(node) == GateType::Output) {
+            outputs.emplace(sorted_circuit.Label(node));
+        } else if (sorted_circuit.Type(node) == GateType::Dff) {
+            outputs.emplace(sorted_circuit.Label(sorted_circuit.Fanin(node)[0]));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Done! (" << sorted_circuit.Size() << " nodes, " << sorted_circuit.Edges() << " edges in " << seconds
+              << "s)" << std::endl;
+    return true;
 }
 
+void BenchParser::saveNetlistCache(const std::string &bench_file, const SourceKey &source) {
+    ClassProject::TraceSpan span("save netlist cache", "bench");
+    std::string cache_file = netlistCacheFile(bench_file);
+    std::string temp_file = cache_file + ".tmp" + std::to_string(getpid());
+
+    NetlistCacheHeader header{};
+    std::copy(NetlistCacheMagic, NetlistCacheMagic + 4, header.magic);
+    header.version = NetlistCacheVersion;
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.source_hash = source.hash;
+    bool written;
+    {
+        std::ofstream out(temp_file, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        sorted_circuit.Save(out);
+        out.close();
+        written = !out.fail();
+    }
 
-unique_ID_t BenchParser::findOrAddToCircuitByLabel(const label_t &node_label) {
-
-    auto label = (label_to_node).find(node_label);
-
-    if (label != label_to_node.end()) {
-        return (findOrAddToCircuit(label->second));
+    /* Readers see either the old or the complete new cache */
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temp_file, cache_file, error);
+    }
+    if (!written || error) {
+        std::filesystem::remove(temp_file, error);
+        std::cout << "- Could not write the netlist cache '" << cache_file << "', continuing without it" << std::endl;
     } else {
-        throw std::runtime_error("There is no mapping from this label to a node.");
+        std::cout << "- Saved netlist cache '" << cache_file << "'" << std::endl;
     }
 }
 
-circuit_node_t BenchParser::benchNodeToCircuitNode(const bench_node_t &bench_node) {
 
-    circuit_node_t new_circuit_node;
-    size_t input_id, new_id;
+uint32_t BenchParser::findOrAddToCircuit(uint32_t label, NodeKind kind) {
 
-    /* Generate an unique identifier */
-    new_circuit_node.id = id_counter;
-    id_counter++;
-    new_id = new_circuit_node.id;
+    uint32_t root = findOrCreateNode(label, kind);
 
-    new_circuit_node.label = bench_node.label;
-    new_circuit_node.gate_type = bench_node.gate_type;
-
-    /* If it is not an INPUT gate, we have to recursively iterate to get the unique id of the inputs */
-    if (!(new_circuit_node.gate_type == INPUT_GATE_T)) {
+    while (!pending_nodes.empty()) {
+        PendingNode &pending = pending_nodes.back();
+        uint32_t node = pending.node;
+        uint32_t first = fanin_offsets[node];
+        if (pending.next_input < fanin_counts[node]) {
+            uint32_t input = pending.next_input++;
+            /* May push the input and grow fanins */
+            uint32_t input_node = findOrCreateNode(inputLabel(node, input), NodeKind::Gate);
+            fanins[first + input] = input_node;
+        } else {
+            /* A gate uses each of its inputs once */
+            std::sort(fanins.begin() + first, fanins.begin() + first + fanin_counts[node]);
+            fanin_counts[node] = static_cast<uint32_t>(
+                std::unique(fanins.begin() + first, fanins.begin() + first + fanin_counts[node]) - (fanins.begin() + first));
+            pending_nodes.pop_back();
+        }
+    }
+    return root;
+}
 
-        if (new_circuit_node.gate_type == OUTPUT_GATE_T) {
 
-            input_id = findOrAddToCircuitByLabel(bench_node.label);
-            new_circuit_node.input_id_list.insert(input_id);
+uint32_t BenchParser::findOrCreateNode(uint32_t label, NodeKind kind) {
 
-            auto node = id_to_circuit_node.find(input_id);
-            if (node != id_to_circuit_node.end()) {
-                node->second.output_id_list.insert(new_id);
-            }
+    std::vector<uint32_t> &nodes = kind == NodeKind::Gate ? gate_nodes : kind == NodeKind::Output ? output_nodes : ff_nodes;
+    if (nodes[label] != CircuitGraph::None) {
+        return nodes[label];
+    }
 
+    GateType type;
+    uint32_t input_count;
+    if (kind == NodeKind::Output) {
+        /* The only input of an OUTPUT gate is the gate with the same label */
+        type = GateType::Output;
+        input_count = 1;
+    } else {
+        if (definitions[label] == CircuitGraph::None) {
+            throw std::runtime_error("There is no mapping from this label to a node: " +
+                                     std::string(lexer->Labels().Label(label)));
+        }
+        const BenchStatement &statement = lexer->Statements()[definitions[label]];
+        input_count = statement.input_count;
+        if (kind == NodeKind::FlipFlop) {
+            type = GateType::Dff;
+        } else if (statement.type == GateType::Dff) {
+            /* The output of a FLIP FLOP is an INPUT of the circuit */
+            type = GateType::Input;
+            input_count = 0;
         } else {
+            type = statement.type;
+        }
+    }
 
-            for (const auto &input_node : bench_node.input_node_list) {
+    /* Registered before the inputs are visited, so a cycle ends here and is reported by the sort */
+    uint32_t node = static_cast<uint32_t>(node_types.size());
+    nodes[label] = node;
+    node_types.push_back(type);
+    node_labels.push_back(label);
+    fanin_offsets.push_back(static_cast<uint32_t>(fanins.size()));
+    fanin_counts.push_back(input_count);
+    fanins.resize(fanins.size() + input_count);
+    pending_nodes.push_back({node, 0});
+    return node;
+}
 
-                input_id = findOrAddToCircuitByLabel(input_node);
-                new_circuit_node.input_id_list.insert(input_id);
 
-                auto node = id_to_circuit_node.find(input_id);
-                if (node != id_to_circuit_node.end()) {
-                    node->second.output_id_list.insert(new_id);
-                }
-            }
-        }
-    } else {
-        input_circuits.insert(new_id);
+uint32_t BenchParser::inputLabel(uint32_t node, uint32_t input) const {
+    if (node_types[node] == GateType::Output) {
+        return node_labels[node];
     }
-
-    return new_circuit_node;
+    const BenchStatement &statement = lexer->Statements()[definitions[node_labels[node]]];
+    return lexer->Inputs()[statement.first_input + input];
 }
 
 
 void BenchParser::createCircuitFromOutputList() {
 
-    std::set<label_t>::const_iterator it;
-    std::unordered_map<label_t, unique_ID_t>::const_iterator got_uid;
-    std::unordered_map<unique_ID_t, circuit_node_t>::const_iterator got_node;
+    size_t label_count = lexer->Labels().Size();
+    gate_nodes.assign(label_count, CircuitGraph::None);
+    output_nodes.assign(label_count, CircuitGraph::None);
+    ff_nodes.assign(label_count, CircuitGraph::None);
+
+    /* Outputs and FLIP FLOPs are visited in the order of their labels */
+    const LabelTable &labels = lexer->Labels();
+    auto by_label = [&labels](uint32_t a, uint32_t b) { return labels.Label(a) < labels.Label(b); };
+    std::sort(output_labels.begin(), output_labels.end(), by_label);
+    output_labels.erase(std::unique(output_labels.begin(), output_labels.end()), output_labels.end());
+    std::sort(ff_labels.begin(), ff_labels.end(), by_label);
 
-    for (const auto &output_label : output_labels) {
-        createCircuitByLabel(output_label + OUTPUT_GATE_T);
+    for (uint32_t output_label : output_labels) {
+        output_circuits.push_back(findOrAddToCircuit(output_label, NodeKind::Output));
     }
-    for (const auto &ff_label : ff_labels) {
-        createCircuitByLabel(ff_label + FLIP_FLOP_GATE_T);
+    for (uint32_t ff_label : ff_labels) {
+        output_circuits.push_back(findOrAddToCircuit(ff_label, NodeKind::FlipFlop));
     }
-    for (const auto &ff_label : ff_labels) {
-        auto ff_id = labels_to_id.find(ff_label + FLIP_FLOP_GATE_T);
-        auto ff_node = id_to_circuit_node.find(ff_id->second);
-        ff_node = id_to_circuit_node.find(*(ff_node->second).input_id_list.begin());
-        outputs.insert(ff_node->second.label);
+    for (uint32_t ff_label : ff_labels) {
+        uint32_t ff_input = fanins[fanin_offsets[ff_nodes[ff_label]]];
+        outputs.emplace(labels.Label(node_labels[ff_input]));
+    }
+    for (uint32_t output_label : output_labels) {
+        outputs.emplace(labels.Label(output_label));
     }
-    outputs.insert(output_labels.begin(), output_labels.end());
-}
-
-void BenchParser::createCircuitByLabel(const label_t &bnode_label) {
-    unique_ID_t new_circuit;
-    new_circuit = findOrAddToCircuitByLabel(bnode_label);
-    output_circuits.insert(new_circuit);
 }
 
 
@@ -423,52 +377,139 @@ void BenchParser::createCircuitByLabel(const label_t &bnode_label) {
  * Topological Sort Algorithms
  * -----------------------------
  */
+namespace {
+
+/*
+ * Set of node IDs that removes its smallest element in a few word operations:
+ *  one bit per node, and above that one bit per non-empty word of the level below.
+ */
+class ReadyNodes {
+public:
+    explicit ReadyNodes(size_t node_count) {
+        size_t words = node_count;
+        do {
+            words = std::max<size_t>(1, (words + 63) / 64);
+            levels.emplace_back(words, 0);
+        } while (words > 1);
+    }
+
+    bool Empty() const { return levels.back()[0] == 0; }
+
+    void Insert(uint32_t node) {
+        size_t bit = node;
+        for (auto &level : levels) {
+            level[bit / 64] |= uint64_t(1) << (bit % 64);
+            bit /= 64;
+        }
+    }
+
+    uint32_t PopMin() {
+        size_t bit = 0;
+        for (size_t level = levels.size(); level-- > 0;) {
+            bit = bit * 64 + static_cast<size_t>(__builtin_ctzll(levels[level][bit]));
+        }
+        uint32_t node = static_cast<uint32_t>(bit);
+        for (auto &level : levels) {
+            level[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+            if (level[bit / 64] != 0) {
+                break;
+            }
+            bit /= 64;
+        }
+        return node;
+    }
+
+private:
+    std::vector<std::vector<uint64_t>> levels;
+};
+
+} // namespace
+
 void BenchParser::TopologicalSortKahnsAlgorithm() {
-    set_of_circuit_t nodes_without_outgoing_edges = GetListOfCircuitsOutputs();
-    set_of_circuit_t::iterator it;
-
-    circuit_node_t node, tmp_node;
-
-    while (!nodes_without_outgoing_edges.empty()) {
-        it = nodes_without_outgoing_edges.begin();
-        /* Always pick the first element of the list of nodes without incoming edges */
-        node = GetCircuitNode(*it);
-        nodes_without_outgoing_edges.erase(it);
-
-        /* Nodes are added always to the end of the list */
-        sorted_circuit.push_front(node);
-        for (auto it_input_nodes = node.input_id_list.begin();
-             it_input_nodes != node.input_id_list.end(); it_input_nodes++) {
-            if (IsUniqueOutgoingEdge(*it_input_nodes, node.id)) {
-                nodes_without_outgoing_edges.insert(*it_input_nodes);
+    size_t node_count = node_types.size();
+
+    /* Number of gates still using the output of every node */
+    std::vector<uint32_t> outgoing_edges(node_count, 0);
+    for (uint32_t node = 0; node < node_count; node++) {
+        for (uint32_t i = 0; i < fanin_counts[node]; i++) {
+            outgoing_edges[fanins[fanin_offsets[node] + i]]++;
+        }
+    }
+
+    ReadyNodes nodes_without_outgoing_edges(node_count);
+    for (uint32_t output : output_circuits) {
+        nodes_without_outgoing_edges.Insert(output);
+    }
+    std::vector<uint32_t> order;
+    order.reserve(node_count);
+
+    while (!nodes_without_outgoing_edges.Empty()) {
+        /* Always pick the smallest node without outgoing edges */
+        uint32_t node = nodes_without_outgoing_edges.PopMin();
+
+        order.push_back(node);
+        for (uint32_t i = 0; i < fanin_counts[node]; i++) {
+            uint32_t input = fanins[fanin_offsets[node] + i];
+            if (--outgoing_edges[input] == 0) {
+                nodes_without_outgoing_edges.Insert(input);
             }
         }
     }
 
-    if (sorted_circuit.size() != id_to_circuit_node.size()) {
-        throw std::runtime_error("The circuit must be cycle free!");
+    if (order.size() != node_count) {
+        throw std::runtime_error("The circuit must be cycle free! Cycle: " + describeCycle(outgoing_edges));
     }
-}
 
+    /* The nodes were collected from the outputs backwards */
+    std::vector<uint32_t> sorted_id(node_count);
+    for (size_t i = 0; i < node_count; i++) {
+        sorted_id[order[i]] = static_cast<uint32_t>(node_count - 1 - i);
+    }
+    std::vector<uint32_t> sorted_fanin;
+    for (size_t i = node_count; i-- > 0;) {
+        uint32_t node = order[i];
+        sorted_fanin.clear();
+        for (uint32_t j = 0; j < fanin_counts[node]; j++) {
+            sorted_fanin.push_back(sorted_id[fanins[fanin_offsets[node] + j]]);
+        }
+        sorted_circuit.AddNode(node_types[node], node_labels[node], sorted_fanin.data(), sorted_fanin.size());
+    }
+    sorted_circuit.Finish(lexer->ReleaseLabels(), input_labels);
+}
 
-/* -----------------------------
- * Auxiliary functions for
- * Topological Sort Algorithms
- * -----------------------------
- */
 
-bool BenchParser::IsUniqueOutgoingEdge(unique_ID_t src_node, unique_ID_t dst_node) {
-    std::unordered_map<unique_ID_t, circuit_node_t>::iterator got;
+std::string BenchParser::describeCycle(const std::vector<uint32_t> &outgoing_edges) const {
+    /*
+     * Every unsorted node is still used by an unsorted gate, following those
+     *  gates from any unsorted node has to run into a cycle.
+     */
+    const uint32_t None = CircuitGraph::None;
+    std::vector<uint32_t> user(outgoing_edges.size(), None);
+    uint32_t start = None;
+    for (uint32_t node = 0; node < outgoing_edges.size(); node++) {
+        if (outgoing_edges[node] == 0) {
+            continue;
+        }
+        start = node;
+        for (uint32_t i = 0; i < fanin_counts[node]; i++) {
+            user[fanins[fanin_offsets[node] + i]] = node;
+        }
+    }
 
-    /* Search source node in the circuit graph */
-    got = id_to_circuit_node.find(src_node);
+    std::vector<bool> visited(outgoing_edges.size(), false);
+    uint32_t node = start;
+    while (!visited[node]) {
+        visited[node] = true;
+        node = user[node];
+    }
 
-    if (got != id_to_circuit_node.end()) {
-        /* Remove outgoing edge to source node */
-        (got->second).output_id_list.erase((got->second).output_id_list.find(dst_node));
-        return (got->second).output_id_list.empty();
-    }//if
-    else {
-        throw std::runtime_error("Destination node UUID is not part of the circuit graph!");
+    std::string cycle(lexer->Labels().Label(node_labels[node]));
+    for (uint32_t next = user[node];; next = user[next]) {
+        cycle += " -> ";
+        cycle += lexer->Labels().Label(node_labels[next]);
+        if (next == node) {
+            break;
+        }
     }
+    return cycle;
 }
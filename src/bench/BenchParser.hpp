@@ -5,149 +5,73 @@
 
 #pragma once
 
-#include "skip_parser.hpp"
-#include "bench_grammar.hpp"
+#include "BenchLexer.hpp"
+#include "CircuitGraph.hpp"
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
-#include <boost/algorithm/string.hpp>
-
-#include <unordered_map>
 #include <stdexcept>
 
 #include "BenchmarkLib.h"
 
 
-#define OUTPUT_GATE_T    "OUTPUT"
-#define INPUT_GATE_T     "INPUT"
-#define FLIP_FLOP_GATE_T "DFF"
-#define BUFFER_GATE_T    "BUFF"
-#define NOT_GATE_T       "NOT"
-#define AND_GATE_T       "AND"
-#define OR_GATE_T        "OR"
-#define NAND_GATE_T      "NAND"
-#define NOR_GATE_T       "NOR"
-#define XOR_GATE_T       "XOR"
-
 /* Type definitions */
 typedef std::string label_t;                        ///< Type definition for labels
-typedef bench_format::bench_node_type bench_node_t; ///< Type definition for a node of the ISCAS85/89/99 bench format
-typedef size_t unique_ID_t;             ///< Type definition for unique identifiers for circuits
-typedef std::set<size_t> set_of_circuit_t;     ///< Type definition for set of circuits
-
-/**
- * \struct circuit_node_type
- * \brief Struct that represents a node from a circuit. 
- *
- */
-typedef struct circuit_node_t {
-    size_t id;                  ///< Unique ID for a node
-    std::string label;               ///< Node Label
-    std::string gate_type;           ///< Type of the gate (ex. AND, NOT, OR)
-    std::set<size_t> input_id_list;  ///< set containing all the inputs of the respective gate
-    std::set<size_t> output_id_list; ///< set containing all the outputs of the respective gate
-} circuit_node_t;
-
-typedef std::list<circuit_node_t> list_of_circuit_t; ///< Type definition for list of circuits
 
 
 /**
  * \class BenchParser
- * 
- * \brief Class to parse and convert bench nodes into circuits nodes.
+ *
+ * \brief Class to parse bench files into topologically sorted circuits.
  *
  *  Bench nodes are generated by parsing ISCAS85/89/99 bench format files.
  *
  * \authors {Carolina Nogueira, Lucas Deutschmann}
- * 
+ *
  */
 class BenchParser {
 private:
 
-    size_t id_counter;
-
-    std::set<label_t> output_labels;     ///< Set containing bench node labels of all OUTPUT gates
-    std::set<label_t> ff_labels;   ///< Set containing bench node labels of all FLIP FLOP gates.
-    ///<  When a FLIP FLOP gate is parsed, it is split into two circuit's gates:
-    ///< one will be handled as INPUT gate and the other one as OUTPUT gate.
-
-    std::set<label_t> outputs;
-
-    std::set<size_t> output_circuits;        ///< Set containing the unique ID of all OUTPUT gates
-    std::set<size_t> input_circuits;        ///< Set containing the unique ID of all INPUT gates
-
-    std::unordered_map<label_t, bench_node_t> label_to_node;                   ///< Mapping from bench node labels to bench node
-    std::unordered_map<label_t, size_t> labels_to_id;                   ///< Mapping from bench node labels to circuit unique IDs
-    std::unordered_map<size_t, circuit_node_t> id_to_circuit_node;  ///< Mapping from circuit unique IDs to circuit nodes
-
-    /* Topological Sorted Circuit */
-    list_of_circuit_t sorted_circuit; ///< List contained the topological sorted circuit nodes
-
-
-
-    /**
-     * \brief Print the labels2node_table table.
-     * \param none
-     * \return none
-     *
-     *  It prints all the labels and the data associated to bench nodes.
-     */
-    void PrintLabelsTable();
-
-    /**
-     * \brief Print the uuid2circuitNode_table table.
-     * \param none
-     * \return none
-     *
-     *  It prints all the unique IDs and the data associated to circuit nodes.
-     */
-    void PrintUUIDCircuitTable();
+    /* Kinds of circuit nodes a label can have */
+    enum class NodeKind : uint8_t { Gate, Output, FlipFlop };
 
-    /**
-     * \brief Print the set_of_output_labels list.
-     * \param none
-     * \return none
-     *
-     * It prints the list containing the label of all output nodes.
-     */
-    void PrintOutputList();
+    CircuitGraph sorted_circuit; ///< Topologically sorted circuit
+    std::set<label_t> outputs;   ///< Labels of all OUTPUT gates and of the inputs of all FLIP FLOP gates
 
-    /**
-     * \brief Print the labels2uuid_table table.
-     * \param none
-     * \return none
-     *
-     *  It prints all the labels and its associates unique circuit ID.
+    /* ------------------------------------------------
+     * State while building the circuit, indexed by the
+     * interned label or by the unsorted circuit ID
+     * ------------------------------------------------
      */
-    void PrintLabels2UUIDTable();
+    std::unique_ptr<BenchLexer> lexer;
+    std::vector<uint32_t> definitions;   ///< Statement defining every label as INPUT, gate or FLIP FLOP, None if undefined
+    std::vector<uint32_t> input_labels;  ///< Labels of all INPUT gates in the order of the file
+    std::vector<uint32_t> output_labels; ///< Labels of all OUTPUT gates
+    std::vector<uint32_t> ff_labels;     ///< Labels of all FLIP FLOP gates.
+    ///<  When a FLIP FLOP gate is parsed, it is split into two circuit's gates:
+    ///< one will be handled as INPUT gate and the other one as OUTPUT gate.
 
-    /**
-     * \brief prints the circuit starting from the given unique identificator.
-     * \param circuit_ID is unique_ID_t corresponding to a node circuit.
-     * \param indent is int and represents the depth of the node in the circuit.
-     * \return none
-     *
-     * It prints the circuit starting from circuit_ID node. Indent is an integer
-     *      corresponding to the depth of the node in the circuit. Each unity
-     *      will add four spaces as identation before printing the node's data.
-     *
-     */
-    void PrintCircuit(unique_ID_t circuit_ID, int indent);
+    std::vector<uint32_t> gate_nodes;      ///< Circuit ID of the INPUT or gate node of every label
+    std::vector<uint32_t> output_nodes;    ///< Circuit ID of the OUTPUT node of every label
+    std::vector<uint32_t> ff_nodes;        ///< Circuit ID of the FLIP FLOP node of every label
+    std::vector<uint32_t> output_circuits; ///< Circuit IDs of all OUTPUT and FLIP FLOP nodes
 
-    /**
-     * \brief prints the circuit starting from the given label's node.
-     * \param node_label is label_t
-     * \return none
-     *
-     */
-    void PrintCircuitByLabel(const label_t& node_label);
+    std::vector<GateType> node_types;     ///< Gate type of every circuit node
+    std::vector<uint32_t> node_labels;    ///< Label of every circuit node
+    std::vector<uint32_t> fanin_offsets;  ///< Position of the inputs of every circuit node in fanins
+    std::vector<uint32_t> fanin_counts;   ///< Number of distinct inputs of every circuit node
+    std::vector<uint32_t> fanins;         ///< Circuit IDs of the inputs, ascending per node
 
-    /**
-     * \brief prints all circuits from the set of circuit OUTPUTS.
-     * \param none
-     * \return none
-     *
-     */
-    void PrintCircuitsOfOutputSet();
+    /* Node whose inputs are being visited and the next input to visit */
+    struct PendingNode {
+        uint32_t node;
+        uint32_t next_input;
+    };
+    std::vector<PendingNode> pending_nodes; ///< Explicit stack of the depth-first construction
 
     /**
      * \brief prints the list of topological sorted circuit's node.
@@ -157,42 +81,6 @@ private:
      */
     void PrintSortedCircuitList();
 
-    /* ----------------
-     * Get functions
-     * ----------------
-     */
-
-    /**
-     * \brief return a list with the UUID of the INPUT gates of the circuit.
-     * \param none
-     * \return set_of_circuit_t
-     *
-     */
-    set_of_circuit_t GetListOfCircuitsInputs();
-
-    /**
-     * \brief return a list with the UUID of the OUTPUT gates of the circuit.
-     * \param none
-     * \return set_of_circuit_t
-     *
-     */
-    set_of_circuit_t GetListOfCircuitsOutputs();
-
-    /**
-     * \brief return a circuit node, given a its unique ID.
-     * \param circuit_node_uuid is unique_ID_t
-     * \return circuit_node_type
-     *
-     */
-    circuit_node_t GetCircuitNode(unique_ID_t circuit_node_uuid);
-
-    /**
-     * \brief return the table representing the circuit.
-     * \param none
-     * \return unordered_map<unique_ID_t, circuit_node_type>
-     *
-     */
-    std::unordered_map<unique_ID_t, circuit_node_t> GetCircuit();
     /* ---------------
      * Read File Functions
      * ---------------
@@ -200,11 +88,13 @@ private:
     /**
      * \brief Reads the file containing the circuit in the bench format.
      * \param bench_file is std::string.
+     * \param threads is the number of threads scanning the file.
      * \return bool returns true in case of success.
      *
-     *  Reads the file containing the circuit in the bench format.
+     *  Reads the file containing the circuit in the bench format with a BenchLexer.
+     *   Throws BenchParseError with the line and column of the first syntax error.
      */
-    bool parseFile(const std::string& bench_file);
+    bool parseFile(const std::string& bench_file, unsigned threads);
 
     /* ----------------
      * Insert functions
@@ -212,56 +102,81 @@ private:
      */
 
     /**
-     * \brief return the list of circuit nodes topologically sorted.
-     * \param bench_node is bench_node_t
-     * \return bool:
-     *          true  -> Node successfully added
-     *          false -> Node already exist and could not be added
+     * \brief find or add a node to the circuit given its label.
+     * \param label is the interned label
+     * \param kind selects the INPUT or gate, OUTPUT or FLIP FLOP node of the label
+     * \return circuit ID of the node
      *
-     * Adds a node to the labels table (labels2node) and to the
-     *      sets_of_outputs in case it is of gate type OUTPUT.
+     *  If the node does not exist yet, it is created and its inputs are
+     *      found or added depth first. Circuit IDs are handed out in the
+     *      order the nodes are created. The depth of the circuit only
+     *      grows the pending_nodes stack, not the call stack.
      *
      */
-    bool addToLabelTable(bench_node_t bench_node);
+    uint32_t findOrAddToCircuit(uint32_t label, NodeKind kind);
 
     /**
-     * \brief search or add the node to the circuit.
-     * \param bench_node is bench_node_t
-     * \return unique_ID_t representing the given bench_node
-     *
-     *  It searches if the bench node exist in the label2uuid_table.
-     *  If it does't, adds it to the table and return the unique ID.
-     *  Otherwise, simply return the unique ID of the node.
+     * \brief find a node or create it without visiting its inputs.
+     * \param label is the interned label
+     * \param kind selects the INPUT or gate, OUTPUT or FLIP FLOP node of the label
+     * \return circuit ID of the node
      *
+     *  A new node is pushed onto pending_nodes.
      */
-    unique_ID_t findOrAddToCircuit(const bench_node_t& bench_node);
+    uint32_t findOrCreateNode(uint32_t label, NodeKind kind);
 
     /**
-     * \brief find or add a node to the circuit given its label.
-     * \param node_label is label_t
-     * \return unique_ID_t representing the given label
-     *
-     *  It searches if the node corresponding to the given label is
-     *      already inserted into the labels2uuid_table table. If it is,
-     *      returns its id. If not, creates a new node into the circuit
-     *      and add it to the table.
+     * \brief return the label of the i-th input of a circuit node.
+     * \param node is the circuit ID
+     * \param input is the position of the input in the bench line
+     * \return interned label
+     */
+    uint32_t inputLabel(uint32_t node, uint32_t input) const;
+
+    /**
+     * \brief describe a cycle among the nodes the topological sort could not order.
+     * \param outgoing_edges is the number of unsorted gates using every node
+     * \return the labels along the cycle, e.g. "a -> b -> a"
+     */
+    std::string describeCycle(const std::vector<uint32_t> &outgoing_edges) const;
+
+    /* ------------------------------------------
+     * Netlist cache, the sorted circuit of a bench
+     * file saved next to it as <bench_file>.vdsn
+     * ------------------------------------------
+     */
+
+    /**
+     * \brief load the sorted circuit from the netlist cache of the bench file.
+     * \param bench_file is std::string.
+     * \return bool returns true if the cache belongs to the current content of the file.
      *
+     *  A cache with the size and modification time of the file is taken as is. If only the
+     *   modification time differs, the content hash decides and the cache is updated to the new time.
      */
-    unique_ID_t findOrAddToCircuitByLabel(const label_t& node_label);
+    bool loadNetlistCache(const std::string& bench_file);
 
-    /* --------------------
-     * Conversion functions
-     * --------------------
+    /* Identity of the bench file content a netlist cache was created from */
+    struct SourceKey {
+        uint64_t size;
+        int64_t mtime;  ///< Modification time in ns
+        uint64_t hash;  ///< LabelTable::Hash of the whole content
+    };
+
+    /**
+     * \brief return the size and modification time of the bench file, and the content hash if requested.
      */
+    static SourceKey sourceKey(const std::string& bench_file, bool hash);
 
     /**
-     * \brief converts bench node to circuit node.
-     * \param bench_node is bench_node_t and represents the node to be converted.
-     * \return circuit_node_type
+     * \brief save the sorted circuit as netlist cache of the bench file.
+     * \param bench_file is std::string.
+     * \param source is the key of the file taken before it was parsed
+     * \return none
      *
-     *  Given a bench_node_t, it converts the node into an circuit_node_type.
+     *  The cache is written to a temporary file and renamed, a cache that can not be written is skipped.
      */
-    circuit_node_t benchNodeToCircuitNode(const bench_node_t& bench_node);
+    void saveNetlistCache(const std::string& bench_file, const SourceKey &source);
 
     /*
      *
@@ -270,21 +185,13 @@ private:
      */
 
     /**
-     * \brief create a circuit from the labels in the set_of_output_labels.
+     * \brief create a circuit from the labels of all OUTPUT and FLIP FLOP gates.
      * \param none
      * \return none
      *
      */
     void createCircuitFromOutputList();
 
-    /**
-     * \brief create a circuit from the given node's label.
-     * \param bnode_label is label_t
-     * \return none
-     *
-     */
-    void createCircuitByLabel(const label_t& bnode_label);
-
     /* -----------------------------
      * Topological Sort Algorithms
      * -----------------------------
@@ -298,44 +205,29 @@ private:
      */
     void TopologicalSortKahnsAlgorithm();
 
-    /* -----------------------------
-     * Auxiliar functions for
-     * Topological Sort Algorithms
-     * -----------------------------
-     */
-
-    /**
-     * \brief auxiliar function for topological sort algorithms.
-     * \param src_node is unique_ID_t
-     * \param dst_node is unique_ID_t
-     * \return True if it was the only outgoing edge. False, otherwise.
-     *
-     * It removes the edge from src->dst at the table uuid2circuitNode and
-     * then checks if it was the only outgoing edge.
-     */
-    bool IsUniqueOutgoingEdge(unique_ID_t src_node, unique_ID_t dst_node);
-
 public:
     /**
     * \brief Constructor
     * \param bench_file the path to the benchmark file
+    * \param parse_threads the number of threads scanning large files, see BenchLexer
+    * \param netlist_cache load the sorted circuit from <bench_file>.vdsn if it is up to date, else create it
     *
     * Constructor method for the bench_circuit_manager class. It
     * generates the topological circuit described in the file
     * bench_file that must be in the ISCAS85/ISCAS89/ISCAS99 format.
     */
-    explicit BenchParser(const std::string& bench_file);
+    explicit BenchParser(const std::string& bench_file, unsigned parse_threads = 1, bool netlist_cache = false);
 
     ~BenchParser();
 
 
     /**
-     * \brief return the list of circuit nodes topologically sorted.
+     * \brief return the circuit with its nodes topologically sorted.
      * \param none
-     * \return list_of_circuit_t
+     * \return const CircuitGraph&, valid as long as the parser
      *
      */
-    list_of_circuit_t GetSortedCircuit();
+    const CircuitGraph &GetSortedCircuit() const;
 
     /**
      * \brief return a list with the labels of the OUTPUT gates of the circuit. The label's list also includes the FLIP_FLOPS
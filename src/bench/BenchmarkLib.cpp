@@ -8,6 +8,15 @@
 
 #include "BenchmarkLib.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
 using namespace std;
 
 
@@ -142,4 +151,167 @@ void process_mem_usage(double& vm_usage, double& resident_set)
 }
 
 
+// Reads a "Name:   value kB" line of /proc/self/status, returns bytes or 0
+static long long read_status_kb(const char *field) {
+	ifstream status("/proc/self/status");
+	string line;
+	size_t length = strlen(field);
+	while (getline(status, line)) {
+		if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+			return atoll(line.c_str() + length + 1) * 1024;
+	}
+	return 0;
+}
+
+static thread sampler_thread;
+static mutex sampler_mutex;
+static condition_variable sampler_wakeup;
+static bool sampler_running = false;
+static chrono::steady_clock::time_point sampler_start;
+static double mem_peak_time;
+static vector<pair<double, long long> > mem_series; // seconds since start, RSS in bytes
+
+static void take_memory_sample() {
+	double t = chrono::duration<double>(chrono::steady_clock::now() - sampler_start).count();
+	long long rss = read_status_kb("VmRSS");
+	if (rss > get_mem_peak())
+		mem_peak_time = t;
+	update_benmkng_memory(rss);
+	mem_series.push_back(make_pair(t, rss));
+}
+
+void start_memory_sampler(int interval_ms) {
+	stop_memory_sampler();
+
+	// writing 5 to clear_refs resets VmHWM (Linux >= 4.0), the write fails harmlessly elsewhere
+	ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5" << endl;
+
+	reset_peak_memory();
+	mem_series.clear();
+	mem_peak_time = 0;
+	sampler_start = chrono::steady_clock::now();
+	take_memory_sample();
+	if (interval_ms <= 0)
+		return;
+
+	sampler_running = true;
+	sampler_thread = thread([interval_ms]() {
+		unique_lock<mutex> lock(sampler_mutex);
+		while (!sampler_wakeup.wait_for(lock, chrono::milliseconds(interval_ms), []() { return !sampler_running; }))
+			take_memory_sample();
+	});
+}
+
+void stop_memory_sampler(void) {
+	if (sampler_thread.joinable()) {
+		{
+			lock_guard<mutex> lock(sampler_mutex);
+			sampler_running = false;
+		}
+		sampler_wakeup.notify_all();
+		sampler_thread.join();
+		take_memory_sample();
+	}
+}
+
+double get_mem_peak_time() {
+	return mem_peak_time;
+}
+
+long long get_mem_hwm() {
+	return read_status_kb("VmHWM");
+}
+
+void write_benmkng_memory_series() {
+	write_benmkng_memory();
+	benmkng_file << "Peak Memory Time (s): " << mem_peak_time << endl;
+	benmkng_file << "VmHWM (MB): " << get_mem_hwm() / 1e6 << endl;
+	benmkng_file << "Memory over Time (s, MB):";
+	for (size_t i = 0; i < mem_series.size(); i++)
+		benmkng_file << " " << mem_series[i].first << "," << mem_series[i].second / 1e6;
+	benmkng_file << endl;
+}
+
+static int perf_fds[PERF_COUNTER_COUNT] = {-1, -1, -1, -1, -1};
+
+static const char *perf_counter_names[PERF_COUNTER_COUNT] = {
+	"cycles", "instructions", "LLC misses", "dTLB misses", "branch misses"
+};
+
+int perf_counters_open(void) {
+	static const struct { __u32 type; __u64 config; } events[PERF_COUNTER_COUNT] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	};
+
+	int opened = 0;
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (perf_fds[i] >= 0)
+			close(perf_fds[i]);
+
+		// every counter is opened on its own, so a missing one does not take the others down
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.exclude_kernel = 1; // allowed with perf_event_paranoid <= 2
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		perf_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf_fds[i] >= 0)
+			opened++;
+	}
+	return opened;
+}
+
+void perf_counters_close(void) {
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (perf_fds[i] >= 0)
+			close(perf_fds[i]);
+		perf_fds[i] = -1;
+	}
+}
+
+perf_sample_t perf_counters_read(void) {
+	perf_sample_t sample;
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		unsigned long long data[3]; // value, time enabled, time running
+		sample.available[i] = perf_fds[i] >= 0 && read(perf_fds[i], data, sizeof(data)) == sizeof(data) && data[2] > 0;
+		sample.value[i] = 0;
+		if (sample.available[i])
+			sample.value[i] = (long long)((double)data[0] * (double)data[1] / (double)data[2]);
+	}
+	return sample;
+}
 
+perf_sample_t perf_counters_diff(const perf_sample_t& end, const perf_sample_t& begin) {
+	perf_sample_t diff;
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		diff.available[i] = end.available[i] && begin.available[i];
+		diff.value[i] = diff.available[i] ? end.value[i] - begin.value[i] : 0;
+	}
+	return diff;
+}
+
+void perf_counters_print(ostream& out, const string& phase, const perf_sample_t& counts, long long ops) {
+	out << " Counters " << phase << ":";
+	bool any = false;
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (!counts.available[i])
+			continue;
+		any = true;
+		out << " " << perf_counter_names[i] << ": " << counts.value[i];
+		if (i != PERF_CYCLES && i != PERF_INSTRUCTIONS && ops > 0)
+			out << " (" << (double)counts.value[i] / (double)ops << "/op)";
+	}
+	if (counts.available[PERF_CYCLES] && counts.available[PERF_INSTRUCTIONS] && counts.value[PERF_CYCLES] > 0)
+		out << " IPC: " << (double)counts.value[PERF_INSTRUCTIONS] / (double)counts.value[PERF_CYCLES];
+	if (!any)
+		out << " not available";
+	out << endl;
+}
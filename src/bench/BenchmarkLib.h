@@ -18,6 +18,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 using namespace std;
 
@@ -61,4 +62,52 @@ long long memUsing();
 
 void process_mem_usage(double& vm_usage, double& resident_set);
 
+// Background sampling of the resident set size, feeds update_benmkng_memory
+// starts a thread reading VmRSS every interval_ms milliseconds, resets the peak memory and the kernel's VmHWM
+void start_memory_sampler(int interval_ms);
+
+// stops the sampler thread, takes a last sample
+void stop_memory_sampler(void);
+
+// seconds since start_memory_sampler at which the peak RSS was sampled
+double get_mem_peak_time();
+
+// VmHWM (peak RSS tracked by the kernel) in bytes, 0 if not available
+long long get_mem_hwm();
+
+// writes peak, time at peak, VmHWM and the sampled series (seconds, MB) of the last sampler run
+void write_benmkng_memory_series();
+
+// Hardware performance counters of this process, read through perf_event_open
+enum perf_counter_t {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_COUNTER_COUNT
+};
+
+// counter values, a counter that could not be opened is not available
+struct perf_sample_t {
+	bool available[PERF_COUNTER_COUNT];
+	long long value[PERF_COUNTER_COUNT];
+};
+
+// opens the counters, returns how many are available. Without perf support (e.g. in a container) none is,
+// all other perf functions then work on empty samples
+int perf_counters_open(void);
+
+// closes the counters
+void perf_counters_close(void);
+
+// reads all counters, scaled up if the kernel multiplexed them
+perf_sample_t perf_counters_read(void);
+
+// counts between two samples
+perf_sample_t perf_counters_diff(const perf_sample_t& end, const perf_sample_t& begin);
+
+// prints the available counts, the IPC and the misses per operation (if ops > 0) of a phase
+void perf_counters_print(ostream& out, const string& phase, const perf_sample_t& counts, long long ops);
+
 #endif /* BENCHMARKLIB_H_ */
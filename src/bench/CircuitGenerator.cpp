@@ -0,0 +1,357 @@
+//
+// Parameterized circuit families for scaling studies
+//
+
+#include "CircuitGenerator.hpp"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+
+Netlist::Netlist(std::string name)
+    : name(std::move(name))
+{}
+
+std::string Netlist::AddInput(const std::string &label) {
+    inputs.push_back(label);
+    return label;
+}
+
+std::string Netlist::AddGate(const std::string &type, std::vector<std::string> gate_inputs) {
+    if (gate_inputs.empty()) {
+        throw std::invalid_argument("Netlist::AddGate: gate without inputs");
+    }
+    /* The bench format has no multiple input gates with a single input */
+    std::string gate_type = type;
+    if (gate_inputs.size() == 1 && type != "NOT" && type != "BUFF") {
+        gate_type = (type == "NAND" || type == "NOR") ? "NOT" : "BUFF";
+    }
+    std::string label = "g" + std::to_string(gates.size());
+    gates.push_back(Gate{label, gate_type, std::move(gate_inputs)});
+    return label;
+}
+
+void Netlist::AddOutput(const std::string &label) {
+    outputs.push_back(label);
+}
+
+void Netlist::WriteBench(std::ostream &out) const {
+    out << "# " << name << "\n"
+        << "# " << inputs.size() << " inputs\n"
+        << "# " << outputs.size() << " outputs\n"
+        << "# " << gates.size() << " gates\n\n";
+    for (const auto &input : inputs) {
+        out << "INPUT(" << input << ")\n";
+    }
+    out << "\n";
+    for (const auto &output : outputs) {
+        out << "OUTPUT(" << output << ")\n";
+    }
+    out << "\n";
+    for (const auto &gate : gates) {
+        out << gate.output << " = " << gate.type << "(";
+        for (size_t i = 0; i < gate.inputs.size(); i++) {
+            out << (i ? ", " : "") << gate.inputs[i];
+        }
+        out << ")\n";
+    }
+}
+
+std::vector<std::pair<std::string, ClassProject::BDD_ID>> Netlist::Build(ClassProject::ManagerInterface &manager) const {
+    std::unordered_map<std::string, ClassProject::BDD_ID> bdd_of;
+    for (const auto &input : inputs) {
+        bdd_of[input] = manager.createVar(input);
+    }
+    for (const auto &gate : gates) {
+        /* Multiple input gates are folded from left to right, as CircuitToBDD does */
+        ClassProject::BDD_ID result = bdd_of.at(gate.inputs.front());
+        for (size_t i = 1; i < gate.inputs.size(); i++) {
+            ClassProject::BDD_ID operand = bdd_of.at(gate.inputs[i]);
+            if (gate.type == "AND" || gate.type == "NAND") {
+                result = manager.and2(result, operand);
+            } else if (gate.type == "OR" || gate.type == "NOR") {
+                result = manager.or2(result, operand);
+            } else if (gate.type == "XOR") {
+                result = manager.xor2(result, operand);
+            } else {
+                throw std::invalid_argument("Netlist::Build: gate type " + gate.type + " with several inputs");
+            }
+        }
+        if (gate.type == "NAND" || gate.type == "NOR" || gate.type == "NOT") {
+            result = manager.neg(result);
+        }
+        bdd_of[gate.output] = result;
+    }
+    std::vector<std::pair<std::string, ClassProject::BDD_ID>> result;
+    for (const auto &output : outputs) {
+        result.emplace_back(output, bdd_of.at(output));
+    }
+    return result;
+}
+
+namespace CircuitGenerator {
+
+    namespace {
+
+        std::vector<std::string> labels(const std::string &prefix, unsigned n) {
+            std::vector<std::string> result;
+            for (unsigned i = 0; i < n; i++) {
+                result.push_back(prefix + std::to_string(i));
+            }
+            return result;
+        }
+
+        /* Adds the inputs in the good or bad order, or shuffled */
+        void addInputs(Netlist &netlist, std::vector<std::string> good, const std::vector<std::string> &bad, InputOrder order,
+                       uint32_t seed) {
+            if (order == InputOrder::Bad && !bad.empty()) {
+                good = bad;
+            } else if (order != InputOrder::Good) {
+                std::shuffle(good.begin(), good.end(), std::mt19937(seed));
+            }
+            for (const auto &label : good) {
+                netlist.AddInput(label);
+            }
+        }
+
+        /* Operand bits of a and b interleaved in the given bit order, and all of a before b */
+        void operandOrders(const std::vector<std::string> &a, const std::vector<std::string> &b, bool msb_first,
+                           std::vector<std::string> &interleaved, std::vector<std::string> &separated) {
+            for (size_t j = 0; j < a.size(); j++) {
+                size_t i = msb_first ? a.size() - 1 - j : j;
+                interleaved.push_back(a[i]);
+                interleaved.push_back(b[i]);
+            }
+            separated = a;
+            separated.insert(separated.end(), b.begin(), b.end());
+        }
+
+        std::string suffix(unsigned n, InputOrder order) {
+            static const char *names[] = {"good", "bad", "random"};
+            return "_" + std::to_string(n) + "_" + names[static_cast<int>(order)];
+        }
+
+    } // namespace
+
+    Netlist Adder(unsigned n, InputOrder order, uint32_t seed) {
+        Netlist netlist("adder" + suffix(n, order));
+        std::vector<std::string> a = labels("a", n), b = labels("b", n), good, bad;
+        operandOrders(a, b, false, good, bad);
+        addInputs(netlist, good, bad, order, seed);
+
+        std::string carry;
+        for (unsigned i = 0; i < n; i++) {
+            std::string half = netlist.AddGate("XOR", {a[i], b[i]});
+            std::string generate = netlist.AddGate("AND", {a[i], b[i]});
+            if (carry.empty()) {
+                netlist.AddOutput(half);
+                carry = generate;
+            } else {
+                netlist.AddOutput(netlist.AddGate("XOR", {half, carry}));
+                carry = netlist.AddGate("OR", {generate, netlist.AddGate("AND", {half, carry})});
+            }
+        }
+        if (!carry.empty()) {
+            netlist.AddOutput(carry);
+        }
+        return netlist;
+    }
+
+    Netlist Comparator(unsigned n, InputOrder order, uint32_t seed) {
+        Netlist netlist("comparator" + suffix(n, order));
+        std::vector<std::string> a = labels("a", n), b = labels("b", n), good, bad;
+        operandOrders(a, b, true, good, bad);
+        addInputs(netlist, good, bad, order, seed);
+
+        /* From the most significant bit: a < b if all bits above are equal and a_i < b_i */
+        std::string equal, less;
+        for (unsigned j = 0; j < n; j++) {
+            unsigned i = n - 1 - j;
+            std::string bit_equal = netlist.AddGate("NOT", {netlist.AddGate("XOR", {a[i], b[i]})});
+            std::string bit_less = netlist.AddGate("AND", {netlist.AddGate("NOT", {a[i]}), b[i]});
+            if (equal.empty()) {
+                equal = bit_equal;
+                less = bit_less;
+            } else {
+                less = netlist.AddGate("OR", {less, netlist.AddGate("AND", {equal, bit_less})});
+                equal = netlist.AddGate("AND", {equal, bit_equal});
+            }
+        }
+        if (!equal.empty()) {
+            netlist.AddOutput(less);
+            netlist.AddOutput(equal);
+        }
+        return netlist;
+    }
+
+    Netlist Multiplier(unsigned n, InputOrder order, uint32_t seed) {
+        Netlist netlist("multiplier" + suffix(n, order));
+        std::vector<std::string> a = labels("a", n), b = labels("b", n), good, bad;
+        operandOrders(a, b, false, good, bad);
+        addInputs(netlist, good, bad, order, seed);
+
+        /* Rows of partial products added with ripple-carry adders, empty labels are constant 0 */
+        std::vector<std::string> product(2 * n);
+        for (unsigned i = 0; i < n; i++) {
+            std::string carry;
+            for (unsigned j = 0; j < n; j++) {
+                std::string bit = netlist.AddGate("AND", {a[j], b[i]});
+                std::string &sum = product[i + j];
+                std::vector<std::string> addends{bit};
+                if (!sum.empty()) {
+                    addends.push_back(sum);
+                }
+                if (!carry.empty()) {
+                    addends.push_back(carry);
+                }
+                if (addends.size() == 1) {
+                    sum = bit;
+                    carry.clear();
+                } else if (addends.size() == 2) {
+                    sum = netlist.AddGate("XOR", addends);
+                    carry = netlist.AddGate("AND", addends);
+                } else {
+                    std::string half = netlist.AddGate("XOR", {addends[0], addends[1]});
+                    std::string next_carry = netlist.AddGate("OR", {netlist.AddGate("AND", {addends[0], addends[1]}),
+                                                                   netlist.AddGate("AND", {half, addends[2]})});
+                    sum = netlist.AddGate("XOR", {half, addends[2]});
+                    carry = next_carry;
+                }
+            }
+            product[i + n] = carry;
+        }
+        for (const auto &bit : product) {
+            if (!bit.empty()) {
+                netlist.AddOutput(bit);
+            }
+        }
+        return netlist;
+    }
+
+    Netlist Parity(unsigned n, InputOrder order, uint32_t seed) {
+        Netlist netlist("parity" + suffix(n, order));
+        std::vector<std::string> x = labels("x", n);
+        addInputs(netlist, x, {}, order, seed);
+
+        std::vector<std::string> level = x;
+        while (level.size() > 1) {
+            std::vector<std::string> next;
+            for (size_t i = 0; i + 1 < level.size(); i += 2) {
+                next.push_back(netlist.AddGate("XOR", {level[i], level[i + 1]}));
+            }
+            if (level.size() % 2) {
+                next.push_back(level.back());
+            }
+            level.swap(next);
+        }
+        if (!level.empty()) {
+            netlist.AddOutput(level.front());
+        }
+        return netlist;
+    }
+
+    Netlist Multiplexer(unsigned k, InputOrder order, uint32_t seed) {
+        if (k > 20) {
+            throw std::invalid_argument("CircuitGenerator::Multiplexer: more than 20 select bits");
+        }
+        Netlist netlist("mux" + suffix(k, order));
+        std::vector<std::string> s = labels("s", k), d = labels("d", 1u << k);
+        std::vector<std::string> good = s, bad = d;
+        good.insert(good.end(), d.begin(), d.end());
+        bad.insert(bad.end(), s.begin(), s.end());
+        addInputs(netlist, good, bad, order, seed);
+
+        std::vector<std::string> negated;
+        for (const auto &select : s) {
+            negated.push_back(netlist.AddGate("NOT", {select}));
+        }
+        std::vector<std::string> terms;
+        for (unsigned j = 0; j < d.size(); j++) {
+            std::vector<std::string> term{d[j]};
+            for (unsigned i = 0; i < k; i++) {
+                term.push_back((j >> i) & 1u ? s[i] : negated[i]);
+            }
+            terms.push_back(netlist.AddGate("AND", term));
+        }
+        netlist.AddOutput(netlist.AddGate("OR", terms));
+        return netlist;
+    }
+
+    Netlist Queens(unsigned n, InputOrder order, uint32_t seed) {
+        Netlist netlist("queens" + suffix(n, order));
+        auto x = [](unsigned row, unsigned column) { return "x" + std::to_string(row) + "_" + std::to_string(column); };
+        std::vector<std::string> good;
+        for (unsigned row = 0; row < n; row++) {
+            for (unsigned column = 0; column < n; column++) {
+                good.push_back(x(row, column));
+            }
+        }
+        addInputs(netlist, good, {}, order, seed);
+
+        /* A queen in every row, no two queens on a row, column or diagonal */
+        std::vector<std::string> constraints;
+        for (unsigned row = 0; row < n; row++) {
+            std::vector<std::string> cells;
+            for (unsigned column = 0; column < n; column++) {
+                cells.push_back(x(row, column));
+            }
+            constraints.push_back(netlist.AddGate("OR", cells));
+        }
+        for (unsigned cell = 0; cell < n * n; cell++) {
+            unsigned row = cell / n, column = cell % n;
+            for (unsigned other = cell + 1; other < n * n; other++) {
+                unsigned other_row = other / n, other_column = other % n;
+                unsigned row_distance = other_row - row;
+                unsigned column_distance = other_column > column ? other_column - column : column - other_column;
+                if (row == other_row || column == other_column || row_distance == column_distance) {
+                    constraints.push_back(netlist.AddGate("NAND", {x(row, column), x(other_row, other_column)}));
+                }
+            }
+        }
+        if (!constraints.empty()) {
+            netlist.AddOutput(netlist.AddGate("AND", constraints));
+        }
+        return netlist;
+    }
+
+    Netlist RandomCnf(unsigned n, unsigned clauses, unsigned k, InputOrder order, uint32_t seed) {
+        if (k == 0 || k > n) {
+            throw std::invalid_argument("CircuitGenerator::RandomCnf: clause width must be between 1 and the number of variables");
+        }
+        Netlist netlist("cnf" + suffix(n, order) + "_" + std::to_string(clauses) + "x" + std::to_string(k));
+        std::vector<std::string> x = labels("x", n);
+        addInputs(netlist, x, {}, order, seed);
+
+        /* The clauses do not depend on the order, the order shuffle uses a generator of its own */
+        std::mt19937 rng(seed);
+        std::vector<std::string> negated(n);
+        std::vector<std::string> terms;
+        std::vector<unsigned> vars(n);
+        for (unsigned c = 0; c < clauses; c++) {
+            for (unsigned i = 0; i < n; i++) {
+                vars[i] = i;
+            }
+            std::vector<std::string> literals;
+            for (unsigned i = 0; i < k; i++) {
+                std::swap(vars[i], vars[i + rng() % (n - i)]);
+                unsigned var = vars[i];
+                if (rng() & 1u) {
+                    if (negated[var].empty()) {
+                        negated[var] = netlist.AddGate("NOT", {x[var]});
+                    }
+                    literals.push_back(negated[var]);
+                } else {
+                    literals.push_back(x[var]);
+                }
+            }
+            terms.push_back(netlist.AddGate("OR", literals));
+        }
+        if (!terms.empty()) {
+            netlist.AddOutput(netlist.AddGate("AND", terms));
+        }
+        return netlist;
+    }
+
+} // namespace CircuitGenerator
@@ -0,0 +1,148 @@
+//
+// Parameterized circuit families for scaling studies
+//
+
+#pragma once
+
+#include "../ManagerInterface.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Variable order of a generated circuit, given by the order of its inputs
+ *
+ *  Good is the order known to keep the BDDs of the family small, Bad the one known to blow them up.
+ *  Families without a known worst order (parity, n-queens, k-CNF) treat Bad like Random.
+ */
+enum class InputOrder { Good, Bad, Random };
+
+/**
+ * \class Netlist
+ *
+ * \brief Gate-level circuit in the gate set of the bench format
+ *
+ *  The gates are stored in topological order, so the circuit can be written as a
+ *   .bench file or built into a BDD manager directly.
+ */
+class Netlist {
+public:
+
+    struct Gate {
+        std::string output;              ///< Label of the gate
+        std::string type;                ///< AND, OR, NAND, NOR, XOR, NOT or BUFF
+        std::vector<std::string> inputs; ///< Labels of the inputs
+    };
+
+    explicit Netlist(std::string name);
+
+    /**
+     * \brief Adds a primary input, the inputs are variables in the order they are added
+     * \param label of the input
+     * \return label
+     */
+    std::string AddInput(const std::string &label);
+
+    /**
+     * \brief Adds a gate with a generated label
+     * \param type of the gate
+     * \param inputs labels of the inputs
+     * \return label of the gate
+     */
+    std::string AddGate(const std::string &type, std::vector<std::string> inputs);
+
+    /**
+     * \brief Marks a gate or input as primary output
+     * \param label of the gate or input
+     * \return none
+     */
+    void AddOutput(const std::string &label);
+
+    /**
+     * \brief Writes the circuit in the bench format
+     * \param out stream to write to
+     * \return none
+     *
+     *  The INPUT lines are written in the variable order of the netlist. VDSProject_bench keeps it
+     *   with --var-order declared, by default it derives the order from its topological sort.
+     */
+    void WriteBench(std::ostream &out) const;
+
+    /**
+     * \brief Builds the BDDs of all outputs, creating the variables in the order of the inputs
+     * \param manager to build the BDDs in
+     * \return pairs of output label and BDD_ID
+     */
+    std::vector<std::pair<std::string, ClassProject::BDD_ID>> Build(ClassProject::ManagerInterface &manager) const;
+
+    const std::string &Name() const { return name; }
+    const std::vector<std::string> &Inputs() const { return inputs; }
+    const std::vector<std::string> &Outputs() const { return outputs; }
+    const std::vector<Gate> &Gates() const { return gates; }
+
+private:
+    std::string name;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::vector<Gate> gates;
+};
+
+namespace CircuitGenerator {
+
+    /**
+     * \brief n-bit ripple-carry adder, outputs the n sum bits and the carry
+     *
+     *  Good interleaves the operand bits (a0 b0 a1 b1 ...), linear size.
+     *   Bad puts all bits of a before b, exponential size.
+     */
+    Netlist Adder(unsigned n, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief n-bit unsigned comparator, outputs a < b and a == b
+     *
+     *  Good interleaves the operand bits from the most significant one, linear size.
+     *   Bad puts all bits of a before b, exponential size.
+     */
+    Netlist Comparator(unsigned n, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief n x n-bit array multiplier, outputs the 2n product bits
+     *
+     *  The middle product bits are exponential for every order (Bryant 1991).
+     *   Good interleaves the operand bits, Bad puts all bits of a before b.
+     */
+    Netlist Multiplier(unsigned n, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief Balanced XOR tree over n inputs
+     *
+     *  Every order gives 2n - 1 nodes, Good is the natural order.
+     */
+    Netlist Parity(unsigned n, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief Multiplexer with k select bits and 2^k data inputs
+     *
+     *  Good puts the select bits first, linear in the number of data inputs.
+     *   Bad puts the data inputs first, exponential in it.
+     */
+    Netlist Multiplexer(unsigned k, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief Constraints of the n-queens problem over n * n inputs, one output
+     *
+     *  The output is true for the placements of n non-attacking queens. Good is row-major.
+     */
+    Netlist Queens(unsigned n, InputOrder order, uint32_t seed = 1);
+
+    /**
+     * \brief Random k-CNF with n variables and the given number of clauses, one output
+     *
+     *  The clauses are drawn from the seed. Good is the natural order.
+     */
+    Netlist RandomCnf(unsigned n, unsigned clauses, unsigned k, InputOrder order, uint32_t seed = 1);
+
+} // namespace CircuitGenerator
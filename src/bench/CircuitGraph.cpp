@@ -0,0 +1,213 @@
+//
+// Topologically sorted circuit stored as flat arrays
+//
+
+#include "CircuitGraph.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+template <typename T>
+void WriteArray(std::ostream &out, const std::vector<T> &array) {
+    static const char padding[8] = {};
+    size_t bytes = array.size() * sizeof(T);
+    out.write(reinterpret_cast<const char *>(array.data()), static_cast<std::streamsize>(bytes));
+    out.write(padding, static_cast<std::streamsize>((8 - bytes % 8) % 8));
+}
+
+/* Reads the arrays written by WriteArray one after another */
+class ArrayReader {
+public:
+    explicit ArrayReader(std::string_view data) : data(data) {}
+
+    template <typename T>
+    bool Read(std::vector<T> &array, uint64_t count) {
+        if (count > (data.size() - pos) / sizeof(T)) {
+            return false;
+        }
+        size_t bytes = static_cast<size_t>(count) * sizeof(T);
+        array.resize(static_cast<size_t>(count));
+        std::memcpy(array.data(), data.data() + pos, bytes);
+        pos = std::min(data.size(), pos + (bytes + 7) / 8 * 8);
+        return true;
+    }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+};
+
+} // namespace
+
+uint32_t CircuitGraph::AddNode(GateType type, uint32_t label, const uint32_t *fanin, size_t fanin_count) {
+    uint32_t node = static_cast<uint32_t>(types.size());
+    for (size_t i = 0; i < fanin_count; i++) {
+        if (fanin[i] >= node) {
+            throw std::invalid_argument("CircuitGraph::AddNode: fanin " + std::to_string(fanin[i]) + " of node " +
+                                        std::to_string(node) + " is not added yet");
+        }
+    }
+    types.push_back(type);
+    label_ids.push_back(label);
+    fanins.insert(fanins.end(), fanin, fanin + fanin_count);
+    fanin_offsets.push_back(static_cast<uint32_t>(fanins.size()));
+    return node;
+}
+
+void CircuitGraph::Finish(LabelTable node_labels, const std::vector<uint32_t> &input_labels) {
+    labels = std::move(node_labels);
+    labels.ShrinkToFit();
+
+    /* Counting sort of the edges by their source, the fanouts of a node end up in ascending order */
+    fanout_offsets.assign(Size() + 1, 0);
+    for (uint32_t input : fanins) {
+        fanout_offsets[input + 1]++;
+    }
+    for (size_t node = 0; node < Size(); node++) {
+        fanout_offsets[node + 1] += fanout_offsets[node];
+    }
+    fanouts.resize(fanins.size());
+    std::vector<uint32_t> fill(fanout_offsets.begin(), fanout_offsets.end() - 1);
+    for (uint32_t node = 0; node < Size(); node++) {
+        for (uint32_t input : Fanin(node)) {
+            fanouts[fill[input]++] = node;
+        }
+    }
+
+    driver.assign(labels.Size(), None);
+    for (uint32_t node = 0; node < Size(); node++) {
+        if (types[node] != GateType::Output && types[node] != GateType::Dff) {
+            driver[label_ids[node]] = node;
+        }
+    }
+
+    std::vector<bool> declared(Size(), false);
+    declared_inputs.clear();
+    for (uint32_t label : input_labels) {
+        uint32_t node = label < driver.size() ? driver[label] : None;
+        if (node != None && types[node] == GateType::Input && !declared[node]) {
+            declared[node] = true;
+            declared_inputs.push_back(node);
+        }
+    }
+    for (uint32_t node = 0; node < Size(); node++) {
+        if (types[node] == GateType::Input && !declared[node]) {
+            declared_inputs.push_back(node);
+        }
+    }
+}
+
+uint32_t CircuitGraph::Find(std::string_view label) const {
+    uint32_t id;
+    if (!labels.Find(label, id) || id >= driver.size()) {
+        return None;
+    }
+    return driver[id];
+}
+
+size_t CircuitGraph::MemoryUsage() const {
+    return types.capacity() * sizeof(GateType) +
+           (label_ids.capacity() + fanin_offsets.capacity() + fanins.capacity() + fanout_offsets.capacity() +
+            fanouts.capacity() + driver.capacity() + declared_inputs.capacity()) * sizeof(uint32_t) +
+           labels.MemoryUsage();
+}
+
+void CircuitGraph::Save(std::ostream &out) const {
+    std::vector<uint64_t> counts{Size(), Edges(), labels.Size(), labels.chars.size(), labels.slots.size(),
+                                 declared_inputs.size()};
+    WriteArray(out, counts);
+    WriteArray(out, types);
+    WriteArray(out, label_ids);
+    WriteArray(out, fanin_offsets);
+    WriteArray(out, fanins);
+    WriteArray(out, fanout_offsets);
+    WriteArray(out, fanouts);
+    WriteArray(out, driver);
+    WriteArray(out, declared_inputs);
+    WriteArray(out, labels.offsets);
+    WriteArray(out, labels.chars);
+    WriteArray(out, labels.slots);
+}
+
+bool CircuitGraph::Load(std::string_view data) {
+    ArrayReader reader(data);
+    std::vector<uint64_t> counts;
+    bool complete = reader.Read(counts, 6);
+    if (complete) {
+        uint64_t nodes = counts[0], edges = counts[1], label_count = counts[2];
+        complete = nodes < UINT32_MAX && edges <= UINT32_MAX && label_count < UINT32_MAX &&
+                   counts[4] >= 16 && (counts[4] & (counts[4] - 1)) == 0 &&
+                   reader.Read(types, nodes) && reader.Read(label_ids, nodes) &&
+                   reader.Read(fanin_offsets, nodes + 1) && reader.Read(fanins, edges) &&
+                   reader.Read(fanout_offsets, nodes + 1) && reader.Read(fanouts, edges) &&
+                   reader.Read(driver, label_count) && reader.Read(declared_inputs, counts[5]) &&
+                   reader.Read(labels.offsets, label_count + 1) &&
+                   reader.Read(labels.chars, counts[3]) && reader.Read(labels.slots, counts[4]) &&
+                   fanin_offsets.back() == edges && fanout_offsets.back() == edges &&
+                   labels.offsets.back() == counts[3] && Valid();
+    }
+    if (!complete) {
+        *this = CircuitGraph();
+    }
+    return complete;
+}
+
+bool CircuitGraph::Valid() const {
+    uint32_t nodes = static_cast<uint32_t>(Size());
+    uint32_t label_count = static_cast<uint32_t>(labels.Size());
+    if (fanin_offsets[0] != 0 || fanout_offsets[0] != 0 || labels.offsets[0] != 0) {
+        return false;
+    }
+    for (uint32_t node = 0; node < nodes; node++) {
+        if (static_cast<uint8_t>(types[node]) > static_cast<uint8_t>(GateType::Xor) || label_ids[node] >= label_count ||
+            fanin_offsets[node] > fanin_offsets[node + 1] || fanout_offsets[node] > fanout_offsets[node + 1]) {
+            return false;
+        }
+        /* Inputs have no fanin, every other node at least one */
+        if ((types[node] == GateType::Input) != (fanin_offsets[node] == fanin_offsets[node + 1])) {
+            return false;
+        }
+        /* Topological order: fanins come before the node, fanouts after it */
+        for (uint32_t input : Fanin(node)) {
+            if (input >= node) {
+                return false;
+            }
+        }
+        for (uint32_t output : Fanout(node)) {
+            if (output <= node || output >= nodes) {
+                return false;
+            }
+        }
+    }
+    for (uint32_t node : driver) {
+        if (node != None && node >= nodes) {
+            return false;
+        }
+    }
+    for (uint32_t node : declared_inputs) {
+        if (node >= nodes || types[node] != GateType::Input) {
+            return false;
+        }
+    }
+
+    /* Every label is in one slot of the hash table, the others stay empty so lookups terminate */
+    for (uint32_t id = 0; id < label_count; id++) {
+        if (labels.offsets[id] > labels.offsets[id + 1]) {
+            return false;
+        }
+    }
+    size_t used = 0;
+    for (const LabelTable::Slot &slot : labels.slots) {
+        if (slot.id != LabelTable::Empty) {
+            if (slot.id >= label_count) {
+                return false;
+            }
+            used++;
+        }
+    }
+    return used == label_count && used < labels.slots.size();
+}
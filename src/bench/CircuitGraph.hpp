@@ -0,0 +1,120 @@
+//
+// Topologically sorted circuit stored as flat arrays
+//
+
+#pragma once
+
+#include "BenchLexer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/**
+ * \brief Read-only view of a range of node IDs
+ */
+struct IdSpan {
+    const uint32_t *first;
+    const uint32_t *last;
+
+    const uint32_t *begin() const { return first; }
+    const uint32_t *end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+    uint32_t operator[](size_t i) const { return first[i]; }
+};
+
+/**
+ * \class CircuitGraph
+ *
+ * \brief Circuit in compressed sparse row form, the nodes are numbered in topological order
+ *
+ *  Every node has a gate type, an interned label and its fanin and fanout as ranges of one
+ *   contiguous array each. All fanins of a node have smaller IDs than the node itself.
+ *   A flip flop appears twice: as an INPUT node with its label and as a DFF node with its data input,
+ *   every OUTPUT line becomes an OUTPUT node with the gate it names as the only fanin.
+ */
+class CircuitGraph {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    /**
+     * \brief Appends a node, all its fanins must be added already
+     * \return ID of the node
+     *
+     *  Throws std::invalid_argument if a fanin is not a node yet.
+     */
+    uint32_t AddNode(GateType type, uint32_t label, const uint32_t *fanin, size_t fanin_count);
+
+    /**
+     * \brief Takes the labels of the nodes and builds the fanout arrays, call once after the last AddNode
+     * \param input_labels labels of the INPUT lines in the order of the file, see DeclaredInputs()
+     */
+    void Finish(LabelTable node_labels, const std::vector<uint32_t> &input_labels = {});
+
+    size_t Size() const { return types.size(); }
+    size_t Edges() const { return fanins.size(); }
+
+    GateType Type(uint32_t node) const { return types[node]; }
+    uint32_t LabelId(uint32_t node) const { return label_ids[node]; }
+    std::string_view Label(uint32_t node) const { return labels.Label(label_ids[node]); }
+
+    IdSpan Fanin(uint32_t node) const {
+        return {fanins.data() + fanin_offsets[node], fanins.data() + fanin_offsets[node + 1]};
+    }
+    IdSpan Fanout(uint32_t node) const {
+        return {fanouts.data() + fanout_offsets[node], fanouts.data() + fanout_offsets[node + 1]};
+    }
+
+    /**
+     * \brief Returns the INPUT nodes in the order of their INPUT lines, followed by the remaining ones
+     *  (flip flop outputs) in topological order
+     */
+    IdSpan DeclaredInputs() const { return {declared_inputs.data(), declared_inputs.data() + declared_inputs.size()}; }
+
+    /**
+     * \brief Returns the INPUT or gate node driving a label, None if there is none
+     */
+    uint32_t Find(std::string_view label) const;
+
+    const LabelTable &Labels() const { return labels; }
+
+    /**
+     * \brief Returns the bytes allocated for the nodes, edges and labels
+     */
+    size_t MemoryUsage() const;
+
+    /**
+     * \brief Writes the finished graph as raw arrays, each padded to 8 bytes, see Load()
+     *
+     *  The layout is the one of the host, the data is meant as a cache on the same machine.
+     */
+    void Save(std::ostream &out) const;
+
+    /**
+     * \brief Replaces the graph by one written with Save()
+     * \param data starting 8 byte aligned, e.g. a memory-mapped file
+     * \return false if the data does not hold a complete and consistent graph, the graph is empty then
+     *
+     *  All node, edge and label IDs are range-checked in one pass, a damaged cache is never dereferenced.
+     */
+    bool Load(std::string_view data);
+
+private:
+    std::vector<GateType> types;
+    std::vector<uint32_t> label_ids;
+    std::vector<uint32_t> fanin_offsets{0};
+    std::vector<uint32_t> fanins;
+    std::vector<uint32_t> fanout_offsets;
+    std::vector<uint32_t> fanouts;
+    std::vector<uint32_t> driver;  ///< INPUT or gate node of every label, None for OUTPUT and DFF only labels
+    std::vector<uint32_t> declared_inputs;
+    LabelTable labels;
+
+    /**
+     * \brief Returns true if all IDs of a loaded graph are in range and the fanins precede their nodes
+     */
+    bool Valid() const;
+};
@@ -4,6 +4,8 @@
 //
 
 #include "CircuitToBDD.hpp"
+#include "BddSerializer.h"
+#include "Tracer.h"
 
 // #include "tqdm/tqdm.h"
 
@@ -12,12 +14,27 @@
 
 CircuitToBDD::CircuitToBDD(shared_ptr<ClassProject::ManagerInterface> BDD_manager_p) {
     bdd_manager = std::move(BDD_manager_p);
+    governed_manager = dynamic_cast<ClassProject::Manager *>(bdd_manager.get());
 }
 
 CircuitToBDD::~CircuitToBDD() = default;
 
-void CircuitToBDD::GenerateBDD(const list_of_circuit_t &circuit, const std::string& benchmark_file) {
+void CircuitToBDD::SetTraceSampling(size_t every) {
+    trace_every = every;
+}
+
+void CircuitToBDD::SetLevelProfileSampling(size_t every) {
+    profile_every = every;
+}
+
+void CircuitToBDD::SetVariableOrder(VariableOrder order) {
+    variable_order = order;
+}
+
+void CircuitToBDD::GenerateBDD(const CircuitGraph &circuit, const std::string& benchmark_file) {
+    ClassProject::TraceSpan generate_span("GenerateBDD", "bdd", benchmark_file);
     ClassProject::BDD_ID BDD_node;
+    size_t gate_count = 0;
 
     std::filesystem::path pathToBenchFile(benchmark_file);
     if (!pathToBenchFile.has_filename())
@@ -38,6 +55,31 @@ void CircuitToBDD::GenerateBDD(const list_of_circuit_t &circuit, const std::stri
 
     bdd_out_file << "BDD_ID,Bench Label" << std::endl;
 
+    std::ofstream profile_out_file;
+    if (profile_every > 0) {
+        if (!governed_manager) {
+            throw std::runtime_error("CircuitToBDD::GenerateBDD: level profiles need a ClassProject::Manager");
+        }
+        std::string samples_file_name = result_dir + "/level_profile_samples.csv";
+        profile_out_file.open(samples_file_name);
+        if (!profile_out_file.is_open()) {
+            throw std::runtime_error("CircuitToBDD::GenerateBDD: unable to open " + samples_file_name);
+        }
+        profile_out_file << "gate,label,level,variable,nodes" << std::endl;
+    }
+    size_t built_count = 0;
+
+    sorted_circuit = &circuit;
+    node_to_bdd_id.assign(circuit.Size(), NoBdd);
+    aborted_nodes.clear();
+
+    /* The INPUT gates find their variables created already */
+    if (variable_order == VariableOrder::Declared) {
+        for (uint32_t input : circuit.DeclaredInputs()) {
+            InputGate(circuit.Label(input));
+        }
+    }
+
     // Output left nodes with tqdm
     // auto listiter = circuit.cbegin();
     // size_t start = 0;
@@ -47,30 +89,97 @@ void CircuitToBDD::GenerateBDD(const list_of_circuit_t &circuit, const std::stri
     // for(int i : tqdmiter) {
         // auto circuit_node = *listiter;
         // listiter++;
-    for (const auto &circuit_node : circuit) {
-        if (circuit_node.gate_type == INPUT_GATE_T) {
-            BDD_node = InputGate(circuit_node.label);
-        } else if (circuit_node.gate_type == NOT_GATE_T) {
-            BDD_node = NotGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == AND_GATE_T) {
-            BDD_node = AndGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == OR_GATE_T) {
-            BDD_node = OrGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == NAND_GATE_T) {
-            BDD_node = NandGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == NOR_GATE_T) {
-            BDD_node = NorGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == XOR_GATE_T) {
-            BDD_node = XorGate(circuit_node.input_id_list);
-        } else if (circuit_node.gate_type == BUFFER_GATE_T) {
-            BDD_node = findBddId(*circuit_node.input_id_list.begin());
+    for (uint32_t circuit_node = 0; circuit_node < circuit.Size(); circuit_node++) {
+        GateType gate_type = circuit.Type(circuit_node);
+        IdSpan inputs = circuit.Fanin(circuit_node);
+
+        /* Gates depending on an aborted gate can not be built either */
+        if (const std::string *reason = findAborted(inputs)) {
+            aborted_nodes.emplace(circuit_node, *reason);
+            node_to_bdd_id[circuit_node] = AbortedBdd;
+            continue;
+        }
+
+        /* Sampled gates are traced with their label, followed by the size of the unique table */
+        bool traced = ClassProject::Tracer::enabled() && trace_every > 0 && gate_count++ % trace_every == 0;
+        std::unique_ptr<ClassProject::TraceSpan> gate_span;
+        if (traced) {
+            gate_span = std::make_unique<ClassProject::TraceSpan>("gate", "bdd", std::string(circuit.Label(circuit_node)));
+        }
+
+        /* Nodes of a gate exceeding the resource limits are dropped again */
+        ClassProject::Checkpoint checkpoint{};
+        if (governed_manager) {
+            checkpoint = governed_manager->checkpoint();
         }
 
         /* OUTPUT or FLIP FLOP gates do not generate a BDD */
-        if (!((circuit_node.gate_type == OUTPUT_GATE_T) | (circuit_node.gate_type == FLIP_FLOP_GATE_T))) {
-            node_to_bdd_id.insert(std::pair<unique_ID_t, ClassProject::BDD_ID>(circuit_node.id, BDD_node));
-            label_to_bdd_id.insert(std::pair<label_t, ClassProject::BDD_ID>(circuit_node.label, BDD_node));
-            bdd_out_file << BDD_node << "," << circuit_node.label << std::endl;
+        BDD_node = NoBdd;
+        try {
+            switch (gate_type) {
+            case GateType::Input:
+                BDD_node = InputGate(circuit.Label(circuit_node));
+                break;
+            case GateType::Not:
+                BDD_node = NotGate(inputs);
+                break;
+            case GateType::And:
+                BDD_node = AndGate(inputs);
+                break;
+            case GateType::Or:
+                BDD_node = OrGate(inputs);
+                break;
+            case GateType::Nand:
+                BDD_node = NandGate(inputs);
+                break;
+            case GateType::Nor:
+                BDD_node = NorGate(inputs);
+                break;
+            case GateType::Xor:
+                BDD_node = XorGate(inputs);
+                break;
+            case GateType::Buff:
+                BDD_node = findBddId(inputs[0]);
+                break;
+            case GateType::Output:
+            case GateType::Dff:
+                break;
+            }
+        } catch (const ClassProject::BudgetExceeded &e) {
+            /* The manager stays usable, only this gate and its fanout are lost */
+            governed_manager->rollback(checkpoint);
+            aborted_nodes.emplace(circuit_node, e.what());
+            node_to_bdd_id[circuit_node] = AbortedBdd;
+            continue;
+        }
+        if (governed_manager) {
+            governed_manager->commit(checkpoint);
+        }
+        if (traced) {
+            gate_span.reset();
+            ClassProject::Tracer::counter("live nodes", double(bdd_manager->uniqueTableSize()));
+        }
+
+        if (BDD_node != NoBdd) {
+            node_to_bdd_id[circuit_node] = BDD_node;
+            bdd_out_file << BDD_node << "," << circuit.Label(circuit_node) << std::endl;
+        }
+
+        /* Sampled profiles cover the BDDs of all gates built so far */
+        if (profile_every > 0 && ++built_count % profile_every == 0) {
+            std::vector<ClassProject::BDD_ID> roots;
+            for (uint32_t built = 0; built <= circuit_node; built++) {
+                if (node_to_bdd_id[built] < AbortedBdd) {
+                    roots.push_back(node_to_bdd_id[built]);
+                }
+            }
+            ClassProject::LevelProfile profile = governed_manager->levelProfile(roots, false);
+            for (size_t level = 0; level < profile.total.size(); level++) {
+                if (profile.total[level] > 0) {
+                    profile_out_file << built_count << "," << circuit.Label(circuit_node) << "," << level << ","
+                                     << bdd_manager->getTopVarName(profile.vars[level]) << "," << profile.total[level] << "\n";
+                }
+            }
         }
     }
     // std::cout << "\n" << std::endl;
@@ -79,43 +188,48 @@ void CircuitToBDD::GenerateBDD(const list_of_circuit_t &circuit, const std::stri
 }
 
 
-ClassProject::BDD_ID CircuitToBDD::findBddId(unique_ID_t circuit_node) {
+ClassProject::BDD_ID CircuitToBDD::findBddId(uint32_t circuit_node) {
 
-    auto bdd_id_it = node_to_bdd_id.find(circuit_node);
-
-    if (bdd_id_it != node_to_bdd_id.end()) {
-        return bdd_id_it->second;
+    if (node_to_bdd_id[circuit_node] < AbortedBdd) {
+        return node_to_bdd_id[circuit_node];
     } else {
         throw std::runtime_error("Destination node ID is not part of the circuit graph!");
     }
 }
 
 
-ClassProject::BDD_ID CircuitToBDD::InputGate(const label_t &label) {
-    return bdd_manager->createVar(label);
+const std::string *CircuitToBDD::findAborted(IdSpan inputNodes) const {
+    for (uint32_t node : inputNodes) {
+        if (node_to_bdd_id[node] == AbortedBdd) {
+            return &aborted_nodes.at(node);
+        }
+    }
+    return nullptr;
 }
 
 
-ClassProject::BDD_ID CircuitToBDD::NotGate(const set_of_circuit_t &inputNodes) {
-    unique_ID_t node = *inputNodes.begin();
-    return bdd_manager->neg(findBddId(node));
+ClassProject::BDD_ID CircuitToBDD::findOutput(const label_t &label) const {
+    uint32_t node = sorted_circuit ? sorted_circuit->Find(label) : CircuitGraph::None;
+    return node == CircuitGraph::None ? NoBdd : node_to_bdd_id[node];
 }
 
 
-ClassProject::BDD_ID CircuitToBDD::AndGate(set_of_circuit_t inputNodes) {
-    auto it = inputNodes.begin();
-    ClassProject::BDD_ID first_op, second_op;
+ClassProject::BDD_ID CircuitToBDD::InputGate(std::string_view label) {
+    return bdd_manager->createVar(std::string(label));
+}
+
 
-    /* Get the ClassProject::BDD_ID of first elements */
-    first_op = findBddId(*it);
-    inputNodes.erase(it);
+ClassProject::BDD_ID CircuitToBDD::NotGate(IdSpan inputNodes) {
+    return bdd_manager->neg(findBddId(inputNodes[0]));
+}
 
-    while (!inputNodes.empty()) {
-        it = inputNodes.begin();
-        second_op = findBddId(*it);
-        inputNodes.erase(it);
 
-        first_op = bdd_manager->and2(first_op, second_op);
+ClassProject::BDD_ID CircuitToBDD::AndGate(IdSpan inputNodes) {
+    /* Get the ClassProject::BDD_ID of first elements */
+    ClassProject::BDD_ID first_op = findBddId(inputNodes[0]);
+
+    for (size_t i = 1; i < inputNodes.size(); i++) {
+        first_op = bdd_manager->and2(first_op, findBddId(inputNodes[i]));
     }
 
     /* Return the ClassProject::BDD_ID equivalent to the AND of all inputs */
@@ -123,94 +237,58 @@ ClassProject::BDD_ID CircuitToBDD::AndGate(set_of_circuit_t inputNodes) {
 }
 
 
-ClassProject::BDD_ID CircuitToBDD::OrGate(set_of_circuit_t inputNodes) {
-    auto it = inputNodes.begin();
-    ClassProject::BDD_ID first_op, second_op;
-
+ClassProject::BDD_ID CircuitToBDD::OrGate(IdSpan inputNodes) {
     /* Get the ClassProject::BDD_ID of first elements */
-    first_op = findBddId(*it);
-    inputNodes.erase(it);
-
-    while (!inputNodes.empty()) {
-        it = inputNodes.begin();
-        second_op = findBddId(*it);
-        inputNodes.erase(it);
+    ClassProject::BDD_ID first_op = findBddId(inputNodes[0]);
 
-        first_op = bdd_manager->or2(first_op, second_op);
+    for (size_t i = 1; i < inputNodes.size(); i++) {
+        first_op = bdd_manager->or2(first_op, findBddId(inputNodes[i]));
     }
 
     /* Return the ClassProject::BDD_ID equivalent to the OR of all inputs */
     return first_op;
 }
 
-ClassProject::BDD_ID CircuitToBDD::NandGate(set_of_circuit_t inputNodes) {
-    auto it = inputNodes.begin();
-    ClassProject::BDD_ID first_op, second_op;
-
+ClassProject::BDD_ID CircuitToBDD::NandGate(IdSpan inputNodes) {
     /* Get the ClassProject::BDD_ID of first elements */
-    it = inputNodes.begin();
-    first_op = findBddId(*it);
-    inputNodes.erase(it);
-
-    if (inputNodes.size() == 1) {
-        it = inputNodes.begin();
-        second_op = findBddId(*it);
-        inputNodes.erase(it);
+    ClassProject::BDD_ID first_op = findBddId(inputNodes[0]);
+    IdSpan rest{inputNodes.begin() + 1, inputNodes.end()};
 
+    if (rest.empty()) {
+        /* All inputs were the same gate */
+        return bdd_manager->neg(first_op);
+    } else if (rest.size() == 1) {
         /* Create the NAND BDD node for the first two elements */
-        first_op = bdd_manager->nand2(first_op, second_op);
+        return bdd_manager->nand2(first_op, findBddId(rest[0]));
     } else {
         /* AND of all inputs, to use as the second operator of the NAND gate */
-        second_op = AndGate(inputNodes);
-        /* Create the NAND BDD node */
-        first_op = bdd_manager->nand2(first_op, second_op);
+        return bdd_manager->nand2(first_op, AndGate(rest));
     }
-
-    /* Return the ClassProject::BDD_ID equivalent to the NAND of all inputs */
-    return first_op;
 }
 
-ClassProject::BDD_ID CircuitToBDD::NorGate(set_of_circuit_t inputNodes) {
-    auto it = inputNodes.begin();
-    ClassProject::BDD_ID first_op, second_op;
-
+ClassProject::BDD_ID CircuitToBDD::NorGate(IdSpan inputNodes) {
     /* Get the ClassProject::BDD_ID of first elements */
-    it = inputNodes.begin();
-    first_op = findBddId(*it);
-    inputNodes.erase(it);
-
-    if (inputNodes.size() == 1) {
-        it = inputNodes.begin();
-        second_op = findBddId(*it);
-        inputNodes.erase(it);
+    ClassProject::BDD_ID first_op = findBddId(inputNodes[0]);
+    IdSpan rest{inputNodes.begin() + 1, inputNodes.end()};
 
+    if (rest.empty()) {
+        /* All inputs were the same gate */
+        return bdd_manager->neg(first_op);
+    } else if (rest.size() == 1) {
         /* Create the NOR BDD node for the first two elements */
-        first_op = bdd_manager->nor2(first_op, second_op);
+        return bdd_manager->nor2(first_op, findBddId(rest[0]));
     } else {
-        /* OR of all inputs, to use as the second operator of the NAND gate */
-        second_op = OrGate(inputNodes);
-        /* Create the NOR BDD node */
-        first_op = bdd_manager->nor2(first_op, second_op);
+        /* OR of all inputs, to use as the second operator of the NOR gate */
+        return bdd_manager->nor2(first_op, OrGate(rest));
     }
-
-    /* Return the ClassProject::BDD_ID equivalent to the NOR of all inputs */
-    return first_op;
 }
 
-ClassProject::BDD_ID CircuitToBDD::XorGate(set_of_circuit_t inputNodes) {
-    auto it = inputNodes.begin();
-    ClassProject::BDD_ID first_op, second_op;
-
+ClassProject::BDD_ID CircuitToBDD::XorGate(IdSpan inputNodes) {
     /* Get the ClassProject::BDD_ID of first elements */
-    first_op = findBddId(*it);
-    inputNodes.erase(it);
-
-    while (!inputNodes.empty()) {
-        it = inputNodes.begin();
-        second_op = findBddId(*it);
-        inputNodes.erase(it);
+    ClassProject::BDD_ID first_op = findBddId(inputNodes[0]);
 
-        first_op = bdd_manager->xor2(first_op, second_op);
+    for (size_t i = 1; i < inputNodes.size(); i++) {
+        first_op = bdd_manager->xor2(first_op, findBddId(inputNodes[i]));
     }
 
     /* Return the ClassProject::BDD_ID equivalent to the XOR of all inputs */
@@ -218,6 +296,7 @@ ClassProject::BDD_ID CircuitToBDD::XorGate(set_of_circuit_t inputNodes) {
 }
 
 void CircuitToBDD::PrintBDD(const std::set<label_t> &output_labels) {
+    ClassProject::TraceSpan span("PrintBDD", "dump");
 
     if ((!(std::filesystem::exists(result_dir + "/txt")) &
          !(std::filesystem::create_directory(result_dir + "/txt")))
@@ -228,9 +307,14 @@ void CircuitToBDD::PrintBDD(const std::set<label_t> &output_labels) {
 
     for (const auto &output_label : output_labels) {
 
-        auto output_id_it = label_to_bdd_id.find(output_label);
+        ClassProject::BDD_ID output_id = findOutput(output_label);
+        if (output_id == AbortedBdd) {
+            std::cout << "- Output " << output_label << ": budget exceeded ("
+                      << aborted_nodes.at(sorted_circuit->Find(output_label)) << ")" << std::endl;
+            continue;
+        }
 
-        if (output_id_it != label_to_bdd_id.end()) {
+        if (output_id != NoBdd) {
 
             std::string dot_file_name = result_dir + "/dot/" + std::string(output_label) + ".dot";
             std::string txt_file_name = result_dir + "/txt/" + std::string(output_label) + ".txt";
@@ -244,8 +328,8 @@ void CircuitToBDD::PrintBDD(const std::set<label_t> &output_labels) {
 
             output_nodes.clear();
             output_vars.clear();
-            bdd_manager->findNodes(output_id_it->second, output_nodes);
-            bdd_manager->findVars(output_id_it->second, output_vars);
+            bdd_manager->findNodes(output_id, output_nodes);
+            bdd_manager->findVars(output_id, output_vars);
 
             dumpBddText(bdd_out_txt_file);
             dumpBddDot(bdd_out_dot_file);
@@ -259,6 +343,60 @@ void CircuitToBDD::PrintBDD(const std::set<label_t> &output_labels) {
     }
 }
 
+std::string CircuitToBDD::WriteBinary(const std::set<label_t> &output_labels) {
+    ClassProject::TraceSpan span("WriteBinary", "dump");
+    std::string bin_file_name = result_dir + "/outputs.bdd";
+    std::ofstream bdd_out_bin_file(bin_file_name, std::ios::binary);
+
+    if (!bdd_out_bin_file.is_open()) {
+        throw std::runtime_error("Unable to open " + bin_file_name);
+    }
+
+    ClassProject::BddWriter writer(bdd_out_bin_file, *bdd_manager);
+    for (const auto &output : GetOutputs(output_labels)) {
+        writer.write(output.first, output.second);
+    }
+    writer.finish();
+    return bin_file_name;
+}
+
+std::string CircuitToBDD::WriteLevelProfile(const std::set<label_t> &output_labels) {
+    if (!governed_manager) {
+        throw std::runtime_error("CircuitToBDD::WriteLevelProfile: level profiles need a ClassProject::Manager");
+    }
+    std::string profile_file_name = result_dir + "/level_profile.csv";
+    std::ofstream profile_out_file(profile_file_name);
+
+    if (!profile_out_file.is_open()) {
+        throw std::runtime_error("CircuitToBDD::WriteLevelProfile: unable to open " + profile_file_name);
+    }
+
+    std::vector<std::string> names;
+    std::vector<ClassProject::BDD_ID> roots;
+    for (const auto &output : GetOutputs(output_labels)) {
+        names.push_back(output.first);
+        roots.push_back(output.second);
+    }
+    profile_out_file << "output,level,variable,nodes" << std::endl;
+    governed_manager->levelProfile(roots).writeCsv(profile_out_file, names, *bdd_manager);
+    return profile_file_name;
+}
+
+std::vector<std::pair<std::string, ClassProject::BDD_ID>> CircuitToBDD::GetOutputs(const std::set<label_t> &output_labels) const {
+    std::vector<std::pair<std::string, ClassProject::BDD_ID>> outputs;
+    for (const auto &output_label : output_labels) {
+        ClassProject::BDD_ID output_id = findOutput(output_label);
+        if (output_id < AbortedBdd) {
+            outputs.emplace_back(output_label, output_id);
+        }
+    }
+    return outputs;
+}
+
+size_t CircuitToBDD::GetAbortedCount() const {
+    return aborted_nodes.size();
+}
+
 void CircuitToBDD::dumpBddText(std::ostream &out) {
     for (auto it = output_nodes.rbegin(); it != output_nodes.rend(); ++it) {
         if (bdd_manager->isConstant(*it)) {
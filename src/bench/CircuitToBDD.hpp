@@ -6,12 +6,21 @@
 #pragma once
 
 #include "BenchParser.hpp"
-#include "../ManagerInterface.h"
+#include "../Manager.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <limits>
 
 
+/**
+ * \brief Order in which CircuitToBDD creates the variables of the circuit inputs
+ */
+enum class VariableOrder {
+    Topological, ///< When the sorted circuit reaches the input
+    Declared     ///< In the order of the INPUT lines, before the first gate, see CircuitGraph::DeclaredInputs()
+};
+
 /**
  * \class CircuitToBDD
  * 
@@ -31,97 +40,183 @@ public:
 
     /**
      * \brief Generates a BDD from the circuit nodes provided
-     * \param Topologically sorted list containing the circuit nodes
+     * \param Topologically sorted circuit, it must outlive this object
      * \return none
      *
      *  Generates the calls to the BDD package in order to
      *   generate the BDD equivalent to the provided circuit.
      */
-    void GenerateBDD(const std::list<circuit_node_t> &circuit, const std::string& benchmark_file);
+    void GenerateBDD(const CircuitGraph &circuit, const std::string& benchmark_file);
+
+    /**
+     * \brief Sets how often gates are traced while generating the BDD
+     * \param every trace every n-th gate as a span, 0 to trace no gates
+     * \return none
+     *
+     *  Only takes effect while the ClassProject::Tracer is enabled.
+     */
+    void SetTraceSampling(size_t every);
+
+    /**
+     * \brief Sets how often the level profile of all gates built so far is sampled while generating the BDD
+     * \param every sample after every n-th gate, 0 to sample never
+     * \return none
+     *
+     *  The samples are written to level_profile_samples.csv in the result directory,
+     *   one "gate,label,level,variable,nodes" line per non-empty level. Needs a ClassProject::Manager.
+     */
+    void SetLevelProfileSampling(size_t every);
+
+    /**
+     * \brief Sets the order in which the variables of the inputs are created
+     * \param order Topological (default) or Declared
+     * \return none
+     *
+     *  Declared keeps the variable order of generated circuits, whose INPUT lines are written in that order.
+     */
+    void SetVariableOrder(VariableOrder order);
 
 
     /**
      * \brief Print the generated BDD in text and dot format
      * \param The set of output labels to print a BDD for
      * \return none
+     *
+     *  Outputs whose BDD exceeded the resource limits of the manager
+     *   are reported as "budget exceeded" instead.
      */
     void PrintBDD(const std::set<label_t> &output_labels);
 
+    /**
+     * \brief Write the BDDs of the given outputs in the binary BDD format
+     * \param The set of output labels to write
+     * \return path of the written file
+     *
+     *  All outputs are written into one file, sharing their common nodes.
+     *   Outputs that exceeded the resource limits are skipped.
+     */
+    std::string WriteBinary(const std::set<label_t> &output_labels);
+
+    /**
+     * \brief Write the nodes per variable level of the given outputs as CSV
+     * \param The set of output labels to profile
+     * \return path of the written file
+     *
+     *  Nodes reachable from one output only are counted for that output, the others as "shared",
+     *   see ClassProject::LevelProfile. Needs a ClassProject::Manager.
+     */
+    std::string WriteLevelProfile(const std::set<label_t> &output_labels);
+
+    /**
+     * \brief Returns the BDDs of the given outputs
+     * \param The set of output labels
+     * \return pairs of output label and BDD_ID, outputs that exceeded the resource limits are skipped
+     */
+    std::vector<std::pair<std::string, ClassProject::BDD_ID>> GetOutputs(const std::set<label_t> &output_labels) const;
+
+    /**
+     * \brief Returns the number of gates whose BDD exceeded the resource limits of the manager
+     * \return number of aborted gates, including the gates depending on them
+     */
+    size_t GetAbortedCount() const;
+
 private:
 
-    std::unordered_map<unique_ID_t, ClassProject::BDD_ID> node_to_bdd_id; ///< Mapping from circuit node's unique ID to its BDD ID
-    std::unordered_map<label_t, ClassProject::BDD_ID> label_to_bdd_id; ///< Mapping from node's label to its BDD ID
+    static constexpr ClassProject::BDD_ID NoBdd = std::numeric_limits<ClassProject::BDD_ID>::max(); ///< Node without a BDD
+    static constexpr ClassProject::BDD_ID AbortedBdd = NoBdd - 1; ///< Node exceeding the resource limits
+
+    const CircuitGraph *sorted_circuit = nullptr; ///< Circuit of the last GenerateBDD call
+    std::vector<ClassProject::BDD_ID> node_to_bdd_id; ///< BDD ID of every circuit node, NoBdd or AbortedBdd if there is none
 
     shared_ptr<ClassProject::ManagerInterface> bdd_manager{};
+    ClassProject::Manager *governed_manager = nullptr; ///< bdd_manager if it supports resource limits and checkpoints
     std::string result_dir; ///< Directory where the results are stored
+    size_t trace_every = 64; ///< Every n-th gate is traced
+    size_t profile_every = 0; ///< The level profile is sampled after every n-th gate
+    VariableOrder variable_order = VariableOrder::Topological;
 
     std::set<ClassProject::BDD_ID> output_nodes;
     std::set<ClassProject::BDD_ID> output_vars;
 
+    std::unordered_map<uint32_t, std::string> aborted_nodes; ///< Circuit nodes exceeding the resource limits and the reason
+
+    /**
+     * \brief Returns the abort reason of the first aborted node in the given set
+     * \param inputNodes are the circuit IDs of the inputs of a gate
+     * \return pointer to the reason, nullptr if none of the nodes was aborted
+     */
+    const std::string *findAborted(IdSpan inputNodes) const;
+
+    /**
+     * \brief Returns the BDD_ID of the output with the given label
+     * \param label is label_t
+     * \return ClassProject::BDD_ID, NoBdd if the label has no BDD and AbortedBdd if it exceeded the resource limits
+     */
+    ClassProject::BDD_ID findOutput(const label_t &label) const;
 
     /**
      * \brief Returns the BDD_ID of the given circuit ID
-     * \param circuit_node is unique_ID_t
+     * \param circuit_node is the circuit ID
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID findBddId(unique_ID_t circuit_node);
+    ClassProject::BDD_ID findBddId(uint32_t circuit_node);
 
     /**
      * \brief Generates the BDD node equivalent to a variable with label "label".
-     * \param label is label_t
+     * \param label of the variable
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID InputGate(const label_t &label);
+    ClassProject::BDD_ID InputGate(std::string_view label);
 
     /**
      * \brief Generates the BDD node equivalent to the NOT gate.
-     * \param node is set_of_circuit_t containing the circuit ID of the gate to be inverted.
+     * \param inputNodes contains the circuit ID of the gate to be inverted.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID NotGate(const set_of_circuit_t &node);
+    ClassProject::BDD_ID NotGate(IdSpan inputNodes);
 
     /**
      * \brief Generates the BDD node equivalent to the AND gate.
-     * \param node is set_of_circuit_t containing the circuit IDs of the gates to be used as input.
+     * \param inputNodes contains the circuit IDs of the gates to be used as input.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID AndGate(set_of_circuit_t inputNodes);
+    ClassProject::BDD_ID AndGate(IdSpan inputNodes);
 
     /**
      * \brief Generates the BDD node equivalent to the OR gate.
-     * \param node is set_of_circuit_t containing the circuit IDs of the gates to be used as input.
+     * \param inputNodes contains the circuit IDs of the gates to be used as input.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID OrGate(set_of_circuit_t inputNodes);
+    ClassProject::BDD_ID OrGate(IdSpan inputNodes);
 
     /**
      * \brief Generates the BDD node equivalent to the NAND gate.
-     * \param node is set_of_circuit_t containing the circuit IDs of the gates to be used as input.
+     * \param inputNodes contains the circuit IDs of the gates to be used as input.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID NandGate(set_of_circuit_t inputNodes);
+    ClassProject::BDD_ID NandGate(IdSpan inputNodes);
 
     /**
      * \brief Generates the BDD node equivalent to the NOR gate.
-     * \param node is set_of_circuit_t containing the circuit IDs of the gates to be used as input.
+     * \param inputNodes contains the circuit IDs of the gates to be used as input.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID NorGate(set_of_circuit_t inputNodes);
+    ClassProject::BDD_ID NorGate(IdSpan inputNodes);
 
     /**
      * \brief Generates the BDD node equivalent to the XOR gate.
-     * \param node is set_of_circuit_t containing the circuit IDs of the gates to be used as input.
+     * \param inputNodes contains the circuit IDs of the gates to be used as input.
      * \return ClassProject::BDD_ID
      *
      */
-    ClassProject::BDD_ID XorGate(set_of_circuit_t inputNodes);
+    ClassProject::BDD_ID XorGate(IdSpan inputNodes);
 
     void dumpBddText(std::ostream &out);
 
@@ -3,45 +3,257 @@
 // Refactored by Deutschmann 28.09.2021
 //
 
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <filesystem>
+#include <thread>
 
 #include "Manager.h"
+#include "Tracer.h"
 #include "BenchParser.hpp"
 #include "CircuitToBDD.hpp"
 #include "BenchmarkLib.h"
 
+static void printUsage(const char *name) {
+    std::cout << "Usage: " << name << " <bench_file>... [options]" << std::endl
+              << "  Several bench files are processed one after another with the same manager." << std::endl
+              << "  --max-nodes <n>      abort outputs exceeding n nodes in the unique table" << std::endl
+              << "  --max-memory <MB>    abort outputs exceeding the estimated memory of the manager" << std::endl
+              << "  --timeout <ms>       abort operations running longer than the given wall-clock time" << std::endl
+              << "  --engine <dfs|bfs>   apply algorithm of the manager (default: dfs)" << std::endl
+              << "  --dump-bin <0|1>     also write all outputs to results_<name>/outputs.bdd (default: 0)" << std::endl
+              << "  --level-profile <0|1>  also write the nodes per level of every output to results_<name>/level_profile.csv (default: 0)" << std::endl
+              << "  --level-profile-sample <n>  sample the level profile of all built gates every n gates (default: 0 = never)" << std::endl
+              << "  --cache-memory <MB>  ceiling of the adaptively sized computed tables (default: 1024)" << std::endl
+              << "  --node-store <dir>   keep the nodes in a file-backed store in dir that can be paged out under memory pressure" << std::endl
+              << "  --mem-sample <ms>    RSS sampling interval during GenerateBDD and PrintBDD, 0 = start/end only (default: 10)" << std::endl
+              << "  --perf <0|1>         read hardware performance counters around the phases (default: 0)" << std::endl
+              << "  --trace <file>       write a Chrome trace-event timeline (chrome://tracing, ui.perfetto.dev)" << std::endl
+              << "  --trace-sample <n>   trace every n-th gate while generating the BDD (default: 64, 0 = none)" << std::endl
+              << "  --snapshot <file>    save a snapshot of the manager with all outputs and time mapping it back" << std::endl
+              << "  --record <file>      record the operations on the manager for VDSProject_replay" << std::endl
+              << "  --parse-threads <n>  threads scanning bench files of several MB, 0 = one per core (default: 1)" << std::endl
+              << "  --var-order <topological|declared>  create the input variables in topological order or in the order of the INPUT lines (default: topological)" << std::endl
+              << "  --netlist-cache <0|1>  load the sorted circuit from <bench_file>.vdsn, written on the first run (default: 0)" << std::endl;
+}
+
 int main(int argc, char *argv[]) {
 
     if (2 > argc) {
         std::cout << "Must specify a filename!" << std::endl;
+        printUsage(argv[0]);
         return -1;
     }
 
-    std::string bench_file = argv[1];
+    std::vector<std::string> bench_files;
+    ClassProject::ResourceLimits limits;
+    ClassProject::ApplyEngine engine = ClassProject::ApplyEngine::DepthFirst;
+    bool dump_bin = false;
+    bool level_profile = false;
+    size_t level_profile_sample = 0;
+    std::string snapshot_file;
+    std::string node_store_dir;
+    ClassProject::CachePolicy cache_policy;
+    std::string trace_file;
+    std::string record_file;
+    bool use_perf = false;
+    int mem_sample_ms = 10;
+    size_t trace_sample = 64;
+    unsigned parse_threads = 1;
+    bool netlist_cache = false;
+    VariableOrder variable_order = VariableOrder::Topological;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.rfind("--", 0) != 0) {
+            bench_files.push_back(option);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (option == "--max-nodes") {
+            limits.maxNodes = std::stoull(value);
+        } else if (option == "--max-memory") {
+            limits.maxMemory = std::stoull(value) * 1024 * 1024;
+        } else if (option == "--timeout") {
+            limits.timeout = std::chrono::milliseconds(std::stoull(value));
+        } else if (option == "--engine" && (value == "dfs" || value == "bfs")) {
+            engine = (value == "bfs") ? ClassProject::ApplyEngine::BreadthFirst : ClassProject::ApplyEngine::DepthFirst;
+        } else if (option == "--dump-bin") {
+            dump_bin = (value == "1");
+        } else if (option == "--level-profile") {
+            level_profile = (value == "1");
+        } else if (option == "--level-profile-sample") {
+            level_profile_sample = std::stoull(value);
+        } else if (option == "--cache-memory") {
+            cache_policy.maxMemory = std::stoull(value) * 1024 * 1024;
+        } else if (option == "--node-store") {
+            node_store_dir = value;
+        } else if (option == "--mem-sample") {
+            mem_sample_ms = std::stoi(value);
+        } else if (option == "--perf") {
+            use_perf = (value == "1");
+        } else if (option == "--trace") {
+            trace_file = value;
+        } else if (option == "--trace-sample") {
+            trace_sample = std::stoull(value);
+        } else if (option == "--snapshot") {
+            snapshot_file = value;
+        } else if (option == "--record") {
+            record_file = value;
+        } else if (option == "--parse-threads") {
+            parse_threads = static_cast<unsigned>(std::stoul(value));
+        } else if (option == "--var-order" && (value == "topological" || value == "declared")) {
+            variable_order = (value == "declared") ? VariableOrder::Declared : VariableOrder::Topological;
+        } else if (option == "--netlist-cache") {
+            netlist_cache = (value == "1");
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (bench_files.empty()) {
+        std::cout << "Must specify a filename!" << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
 
-    /* Parse the circuit from file and generate topological sorted circuit */
-    BenchParser parsed_circuit(bench_file);
+    if (parse_threads == 0) {
+        parse_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (!trace_file.empty()) {
+        ClassProject::Tracer::enable();
+    }
+
+    /* Runtime and memory over time of every circuit go to benchmarking_info.txt */
+    create_benmkng_file("VDSProject_bench");
+
+    if (use_perf && perf_counters_open() == 0) {
+        std::cout << "- Hardware performance counters are not available, continuing without them" << std::endl;
+    }
 
     auto BDD_manager = make_shared<ClassProject::Manager>();
-    auto circuit2BDD = make_unique<CircuitToBDD>(BDD_manager);
+    BDD_manager->setLimits(limits);
+    BDD_manager->setApplyEngine(engine);
+    BDD_manager->setCachePolicy(cache_policy);
+    if (!node_store_dir.empty()) {
+        BDD_manager->setNodeStore(node_store_dir);
+    }
+    if (!record_file.empty()) {
+        BDD_manager->startRecording(record_file);
+    }
 
-    double user_time, vm1, rss1, vm2, rss2;
+    for (const auto &bench_file : bench_files) {
+        /* Reuse the allocated tables of the previous circuit */
+        BDD_manager->clear();
 
-    std::cout << "- Generating BDD from circuit..." << std::flush;
-    // std::cout << "- Generating BDD from circuit..." << std::endl;
-    process_mem_usage(vm1, rss1);
-    user_time = userTime();
-    circuit2BDD->GenerateBDD(parsed_circuit.GetSortedCircuit(), bench_file);
-    user_time = userTime() - user_time;
-    std::cout << " BDD generated successfully!" << std::endl << std::endl;
+        /* Parse the circuit from file and generate topological sorted circuit */
+        BenchParser parsed_circuit(bench_file, parse_threads, netlist_cache);
 
-    circuit2BDD->PrintBDD(parsed_circuit.GetListOfOutputLabels());
+        auto circuit2BDD = make_unique<CircuitToBDD>(BDD_manager);
+        circuit2BDD->SetTraceSampling(trace_sample);
+        circuit2BDD->SetLevelProfileSampling(level_profile_sample);
+        circuit2BDD->SetVariableOrder(variable_order);
 
-    std::cout << "**** Performance ****" << std::endl;
-    std::cout << " Runtime: " << user_time << std::endl;
-    process_mem_usage(vm2, rss2);
-    std::cout << " VM: " << vm2 - vm1 << "; RSS: " << rss2 - rss1 << endl << endl;
+        double user_time, vm1, rss1, vm2, rss2;
+
+        std::cout << "- Generating BDD from circuit..." << std::flush;
+        // std::cout << "- Generating BDD from circuit..." << std::endl;
+        process_mem_usage(vm1, rss1);
+        start_memory_sampler(mem_sample_ms);
+        perf_sample_t perf_begin = perf_counters_read();
+        user_time = userTime();
+        circuit2BDD->GenerateBDD(parsed_circuit.GetSortedCircuit(), bench_file);
+        user_time = userTime() - user_time;
+        perf_sample_t perf_generate = perf_counters_diff(perf_counters_read(), perf_begin);
+        std::cout << " BDD generated successfully!" << std::endl << std::endl;
+
+        ClassProject::ManagerStats stats = BDD_manager->stats();
+        std::cout << "**** Statistics ****" << std::endl;
+        stats.writeJson(std::cout);
+        std::cout << std::endl << std::endl;
+
+        std::cout << "**** Memory ****" << std::endl;
+        BDD_manager->memoryBreakdown().writeJson(std::cout);
+        std::cout << std::endl << std::endl;
+
+        perf_begin = perf_counters_read();
+        circuit2BDD->PrintBDD(parsed_circuit.GetListOfOutputLabels());
+        perf_sample_t perf_print = perf_counters_diff(perf_counters_read(), perf_begin);
+        stop_memory_sampler();
+
+        if (dump_bin) {
+            double bin_time = userTime();
+            std::string bin_file = circuit2BDD->WriteBinary(parsed_circuit.GetListOfOutputLabels());
+            bin_time = userTime() - bin_time;
+            std::cout << "- Binary BDD written to " << bin_file << " in " << bin_time << "s" << std::endl << std::endl;
+        }
+
+        if (level_profile) {
+            std::string profile_file = circuit2BDD->WriteLevelProfile(parsed_circuit.GetListOfOutputLabels());
+            std::cout << "- Level profile written to " << profile_file << std::endl << std::endl;
+        }
+
+        if (!snapshot_file.empty()) {
+            auto outputs = circuit2BDD->GetOutputs(parsed_circuit.GetListOfOutputLabels());
+            double save_time = userTime();
+            BDD_manager->saveSnapshot(snapshot_file, outputs);
+            save_time = userTime() - save_time;
+
+            /* A warm start: map the snapshot and touch every node of the outputs */
+            auto map_time = std::chrono::steady_clock::now();
+            std::vector<std::pair<std::string, ClassProject::BDD_ID>> roots;
+            ClassProject::Manager mapped = ClassProject::Manager::mapSnapshot(snapshot_file, &roots);
+            double mapped_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - map_time).count();
+            std::set<ClassProject::BDD_ID> nodes;
+            for (const auto &root : roots) {
+                mapped.findNodes(root.second, nodes);
+            }
+            double touched_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - map_time).count();
+            std::cout << "- Snapshot " << snapshot_file << ": " << std::filesystem::file_size(snapshot_file) / 1024 << " KB, saved in "
+                      << save_time << "s, mapped in " << mapped_time << "s, " << nodes.size() << " output nodes read in "
+                      << touched_time << "s" << std::endl << std::endl;
+        }
+
+        std::cout << "**** Performance ****" << std::endl;
+        std::cout << " Runtime: " << user_time << std::endl;
+        process_mem_usage(vm2, rss2);
+        std::cout << " VM: " << vm2 - vm1 << "; RSS: " << rss2 - rss1 << endl;
+        std::cout << " Peak RSS: " << get_mem_peak() / 1024 << " KB at " << get_mem_peak_time() << "s; VmHWM: "
+                  << get_mem_hwm() / 1024 << " KB" << endl;
+        write_benmkng_time(bench_file, user_time);
+        write_benmkng_newline();
+        write_benmkng_memory_series();
+        if (use_perf) {
+            /* Misses are reported per ite call that was not a terminal case */
+            perf_counters_print(std::cout, "GenerateBDD", perf_generate, (long long)stats.iteCalls);
+            perf_counters_print(std::cout, "PrintBDD", perf_print, 0);
+        }
+        std::cout << endl;
+    }
+
+    if (!record_file.empty()) {
+        size_t records = BDD_manager->stopRecording();
+        std::cout << "- " << records << " operations recorded to " << record_file << " ("
+                  << std::filesystem::file_size(record_file) / 1024 << " KB)" << std::endl;
+    }
+
+    if (!trace_file.empty()) {
+        ClassProject::Tracer::disable();
+        std::ofstream trace_out(trace_file);
+        ClassProject::Tracer::write(trace_out);
+        std::cout << "- Trace written to " << trace_file << std::endl;
+    }
+    perf_counters_close();
+    close_benmkng_file();
 
     return 0;
 }
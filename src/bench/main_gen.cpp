@@ -0,0 +1,139 @@
+//
+// Generates parameterized circuits for scaling studies, as bench files or built into BDDs directly
+//
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "Manager.h"
+#include "CircuitGenerator.hpp"
+
+static void printUsage(const char *name) {
+    std::cout << "Usage: " << name << " <family> <n> [options]" << std::endl
+              << "  Families: adder, comparator, multiplier (n bits), parity (n inputs), mux (n select bits)," << std::endl
+              << "            queens (n x n board), cnf (n variables)" << std::endl
+              << "  Without --bench the BDDs are built directly and one CSV line is printed per size." << std::endl
+              << "  --to <n>             last size of a sweep (default: the first size)" << std::endl
+              << "  --step <n>           step of a sweep (default: 1)" << std::endl
+              << "  --order <good|bad|random>  variable order (default: good)" << std::endl
+              << "  --seed <n>           seed of random orders and random CNFs (default: 1)" << std::endl
+              << "  --clauses <n>        clauses of a random CNF (default: 4.26 n)" << std::endl
+              << "  --k <n>              literals per clause of a random CNF (default: 3)" << std::endl
+              << "  --bench <dir>        write <family>_<n>_<order>.bench files to dir instead of building," << std::endl
+              << "                       run them with VDSProject_bench --var-order declared to keep the order" << std::endl
+              << "  --max-nodes <n>      stop the sweep at the first size exceeding n nodes" << std::endl
+              << "  --timeout <ms>       stop the sweep at the first size exceeding the wall-clock time" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (3 > argc) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::string family = argv[1];
+    unsigned first = static_cast<unsigned>(std::stoul(argv[2]));
+    unsigned last = first;
+    unsigned step = 1;
+    InputOrder order = InputOrder::Good;
+    uint32_t seed = 1;
+    unsigned clauses = 0;
+    unsigned k = 3;
+    std::string bench_dir;
+    ClassProject::ResourceLimits limits;
+    for (int i = 3; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (option == "--to") {
+            last = static_cast<unsigned>(std::stoul(value));
+        } else if (option == "--step") {
+            step = std::max(1u, static_cast<unsigned>(std::stoul(value)));
+        } else if (option == "--order" && (value == "good" || value == "bad" || value == "random")) {
+            order = value == "good" ? InputOrder::Good : value == "bad" ? InputOrder::Bad : InputOrder::Random;
+        } else if (option == "--seed") {
+            seed = static_cast<uint32_t>(std::stoul(value));
+        } else if (option == "--clauses") {
+            clauses = static_cast<unsigned>(std::stoul(value));
+        } else if (option == "--k") {
+            k = static_cast<unsigned>(std::stoul(value));
+        } else if (option == "--bench") {
+            bench_dir = value;
+        } else if (option == "--max-nodes") {
+            limits.maxNodes = std::stoull(value);
+        } else if (option == "--timeout") {
+            limits.timeout = std::chrono::milliseconds(std::stoull(value));
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    auto generate = [&](unsigned n) {
+        if (family == "adder") {
+            return CircuitGenerator::Adder(n, order, seed);
+        } else if (family == "comparator") {
+            return CircuitGenerator::Comparator(n, order, seed);
+        } else if (family == "multiplier") {
+            return CircuitGenerator::Multiplier(n, order, seed);
+        } else if (family == "parity") {
+            return CircuitGenerator::Parity(n, order, seed);
+        } else if (family == "mux") {
+            return CircuitGenerator::Multiplexer(n, order, seed);
+        } else if (family == "queens") {
+            return CircuitGenerator::Queens(n, order, seed);
+        } else if (family == "cnf") {
+            return CircuitGenerator::RandomCnf(n, clauses ? clauses : (426 * n + 50) / 100, k, order, seed);
+        }
+        throw std::invalid_argument("unknown family " + family);
+    };
+
+    if (!bench_dir.empty()) {
+        std::filesystem::create_directories(bench_dir);
+    } else {
+        std::cout << "family,n,order,inputs,gates,nodes,output_nodes,seconds,status" << std::endl;
+    }
+
+    for (unsigned n = first; n <= last; n += step) {
+        Netlist netlist = generate(n);
+        if (!bench_dir.empty()) {
+            std::string file = bench_dir + "/" + netlist.Name() + ".bench";
+            std::ofstream out(file);
+            netlist.WriteBench(out);
+            std::cout << "- " << file << ": " << netlist.Inputs().size() << " inputs, " << netlist.Gates().size() << " gates"
+                      << std::endl;
+            continue;
+        }
+
+        ClassProject::Manager manager;
+        manager.setLimits(limits);
+        std::string status = "ok";
+        std::set<ClassProject::BDD_ID> output_nodes;
+        auto start = std::chrono::steady_clock::now();
+        try {
+            for (const auto &output : netlist.Build(manager)) {
+                manager.findNodes(output.second, output_nodes);
+            }
+        } catch (const ClassProject::BudgetExceeded &e) {
+            status = "budget";
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << family << "," << n << "," << (order == InputOrder::Good ? "good" : order == InputOrder::Bad ? "bad" : "random")
+                  << "," << netlist.Inputs().size() << "," << netlist.Gates().size() << "," << manager.uniqueTableSize() << ","
+                  << output_nodes.size() << "," << seconds << "," << status << std::endl;
+        /* Larger sizes would exceed the limits as well */
+        if (status != "ok") {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+//
+// Replays an operation log recorded with VDSProject_bench --record on a freshly configured manager
+//
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "Manager.h"
+#include "BenchmarkLib.h"
+
+static void printUsage(const char *name) {
+    std::cout << "Usage: " << name << " <log_file> [options]" << std::endl
+              << "  The same log gives the same checksum with every configuration of the manager." << std::endl
+              << "  --engine <dfs|bfs>   apply algorithm of the manager (default: dfs)" << std::endl
+              << "  --cache-memory <MB>  ceiling of the adaptively sized computed tables (default: 1024)" << std::endl
+              << "  --node-store <dir>   keep the nodes in a file-backed store in dir" << std::endl
+              << "  --max-memory <MB>    abort the replay when the estimated memory of the manager exceeds it" << std::endl
+              << "  --mem-sample <ms>    RSS sampling interval during the replay (default: 10)" << std::endl
+              << "  --checksum <0|1>     hash the result of every operation (default: 1)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (2 > argc) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::string log_file = argv[1];
+    ClassProject::ResourceLimits limits;
+    ClassProject::ApplyEngine engine = ClassProject::ApplyEngine::DepthFirst;
+    ClassProject::CachePolicy cache_policy;
+    std::string node_store_dir;
+    int mem_sample_ms = 10;
+    bool checksum = true;
+    for (int i = 2; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (option == "--engine" && (value == "dfs" || value == "bfs")) {
+            engine = (value == "bfs") ? ClassProject::ApplyEngine::BreadthFirst : ClassProject::ApplyEngine::DepthFirst;
+        } else if (option == "--cache-memory") {
+            cache_policy.maxMemory = std::stoull(value) * 1024 * 1024;
+        } else if (option == "--node-store") {
+            node_store_dir = value;
+        } else if (option == "--max-memory") {
+            limits.maxMemory = std::stoull(value) * 1024 * 1024;
+        } else if (option == "--mem-sample") {
+            mem_sample_ms = std::stoi(value);
+        } else if (option == "--checksum") {
+            checksum = (value == "1");
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    ClassProject::Manager manager;
+    manager.setLimits(limits);
+    manager.setApplyEngine(engine);
+    manager.setCachePolicy(cache_policy);
+    if (!node_store_dir.empty()) {
+        manager.setNodeStore(node_store_dir);
+    }
+
+    ClassProject::ReplayResult result;
+    start_memory_sampler(mem_sample_ms);
+    try {
+        result = ClassProject::OperationReplayer::replay(log_file, manager, checksum);
+    } catch (const ClassProject::BudgetExceeded &e) {
+        stop_memory_sampler();
+        std::cout << "- Replay aborted: " << e.what() << std::endl;
+        return 1;
+    }
+    stop_memory_sampler();
+
+    std::cout << "- Replayed " << log_file << " (" << std::filesystem::file_size(log_file) / 1024 << " KB)" << std::endl
+              << " Operations: " << result.operations << std::endl
+              << " Runtime: " << result.seconds << "s" << std::endl
+              << " Nodes: " << manager.uniqueTableSize() << std::endl
+              << " Estimated memory: " << manager.memoryBreakdown().total() / 1024 << " KB" << std::endl
+              << " Peak RSS: " << get_mem_peak() / 1024 << " KB" << std::endl;
+    if (checksum) {
+        std::cout << " Checksum: " << std::hex << result.checksum << std::dec << std::endl;
+    }
+
+    return 0;
+}
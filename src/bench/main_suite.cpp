@@ -0,0 +1,463 @@
+//
+// Runs a whole benchmark suite and compares result files
+//
+// Every circuit runs in a child process of its own, so a circuit that runs out of time or memory is killed
+// without taking the suite down, and the peak RSS reported by the kernel belongs to that circuit alone.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Manager.h"
+#include "BenchParser.hpp"
+#include "CircuitToBDD.hpp"
+
+static void printUsage(const char *name) {
+    std::cout << "Usage: " << name << " <bench_file|directory>... [options]" << std::endl
+              << "  Runs every circuit in a child process, directories are searched for .bench files." << std::endl
+              << "  --out <prefix>       write the results to <prefix>.json and <prefix>.csv (default: suite_results)" << std::endl
+              << "  --time-limit <s>     kill circuits running longer, reported as timeout (default: 600)" << std::endl
+              << "  --max-nodes <n>      abort gates exceeding n nodes in the unique table" << std::endl
+              << "  --max-memory <MB>    abort gates exceeding the estimated memory of the manager" << std::endl
+              << "  --engine <dfs|bfs>   apply algorithm of the manager (default: dfs)" << std::endl
+              << "  --repeat <n>         run every circuit n times and keep the fastest run (default: 1)" << std::endl
+              << "Usage: " << name << " --compare <old.csv> <new.csv> [--threshold <percent>]" << std::endl
+              << "  Flags circuits whose generate time, peak RSS or node count grew by more than the threshold" << std::endl
+              << "  (default: 10) or that no longer finish. Exits with 1 if there are regressions." << std::endl;
+}
+
+struct SuiteOptions {
+    std::string out = "suite_results";
+    double time_limit = 600;
+    ClassProject::ResourceLimits limits;
+    ClassProject::ApplyEngine engine = ClassProject::ApplyEngine::DepthFirst;
+    unsigned repeat = 1;
+};
+
+struct CircuitResult {
+    std::string name;
+    std::string status = "ok"; // ok, budget (gates aborted by the limits), timeout, crashed, failed
+    std::string error;
+    double parse_s = 0;
+    double generate_s = 0;
+    double wall_s = 0;
+    long long peak_rss_kb = 0;
+    size_t nodes = 0;
+    size_t peak_nodes = 0;
+    size_t aborted_gates = 0;
+    size_t ite_calls = 0;
+    size_t ite_cache_hits = 0;
+    size_t ite_cache_misses = 0;
+    size_t unique_lookups = 0;
+    size_t unique_hits = 0;
+    std::string stats_json;
+
+    double iteCacheHitRate() const {
+        size_t lookups = ite_cache_hits + ite_cache_misses;
+        return lookups ? double(ite_cache_hits) / double(lookups) : 0;
+    }
+};
+
+static const char *CsvHeader = "name,status,parse_s,generate_s,wall_s,peak_rss_kb,nodes,peak_nodes,aborted_gates,"
+                               "ite_calls,ite_cache_hit_rate,unique_lookups,unique_hits";
+
+/* Runs in the child: builds the circuit and writes one "key value" line per measurement to fd */
+[[noreturn]] static void runCircuit(const std::string &bench_file, const SuiteOptions &options, int fd) {
+    std::ostringstream report;
+    int exit_code = 0;
+    try {
+        auto manager = std::make_shared<ClassProject::Manager>();
+        manager->setLimits(options.limits);
+        manager->setApplyEngine(options.engine);
+
+        auto start = std::chrono::steady_clock::now();
+        BenchParser parsed_circuit(bench_file);
+        auto parsed = std::chrono::steady_clock::now();
+        CircuitToBDD circuit2BDD(manager);
+        circuit2BDD.GenerateBDD(parsed_circuit.GetSortedCircuit(), bench_file);
+        auto generated = std::chrono::steady_clock::now();
+
+        ClassProject::ManagerStats stats = manager->stats();
+        report << "parse_s " << std::chrono::duration<double>(parsed - start).count() << "\n"
+               << "generate_s " << std::chrono::duration<double>(generated - parsed).count() << "\n"
+               << "nodes " << stats.nodes << "\n"
+               << "peak_nodes " << stats.peakNodes << "\n"
+               << "aborted_gates " << circuit2BDD.GetAbortedCount() << "\n"
+               << "ite_calls " << stats.iteCalls << "\n"
+               << "ite_cache_hits " << stats.iteCacheHits << "\n"
+               << "ite_cache_misses " << stats.iteCacheMisses << "\n"
+               << "unique_lookups " << stats.uniqueLookups << "\n"
+               << "unique_hits " << stats.uniqueHits << "\n"
+               << "stats ";
+        stats.writeJson(report);
+        report << "\n";
+    } catch (const std::exception &e) {
+        report << "error " << e.what() << "\n";
+        exit_code = 2;
+    }
+    std::string text = report.str();
+    for (size_t written = 0; written < text.size();) {
+        ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    /* The manager is not torn down, the parent has all it needs */
+    _exit(exit_code);
+}
+
+static void parseReport(const std::string &text, CircuitResult &result) {
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, space);
+        std::string value = line.substr(space + 1);
+        if (key == "error") {
+            result.error = value;
+        } else if (key == "stats") {
+            result.stats_json = value;
+        } else if (key == "parse_s") {
+            result.parse_s = std::stod(value);
+        } else if (key == "generate_s") {
+            result.generate_s = std::stod(value);
+        } else if (key == "nodes") {
+            result.nodes = std::stoull(value);
+        } else if (key == "peak_nodes") {
+            result.peak_nodes = std::stoull(value);
+        } else if (key == "aborted_gates") {
+            result.aborted_gates = std::stoull(value);
+        } else if (key == "ite_calls") {
+            result.ite_calls = std::stoull(value);
+        } else if (key == "ite_cache_hits") {
+            result.ite_cache_hits = std::stoull(value);
+        } else if (key == "ite_cache_misses") {
+            result.ite_cache_misses = std::stoull(value);
+        } else if (key == "unique_lookups") {
+            result.unique_lookups = std::stoull(value);
+        } else if (key == "unique_hits") {
+            result.unique_hits = std::stoull(value);
+        }
+    }
+}
+
+static CircuitResult runChild(const std::string &bench_file, const SuiteOptions &options) {
+    CircuitResult result;
+    result.name = std::filesystem::path(bench_file).stem().string();
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("VDSProject_suite: unable to create a pipe");
+    }
+    std::cout << std::flush;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("VDSProject_suite: unable to fork");
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        /* The messages of the parser and the BDD generation are not part of the results */
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+        runCircuit(bench_file, options, fds[1]);
+    }
+    close(fds[1]);
+
+    /* Poll for the exit of the child, kill it when it exceeds the time limit */
+    int status = 0;
+    struct rusage usage {};
+    bool timed_out = false;
+    while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > options.time_limit) {
+            kill(pid, SIGKILL);
+            wait4(pid, &status, 0, &usage);
+            timed_out = true;
+            break;
+        }
+        usleep(2000);
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peak_rss_kb = usage.ru_maxrss;
+
+    std::string text;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+    parseReport(text, result);
+
+    if (timed_out) {
+        result.status = "timeout";
+    } else if (WIFSIGNALED(status)) {
+        result.status = "crashed";
+        result.error = strsignal(WTERMSIG(status));
+    } else if (WEXITSTATUS(status) != 0) {
+        result.status = "failed";
+    } else if (result.aborted_gates > 0) {
+        result.status = "budget";
+    }
+    return result;
+}
+
+static std::vector<std::string> collectBenchFiles(const std::vector<std::string> &paths) {
+    std::vector<std::string> files;
+    for (const auto &path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto &entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".bench") {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+static void writeJsonString(std::ostream &out, const std::string &str) {
+    out << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static void writeResults(const std::string &prefix, const SuiteOptions &options, const std::vector<CircuitResult> &results) {
+    std::ofstream json(prefix + ".json");
+    json << "{\"time_limit\": " << options.time_limit << ", \"max_nodes\": " << options.limits.maxNodes
+         << ", \"max_memory\": " << options.limits.maxMemory << ", \"repeat\": " << options.repeat
+         << ", \"engine\": \"" << (options.engine == ClassProject::ApplyEngine::BreadthFirst ? "bfs" : "dfs")
+         << "\", \"circuits\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const CircuitResult &r = results[i];
+        json << (i ? ",\n" : "\n") << "{\"name\": ";
+        writeJsonString(json, r.name);
+        json << ", \"status\": \"" << r.status << "\"";
+        if (!r.error.empty()) {
+            json << ", \"error\": ";
+            writeJsonString(json, r.error);
+        }
+        json << ", \"parse_s\": " << r.parse_s << ", \"generate_s\": " << r.generate_s << ", \"wall_s\": " << r.wall_s
+             << ", \"peak_rss_kb\": " << r.peak_rss_kb << ", \"nodes\": " << r.nodes << ", \"peak_nodes\": " << r.peak_nodes
+             << ", \"aborted_gates\": " << r.aborted_gates << ", \"ite_cache_hit_rate\": " << r.iteCacheHitRate()
+             << ", \"stats\": " << (r.stats_json.empty() ? "null" : r.stats_json) << "}";
+    }
+    json << "\n]}\n";
+
+    std::ofstream csv(prefix + ".csv");
+    csv << CsvHeader << "\n";
+    for (const auto &r : results) {
+        csv << r.name << "," << r.status << "," << r.parse_s << "," << r.generate_s << "," << r.wall_s << ","
+            << r.peak_rss_kb << "," << r.nodes << "," << r.peak_nodes << "," << r.aborted_gates << "," << r.ite_calls << ","
+            << r.iteCacheHitRate() << "," << r.unique_lookups << "," << r.unique_hits << "\n";
+    }
+}
+
+/* Circuit name -> column -> value of a result CSV */
+static std::map<std::string, std::map<std::string, std::string>> readResults(const std::string &file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("VDSProject_suite: unable to read " + file);
+    }
+    auto split = [](const std::string &line) {
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, ',')) {
+            fields.push_back(field);
+        }
+        return fields;
+    };
+    std::string line;
+    std::getline(in, line);
+    std::vector<std::string> header = split(line);
+    std::map<std::string, std::map<std::string, std::string>> rows;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields = split(line);
+        if (fields.size() != header.size()) {
+            continue;
+        }
+        auto &row = rows[fields[0]];
+        for (size_t i = 0; i < fields.size(); i++) {
+            row[header[i]] = fields[i];
+        }
+    }
+    return rows;
+}
+
+static int compareResults(const std::string &old_file, const std::string &new_file, double threshold) {
+    auto old_rows = readResults(old_file);
+    auto new_rows = readResults(new_file);
+
+    /* Differences up to the noise floor are not reported: short runs and the RSS of the process image jitter */
+    struct Metric {
+        const char *column;
+        double noise_floor; // absolute
+    };
+    const Metric metrics[] = {{"generate_s", 0.05}, {"peak_rss_kb", 16 * 1024}, {"nodes", 0}};
+
+    size_t regressions = 0;
+    std::cout << std::left << std::setw(12) << "circuit" << std::setw(14) << "metric" << std::right << std::setw(14) << "old"
+              << std::setw(14) << "new" << std::setw(10) << "change" << std::endl;
+    for (const auto &new_row : new_rows) {
+        const std::string &name = new_row.first;
+        auto old_it = old_rows.find(name);
+        if (old_it == old_rows.end()) {
+            std::cout << std::left << std::setw(12) << name << "new circuit" << std::endl;
+            continue;
+        }
+        const auto &before = old_it->second;
+        const auto &after = new_row.second;
+        if (before.at("status") != after.at("status")) {
+            bool worse = before.at("status") == "ok";
+            regressions += worse;
+            std::cout << std::left << std::setw(12) << name << std::setw(14) << "status" << std::right << std::setw(14)
+                      << before.at("status") << std::setw(14) << after.at("status") << std::setw(10) << ""
+                      << (worse ? "  REGRESSION" : "") << std::endl;
+            continue;
+        }
+        for (const auto &metric : metrics) {
+            double old_value = std::stod(before.at(metric.column));
+            double new_value = std::stod(after.at(metric.column));
+            if (std::fabs(new_value - old_value) <= metric.noise_floor) {
+                continue;
+            }
+            double change = old_value > 0 ? (new_value - old_value) / old_value * 100.0 : 100.0;
+            bool regression = change > threshold;
+            regressions += regression;
+            std::cout << std::left << std::setw(12) << name << std::setw(14) << metric.column << std::right << std::setw(14)
+                      << old_value << std::setw(14) << new_value << std::setw(9) << std::fixed << std::setprecision(1)
+                      << change << "%" << std::defaultfloat << std::setprecision(6) << (regression ? "  REGRESSION" : "")
+                      << std::endl;
+        }
+    }
+    for (const auto &old_row : old_rows) {
+        if (new_rows.find(old_row.first) == new_rows.end()) {
+            std::cout << std::left << std::setw(12) << old_row.first << "missing in " << new_file << std::endl;
+        }
+    }
+    std::cout << regressions << " regression(s) above " << threshold << "%" << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (2 > argc) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::vector<std::string> paths;
+    SuiteOptions options;
+    std::vector<std::string> compare_files;
+    double threshold = 10;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.rfind("--", 0) != 0) {
+            paths.push_back(option);
+            continue;
+        }
+        if (option == "--compare") {
+            if (i + 2 >= argc) {
+                printUsage(argv[0]);
+                return -1;
+            }
+            compare_files = {argv[i + 1], argv[i + 2]};
+            i += 2;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (option == "--out") {
+            options.out = value;
+        } else if (option == "--time-limit") {
+            options.time_limit = std::stod(value);
+        } else if (option == "--max-nodes") {
+            options.limits.maxNodes = std::stoull(value);
+        } else if (option == "--max-memory") {
+            options.limits.maxMemory = std::stoull(value) * 1024 * 1024;
+        } else if (option == "--engine" && (value == "dfs" || value == "bfs")) {
+            options.engine = (value == "bfs") ? ClassProject::ApplyEngine::BreadthFirst : ClassProject::ApplyEngine::DepthFirst;
+        } else if (option == "--repeat") {
+            options.repeat = std::max(1, std::stoi(value));
+        } else if (option == "--threshold") {
+            threshold = std::stod(value);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!compare_files.empty()) {
+        return compareResults(compare_files[0], compare_files[1], threshold);
+    }
+
+    std::vector<std::string> bench_files = collectBenchFiles(paths);
+    if (bench_files.empty()) {
+        std::cout << "No bench files found!" << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::vector<CircuitResult> results;
+    for (const auto &bench_file : bench_files) {
+        CircuitResult best;
+        for (unsigned run = 0; run < options.repeat; run++) {
+            CircuitResult result = runChild(bench_file, options);
+            if (run == 0 || result.status != "ok" || result.generate_s < best.generate_s) {
+                best = result;
+            }
+            /* Circuits that do not finish are not run again */
+            if (result.status != "ok") {
+                break;
+            }
+        }
+        std::cout << std::left << std::setw(12) << best.name << std::setw(9) << best.status << std::right
+                  << " generate " << std::setw(10) << best.generate_s << "s  peak RSS " << std::setw(9) << best.peak_rss_kb
+                  << " KB  nodes " << std::setw(10) << best.nodes << "  ite cache hits " << std::setw(8)
+                  << best.iteCacheHitRate() << (best.error.empty() ? "" : "  " + best.error) << std::endl;
+        results.push_back(best);
+        /* Written after every circuit, a suite that is interrupted keeps the finished circuits */
+        writeResults(options.out, options, results);
+    }
+    std::cout << "- Results written to " << options.out << ".json and " << options.out << ".csv" << std::endl;
+
+    return 0;
+}
@@ -1,3 +1,8 @@
 // if CLASSPROJECT_USECACHE is defined as 1, the cache will be used for the ite, coFactorTrue and coFactorFalse functions
 #define CLASSPROJECT_USECACHE 1
 #define CLASSPROJECT_VISUALIZE_FUNCTIONS 0
+// if CLASSPROJECT_STATS is defined as 1, the manager counts operations, cache hits and unique table lookups (see Manager::stats())
+// CMake sets it for all targets linking Manager through the CLASSPROJECT_STATS option, the default is for builds without CMake
+#ifndef CLASSPROJECT_STATS
+#define CLASSPROJECT_STATS 1
+#endif
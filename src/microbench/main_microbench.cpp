@@ -0,0 +1,303 @@
+// Microbenchmarks of the Manager primitives
+//
+// Every benchmark is parameterized by a problem size: the number of variables of random functions and chains,
+// the width of adders and multipliers. Times are per operation, the counters report created nodes per second.
+// Results of two commits are compared with the tools of Google Benchmark:
+//   VDSProject_microbench --benchmark_out=old.json --benchmark_out_format=json
+//   VDSProject_microbench --benchmark_out=new.json --benchmark_out_format=json
+//   compare.py benchmarks old.json new.json
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Manager.h"
+
+using namespace ClassProject;
+
+namespace {
+
+// Exposes the unique table, which is not part of the public interface
+class ProbeManager : public Manager {
+public:
+    using Manager::makeNode;
+};
+
+std::vector<BDD_ID> createVars(Manager &mgr, size_t count, const std::string &prefix = "x") {
+    std::vector<BDD_ID> vars;
+    for (size_t i = 0; i < count; i++) {
+        vars.push_back(mgr.createVar(prefix + std::to_string(i)));
+    }
+    return vars;
+}
+
+// Random function over the given variables: a pool starting with the variables that grows by ite of three random members.
+// The seed is fixed, so every run builds the same functions.
+BDD_ID randomFunction(Manager &mgr, const std::vector<BDD_ID> &vars, size_t operations, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    std::vector<BDD_ID> pool(vars);
+    for (size_t i = 0; i < operations; i++) {
+        std::uniform_int_distribution<size_t> pick(0, pool.size() - 1);
+        pool.push_back(mgr.ite(pool[pick(rng)], pool[pick(rng)], mgr.neg(pool[pick(rng)])));
+    }
+    return pool.back();
+}
+
+// Ripple-carry adder with interleaved operand bits, linear in the width
+std::vector<BDD_ID> adder(Manager &mgr, size_t width) {
+    std::vector<BDD_ID> a, b;
+    for (size_t i = 0; i < width; i++) {
+        a.push_back(mgr.createVar("a" + std::to_string(i)));
+        b.push_back(mgr.createVar("b" + std::to_string(i)));
+    }
+    std::vector<BDD_ID> outputs;
+    BDD_ID carry = mgr.False();
+    for (size_t i = 0; i < width; i++) {
+        BDD_ID half = mgr.xor2(a[i], b[i]);
+        outputs.push_back(mgr.xor2(half, carry));
+        carry = mgr.or2(mgr.and2(a[i], b[i]), mgr.and2(half, carry));
+    }
+    outputs.push_back(carry);
+    return outputs;
+}
+
+// Array multiplier, exponential in the width for every variable order
+std::vector<BDD_ID> multiplier(Manager &mgr, size_t width) {
+    std::vector<BDD_ID> a = createVars(mgr, width, "a");
+    std::vector<BDD_ID> b = createVars(mgr, width, "b");
+    std::vector<BDD_ID> product(2 * width, mgr.False());
+    for (size_t i = 0; i < width; i++) {
+        BDD_ID carry = mgr.False();
+        for (size_t j = 0; j < width; j++) {
+            BDD_ID bit = mgr.and2(a[j], b[i]);
+            BDD_ID &sum = product[i + j];
+            BDD_ID half = mgr.xor2(sum, bit);
+            BDD_ID nextCarry = mgr.or2(mgr.and2(sum, bit), mgr.and2(half, carry));
+            sum = mgr.xor2(half, carry);
+            carry = nextCarry;
+        }
+        product[i + width] = carry;
+    }
+    return product;
+}
+
+void setNodeCounters(benchmark::State &state, size_t nodes) {
+    state.counters["nodes"] = static_cast<double>(nodes);
+    state.counters["nodes/s"] = benchmark::Counter(static_cast<double>(nodes) * static_cast<double>(state.iterations()),
+                                                   benchmark::Counter::kIsRate);
+}
+
+// Benchmarks that build in a fresh manager per iteration. The previous manager is destroyed and the next one is set up
+// while the timer is paused.
+
+void BM_createVar(benchmark::State &state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    std::vector<std::string> labels;
+    for (size_t i = 0; i < count; i++) {
+        labels.push_back("x" + std::to_string(i));
+    }
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        state.ResumeTiming();
+        for (const auto &label : labels) {
+            benchmark::DoNotOptimize(mgr->createVar(label));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_createVar)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+void BM_and2Chain(benchmark::State &state) {
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        std::vector<BDD_ID> vars = createVars(*mgr, static_cast<size_t>(state.range(0)));
+        size_t before = mgr->uniqueTableSize();
+        state.ResumeTiming();
+        BDD_ID f = mgr->True();
+        for (auto var = vars.rbegin(); var != vars.rend(); ++var) {
+            f = mgr->and2(*var, f);
+        }
+        benchmark::DoNotOptimize(f);
+        nodes = mgr->uniqueTableSize() - before;
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_and2Chain)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+void BM_xor2Chain(benchmark::State &state) {
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        std::vector<BDD_ID> vars = createVars(*mgr, static_cast<size_t>(state.range(0)));
+        size_t before = mgr->uniqueTableSize();
+        state.ResumeTiming();
+        BDD_ID f = mgr->False();
+        for (auto var = vars.rbegin(); var != vars.rend(); ++var) {
+            f = mgr->xor2(*var, f);
+        }
+        benchmark::DoNotOptimize(f);
+        nodes = mgr->uniqueTableSize() - before;
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_xor2Chain)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+// Random ite over N variables, 8 N operations
+void BM_iteRandom(benchmark::State &state) {
+    const size_t operations = 8 * static_cast<size_t>(state.range(0));
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        std::vector<BDD_ID> vars = createVars(*mgr, static_cast<size_t>(state.range(0)));
+        size_t before = mgr->uniqueTableSize();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(randomFunction(*mgr, vars, operations));
+        nodes = mgr->uniqueTableSize() - before;
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(operations));
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_iteRandom)->DenseRange(8, 20, 4);
+
+void BM_adder(benchmark::State &state) {
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(adder(*mgr, static_cast<size_t>(state.range(0))).back());
+        nodes = mgr->uniqueTableSize();
+    }
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_adder)->RangeMultiplier(4)->Range(8, 512);
+
+void BM_multiplier(benchmark::State &state) {
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(multiplier(*mgr, static_cast<size_t>(state.range(0))).back());
+        nodes = mgr->uniqueTableSize();
+    }
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_multiplier)->DenseRange(4, 10, 2)->Unit(benchmark::kMillisecond);
+
+// Benchmarks of single operations on a prebuilt random function. The manager is copied before every iteration,
+// so the operation is not answered by the result of the previous iteration. The copy gets room for new nodes,
+// otherwise the first insertion would time a rehash of the whole unique table.
+
+void BM_neg(benchmark::State &state) {
+    Manager prototype;
+    std::vector<BDD_ID> vars = createVars(prototype, static_cast<size_t>(state.range(0)));
+    BDD_ID f = randomFunction(prototype, vars, 8 * vars.size());
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>(prototype);
+        mgr->reserve(2 * prototype.uniqueTableSize(), 0);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(mgr->neg(f));
+        nodes = mgr->uniqueTableSize() - prototype.uniqueTableSize();
+    }
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_neg)->DenseRange(8, 20, 4);
+
+void BM_coFactorTrue(benchmark::State &state) {
+    Manager prototype;
+    std::vector<BDD_ID> vars = createVars(prototype, static_cast<size_t>(state.range(0)));
+    BDD_ID f = randomFunction(prototype, vars, 8 * vars.size());
+    // Cofactor by a variable in the middle of the order, so the result is rebuilt above it
+    BDD_ID x = vars[vars.size() / 2];
+    size_t nodes = 0;
+    std::unique_ptr<Manager> mgr;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mgr = std::make_unique<Manager>(prototype);
+        mgr->reserve(2 * prototype.uniqueTableSize(), 0);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(mgr->coFactorTrue(f, x));
+        nodes = mgr->uniqueTableSize() - prototype.uniqueTableSize();
+    }
+    setNodeCounters(state, nodes);
+}
+BENCHMARK(BM_coFactorTrue)->DenseRange(8, 20, 4);
+
+void BM_findNodes(benchmark::State &state) {
+    Manager mgr;
+    std::vector<BDD_ID> vars = createVars(mgr, static_cast<size_t>(state.range(0)));
+    BDD_ID f = randomFunction(mgr, vars, 8 * vars.size());
+    size_t nodes = 0;
+    for (auto _ : state) {
+        std::set<BDD_ID> found;
+        mgr.findNodes(f, found);
+        nodes = found.size();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(nodes));
+    state.counters["nodes"] = static_cast<double>(nodes);
+}
+BENCHMARK(BM_findNodes)->DenseRange(8, 20, 4);
+
+// Lookups of existing nodes in the unique table, all of them hits
+void BM_uniqueLookup(benchmark::State &state) {
+    ProbeManager mgr;
+    std::vector<BDD_ID> vars = createVars(mgr, static_cast<size_t>(state.range(0)));
+    BDD_ID f = randomFunction(mgr, vars, 8 * vars.size());
+    std::set<BDD_ID> found;
+    mgr.findNodes(f, found);
+    std::vector<std::array<BDD_ID, 3>> nodes;
+    for (BDD_ID id : found) {
+        if (id > TrueId) {
+            nodes.push_back({mgr.topVar(id), mgr.coFactorTrue(id), mgr.coFactorFalse(id)});
+        }
+    }
+    // Random order, a walk in creation order would be friendlier to the caches than real workloads
+    std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1));
+    for (auto _ : state) {
+        for (const auto &node : nodes) {
+            benchmark::DoNotOptimize(mgr.makeNode(node[0], node[1], node[2]));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(nodes.size()));
+    state.counters["nodes"] = static_cast<double>(nodes.size());
+}
+BENCHMARK(BM_uniqueLookup)->DenseRange(8, 20, 4);
+
+} // namespace
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    // Recorded in the JSON output, so result files of different commits and configurations can be told apart
+    benchmark::AddCustomContext("revision", CLASSPROJECT_REVISION);
+    benchmark::AddCustomContext("usecache", std::to_string(CLASSPROJECT_USECACHE));
+    benchmark::AddCustomContext("stats", std::to_string(CLASSPROJECT_STATS));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
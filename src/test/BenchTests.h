@@ -0,0 +1,487 @@
+//
+// Tests of the bench tool chain: circuit generators, lexer, parser and netlist cache
+//
+
+#ifndef VDSPROJECT_BENCHTESTS_H
+#define VDSPROJECT_BENCHTESTS_H
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "../Manager.h"
+#include "CircuitGenerator.hpp"
+#include "CircuitToBDD.hpp"
+
+namespace ClassProject::BenchTest {
+
+/**
+ * @brief Value of a BDD under an assignment of its variables by label
+ */
+inline bool evaluate(ManagerInterface &mgr, BDD_ID f, const std::map<std::string, bool> &values) {
+    while (!mgr.isConstant(f)) {
+        f = values.at(mgr.getTopVarName(f)) ? mgr.coFactorTrue(f) : mgr.coFactorFalse(f);
+    }
+    return f == mgr.True();
+}
+
+/**
+ * @brief Assignment of the operand bits a0.., b0.. of a generated circuit
+ */
+inline std::map<std::string, bool> operands(unsigned n, unsigned a, unsigned b) {
+    std::map<std::string, bool> values;
+    for (unsigned i = 0; i < n; i++) {
+        values["a" + std::to_string(i)] = (a >> i) & 1u;
+        values["b" + std::to_string(i)] = (b >> i) & 1u;
+    }
+    return values;
+}
+
+/**
+ * @brief Bench file in the working directory, removed with its netlist cache when the test ends
+ */
+class BenchFile {
+public:
+    BenchFile(std::string path, const std::string &text) : path(std::move(path)) {
+        std::ofstream out(this->path, std::ios::binary);
+        out << text;
+    }
+    BenchFile(const BenchFile &) = delete;
+    BenchFile &operator=(const BenchFile &) = delete;
+    ~BenchFile() {
+        std::remove(path.c_str());
+        std::remove((path + ".vdsn").c_str());
+    }
+
+    const std::string &Path() const { return path; }
+
+private:
+    std::string path;
+};
+
+/**
+ * @brief Expects the lexer to fail at the given position with the given message
+ */
+inline void expectLexerError(const std::string &text, size_t line, size_t column, const std::string &message) {
+    BenchFile file("lexer_error.bench", text);
+    try {
+        BenchLexer lexer(file.Path());
+        ADD_FAILURE() << "no error for " << text;
+    } catch (const BenchParseError &e) {
+        EXPECT_EQ(e.Line(), line) << text;
+        EXPECT_EQ(e.Column(), column) << text;
+        EXPECT_EQ(e.Message(), message) << text;
+        EXPECT_EQ(std::string(e.what()),
+                  file.Path() + ":" + std::to_string(line) + ":" + std::to_string(column) + ": " + message);
+    }
+}
+
+const InputOrder AllOrders[] = {InputOrder::Good, InputOrder::Bad, InputOrder::Random};
+
+/**
+ * @brief Writes a netlist as bench file and builds it with VDSProject_bench's tool chain
+ * @return number of nodes of the manager
+ */
+inline size_t buildFromBench(const Netlist &netlist, VariableOrder order) {
+    std::string bench_file = netlist.Name() + ".bench";
+    {
+        std::ofstream out(bench_file);
+        netlist.WriteBench(out);
+    }
+    auto manager = std::make_shared<Manager>();
+    {
+        BenchParser parser(bench_file);
+        CircuitToBDD circuit_to_bdd(manager);
+        circuit_to_bdd.SetVariableOrder(order);
+        circuit_to_bdd.GenerateBDD(parser.GetSortedCircuit(), bench_file);
+    }
+    std::remove(bench_file.c_str());
+    std::filesystem::remove_all("results_" + netlist.Name());
+    return manager->uniqueTableSize();
+}
+
+TEST(CircuitGeneratorTest, adderTruthTable) {
+    for (unsigned n = 1; n <= 4; n++) {
+        for (InputOrder order : AllOrders) {
+            Netlist netlist = CircuitGenerator::Adder(n, order);
+            Manager mgr;
+            auto outputs = netlist.Build(mgr);
+            ASSERT_EQ(outputs.size(), n + 1);
+            for (unsigned a = 0; a < (1u << n); a++) {
+                for (unsigned b = 0; b < (1u << n); b++) {
+                    auto values = operands(n, a, b);
+                    for (unsigned i = 0; i <= n; i++) {
+                        EXPECT_EQ(evaluate(mgr, outputs[i].second, values), bool(((a + b) >> i) & 1u))
+                            << netlist.Name() << " " << a << " + " << b << " bit " << i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(CircuitGeneratorTest, comparatorTruthTable) {
+    for (unsigned n = 1; n <= 4; n++) {
+        for (InputOrder order : AllOrders) {
+            Netlist netlist = CircuitGenerator::Comparator(n, order);
+            Manager mgr;
+            auto outputs = netlist.Build(mgr);
+            ASSERT_EQ(outputs.size(), 2);
+            for (unsigned a = 0; a < (1u << n); a++) {
+                for (unsigned b = 0; b < (1u << n); b++) {
+                    auto values = operands(n, a, b);
+                    EXPECT_EQ(evaluate(mgr, outputs[0].second, values), a < b) << netlist.Name() << " " << a << " < " << b;
+                    EXPECT_EQ(evaluate(mgr, outputs[1].second, values), a == b) << netlist.Name() << " " << a << " == " << b;
+                }
+            }
+        }
+    }
+}
+
+TEST(CircuitGeneratorTest, parityTruthTable) {
+    for (unsigned n = 1; n <= 7; n++) {
+        for (InputOrder order : AllOrders) {
+            Netlist netlist = CircuitGenerator::Parity(n, order);
+            Manager mgr;
+            auto outputs = netlist.Build(mgr);
+            ASSERT_EQ(outputs.size(), 1);
+            for (unsigned x = 0; x < (1u << n); x++) {
+                std::map<std::string, bool> values;
+                bool parity = false;
+                for (unsigned i = 0; i < n; i++) {
+                    values["x" + std::to_string(i)] = (x >> i) & 1u;
+                    parity ^= (x >> i) & 1u;
+                }
+                EXPECT_EQ(evaluate(mgr, outputs[0].second, values), parity) << netlist.Name() << " " << x;
+            }
+        }
+    }
+}
+
+TEST(CircuitGeneratorTest, multiplexerTruthTable) {
+    for (unsigned k = 1; k <= 3; k++) {
+        Netlist netlist = CircuitGenerator::Multiplexer(k, InputOrder::Good);
+        Manager mgr;
+        auto outputs = netlist.Build(mgr);
+        ASSERT_EQ(outputs.size(), 1);
+        unsigned data_count = 1u << k;
+        for (unsigned x = 0; x < (1u << (k + data_count)); x++) {
+            std::map<std::string, bool> values;
+            unsigned select = x & (data_count - 1);
+            for (unsigned i = 0; i < k; i++) {
+                values["s" + std::to_string(i)] = (select >> i) & 1u;
+            }
+            for (unsigned j = 0; j < data_count; j++) {
+                values["d" + std::to_string(j)] = (x >> (k + j)) & 1u;
+            }
+            EXPECT_EQ(evaluate(mgr, outputs[0].second, values), values["d" + std::to_string(select)]) << netlist.Name();
+        }
+    }
+}
+
+TEST(CircuitGeneratorTest, benchKeepsDeclaredOrder) {
+    for (InputOrder order : {InputOrder::Good, InputOrder::Bad}) {
+        Netlist netlist = CircuitGenerator::Adder(6, order);
+        Manager direct;
+        netlist.Build(direct);
+        EXPECT_EQ(buildFromBench(netlist, VariableOrder::Declared), direct.uniqueTableSize()) << netlist.Name();
+    }
+    // The orders differ, in the file as well as in the built BDDs
+    EXPECT_LT(buildFromBench(CircuitGenerator::Adder(6, InputOrder::Good), VariableOrder::Declared),
+              buildFromBench(CircuitGenerator::Adder(6, InputOrder::Bad), VariableOrder::Declared));
+}
+
+TEST(BenchLexerTest, errorPositions) {
+    expectLexerError("INPUT(a)\nINPUT(b)\nc = FOO(a, b)\n", 3, 5, "unknown gate type 'FOO'");
+    expectLexerError("INPUT(a\nINPUT(b)\n", 1, 8, "expected ')', found the end of the line");
+    expectLexerError("INPUT(a)\nb = NOT(a\n", 2, 10, "expected ',' or ')' after the input label, found the end of the line");
+    expectLexerError("INPUT(a)\nb = AND(a", 2, 10, "expected ',' or ')' after the input label, found the end of the file");
+    expectLexerError("INPUT(a)\nINPUT(b)\nc = NOT(a, b)\n", 3, 5, "NOT takes exactly one input");
+    expectLexerError("INPUT(a)\nc = NAND(a)\n", 2, 5, "NAND takes at least two inputs");
+    expectLexerError("INPUT(a)\n  INPUTS(b)\n", 2, 3, "expected INPUT or OUTPUT before '(', found 'INPUTS'");
+    expectLexerError("INPUT(a, b)\n", 1, 8, "expected ')', found ','");
+    expectLexerError("INPUT(a)\nOUTPUT(a) = b\n", 2, 11, "expected the end of the line, found '='");
+    expectLexerError("INPUT()\n", 1, 7, "expected a label, found ')'");
+    expectLexerError("INPUT(a)\nb AND(a, a)\n", 2, 3, "expected '=' after the gate label, found 'A'");
+}
+
+TEST(BenchLexerTest, lineEndingsAndComments) {
+    BenchFile file("lexer_lines.bench",
+                   "# header\r\n"
+                   "\r\n"
+                   "INPUT(a)\r\n"
+                   "  INPUT( b )  # second input\r\n"
+                   "c = AND(a, b)# and\r\n"
+                   "\t\n"
+                   "d = NOT(c)\n"
+                   "OUTPUT(d)");
+    BenchLexer lexer(file.Path());
+
+    const auto &statements = lexer.Statements();
+    ASSERT_EQ(statements.size(), 5);
+    EXPECT_EQ(statements[0].type, GateType::Input);
+    EXPECT_EQ(statements[1].type, GateType::Input);
+    EXPECT_EQ(statements[2].type, GateType::And);
+    EXPECT_EQ(statements[3].type, GateType::Not);
+    EXPECT_EQ(statements[4].type, GateType::Output);
+    std::vector<uint32_t> lines;
+    for (const auto &statement : statements) {
+        lines.push_back(statement.line);
+    }
+    EXPECT_EQ(lines, (std::vector<uint32_t>{3, 4, 5, 7, 8}));
+
+    // No carriage return or blank ends up in a label
+    const LabelTable &labels = lexer.Labels();
+    ASSERT_EQ(labels.Size(), 4);
+    EXPECT_EQ(labels.Label(statements[1].label), "b");
+    EXPECT_EQ(labels.Label(statements[4].label), "d");
+    EXPECT_EQ(statements[2].input_count, 2);
+    EXPECT_EQ(labels.Label(lexer.Inputs()[statements[2].first_input]), "a");
+    EXPECT_EQ(labels.Label(lexer.Inputs()[statements[2].first_input + 1]), "b");
+}
+
+TEST(BenchLexerTest, labelsInOrderOfFirstOccurrence) {
+    BenchFile file("lexer_labels.bench",
+                   "INPUT(x)\n"
+                   "OUTPUT(y)\n"
+                   "y = AND(z, x, w)\n"
+                   "z = NOT(x)\n"
+                   "w = XOR(z, y_)\n"
+                   "y_ = BUFF(x)\n");
+    BenchLexer lexer(file.Path());
+
+    const LabelTable &labels = lexer.Labels();
+    std::vector<std::string> interned;
+    for (uint32_t id = 0; id < labels.Size(); id++) {
+        interned.emplace_back(labels.Label(id));
+    }
+    EXPECT_EQ(interned, (std::vector<std::string>{"x", "y", "z", "w", "y_"}));
+    uint32_t id;
+    ASSERT_TRUE(labels.Find("w", id));
+    EXPECT_EQ(id, 3);
+    EXPECT_FALSE(labels.Find("v", id));
+    EXPECT_EQ(lexer.Inputs(), (std::vector<uint32_t>{2, 0, 3, 0, 2, 4, 0}));
+}
+
+/**
+ * @brief Bench text of a circuit whose gates reuse labels from all over the file
+ */
+inline std::string chunkedCircuit(unsigned gates) {
+    std::string text = "# circuit for chunked scanning\n";
+    for (unsigned i = 0; i < 8; i++) {
+        text += "INPUT(in" + std::to_string(i) + ")\n";
+    }
+    for (unsigned i = 0; i < gates; i++) {
+        std::string a = i < 2 ? "in" + std::to_string(i) : "g" + std::to_string(i - 1);
+        std::string b = "in" + std::to_string(i % 8);
+        std::string c = i < 3 ? "in7" : "g" + std::to_string(i / 3);
+        text += "g" + std::to_string(i) + " = " + (i % 2 ? "NAND" : "XOR") + "(" + a + ", " + b + ", " + c + ")";
+        text += i % 5 ? "\n" : "  # note\r\n";
+        if (i % 97 == 0) {
+            text += "\n";
+        }
+    }
+    text += "OUTPUT(g" + std::to_string(gates - 1) + ")";
+    return text;
+}
+
+TEST(BenchLexerTest, chunksMatchOneThread) {
+    BenchFile file("lexer_chunks.bench", chunkedCircuit(3000));
+    BenchLexer single(file.Path(), 1);
+    for (unsigned threads : {2u, 3u, 8u}) {
+        BenchLexer chunked(file.Path(), threads, 256);
+
+        ASSERT_EQ(chunked.Statements().size(), single.Statements().size()) << threads;
+        for (size_t i = 0; i < single.Statements().size(); i++) {
+            const BenchStatement &expected = single.Statements()[i];
+            const BenchStatement &actual = chunked.Statements()[i];
+            EXPECT_EQ(actual.type, expected.type) << threads << " " << i;
+            EXPECT_EQ(actual.label, expected.label) << threads << " " << i;
+            EXPECT_EQ(actual.first_input, expected.first_input) << threads << " " << i;
+            EXPECT_EQ(actual.input_count, expected.input_count) << threads << " " << i;
+            EXPECT_EQ(actual.line, expected.line) << threads << " " << i;
+        }
+        EXPECT_EQ(chunked.Inputs(), single.Inputs()) << threads;
+        ASSERT_EQ(chunked.Labels().Size(), single.Labels().Size()) << threads;
+        for (uint32_t id = 0; id < single.Labels().Size(); id++) {
+            EXPECT_EQ(chunked.Labels().Label(id), single.Labels().Label(id)) << threads << " " << id;
+        }
+    }
+}
+
+TEST(BenchLexerTest, errorInLaterChunk) {
+    std::string text = chunkedCircuit(3000);
+    // Break a gate near the end of the file, far behind the first chunk
+    size_t at = text.find("g2900 = ");
+    ASSERT_NE(at, std::string::npos);
+    text.replace(at + 8, 3, "FOO");
+    size_t line = 1 + std::count(text.begin(), text.begin() + at, '\n');
+    BenchFile file("lexer_chunk_error.bench", text);
+
+    for (unsigned threads : {1u, 2u, 8u}) {
+        try {
+            BenchLexer lexer(file.Path(), threads, 256);
+            ADD_FAILURE() << "no error with " << threads << " threads";
+        } catch (const BenchParseError &e) {
+            EXPECT_EQ(e.Line(), line) << threads;
+            EXPECT_EQ(e.Column(), 9) << threads;
+            EXPECT_EQ(e.Message().rfind("unknown gate type 'FOO", 0), 0) << e.what();
+        }
+    }
+}
+
+/**
+ * @brief Message of the exception parsing the text throws
+ */
+inline std::string parseError(const std::string &text) {
+    BenchFile file("parser_error.bench", text);
+    try {
+        BenchParser parser(file.Path());
+    } catch (const std::runtime_error &e) {
+        return e.what();
+    }
+    return "";
+}
+
+TEST(BenchParserTest, cycleIsReported) {
+    const std::string prefix = "The circuit must be cycle free! Cycle: ";
+    std::string message = parseError("INPUT(a)\n"
+                                     "OUTPUT(out)\n"
+                                     "x = AND(a, z)\n"
+                                     "y = NOT(x)\n"
+                                     "z = OR(y, a)\n"
+                                     "out = NAND(y, a)\n");
+    ASSERT_EQ(message.rfind(prefix, 0), 0) << message;
+    std::string cycle = message.substr(prefix.size());
+    // The cycle may be entered at any of its gates, but it is followed in the direction of the signals
+    EXPECT_TRUE(cycle == "x -> y -> z -> x" || cycle == "y -> z -> x -> y" || cycle == "z -> x -> y -> z") << cycle;
+
+    EXPECT_EQ(parseError("INPUT(a)\nOUTPUT(g)\ng = AND(g, a)\n"), prefix + "g -> g");
+}
+
+/**
+ * @brief Runs the task on a thread with the given stack size
+ */
+inline void runWithStack(size_t stack_bytes, const std::function<void()> &task) {
+    pthread_attr_t attributes;
+    ASSERT_EQ(pthread_attr_init(&attributes), 0);
+    ASSERT_EQ(pthread_attr_setstacksize(&attributes, stack_bytes), 0);
+    pthread_t thread;
+    auto run = [](void *argument) -> void * {
+        (*static_cast<const std::function<void()> *>(argument))();
+        return nullptr;
+    };
+    ASSERT_EQ(pthread_create(&thread, &attributes, run, const_cast<std::function<void()> *>(&task)), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+}
+
+TEST(BenchParserTest, deepChainOnSmallStack) {
+    const unsigned depth = 200000;
+    std::string text = "INPUT(g0)\nOUTPUT(g" + std::to_string(depth) + ")\n";
+    for (unsigned i = 1; i <= depth; i++) {
+        text += "g" + std::to_string(i) + " = " + (i % 2 ? "NOT" : "BUFF") + "(g" + std::to_string(i - 1) + ")\n";
+    }
+    BenchFile file("parser_chain.bench", text);
+
+    size_t nodes = 0;
+    std::string error;
+    // Recursing once per gate would need several MB of stack
+    runWithStack(size_t(256) << 10, [&]() {
+        try {
+            BenchParser parser(file.Path());
+            nodes = parser.GetSortedCircuit().Size();
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+    });
+    EXPECT_EQ(error, "");
+    EXPECT_EQ(nodes, depth + 2);
+}
+
+/**
+ * @brief Parses the file with the netlist cache and returns the type of a gate, and whether the cache was used
+ */
+inline GateType typeWithCache(const std::string &bench_file, const std::string &gate, bool &from_cache) {
+    testing::internal::CaptureStdout();
+    GateType type;
+    {
+        BenchParser parser(bench_file, 1, true);
+        const CircuitGraph &circuit = parser.GetSortedCircuit();
+        uint32_t node = circuit.Find(gate);
+        EXPECT_NE(node, CircuitGraph::None) << gate;
+        type = node == CircuitGraph::None ? GateType::Input : circuit.Type(node);
+    }
+    std::string log = testing::internal::GetCapturedStdout();
+    from_cache = log.find("Loading netlist cache") != std::string::npos && log.find("Out of date!") == std::string::npos;
+    return type;
+}
+
+/**
+ * @brief Overwrites bytes of a file in place
+ */
+inline void patchFile(const std::string &path, size_t offset, const std::string &bytes) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+TEST(BenchParserTest, netlistCache) {
+    BenchFile file("parser_cache.bench", "INPUT(a)\nINPUT(b)\nOUTPUT(d)\nc = AND(a, b)\nd = NOT(c)\n");
+    std::string cache_file = file.Path() + ".vdsn";
+    bool from_cache;
+
+    // Fresh: parsed and cached, then loaded
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::And);
+    EXPECT_FALSE(from_cache);
+    ASSERT_TRUE(std::filesystem::exists(cache_file));
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::And);
+    EXPECT_TRUE(from_cache);
+
+    // Touched only: the hash matches, the cache stays valid
+    auto mtime = std::filesystem::last_write_time(file.Path());
+    std::filesystem::last_write_time(file.Path(), mtime + std::chrono::seconds(10));
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::And);
+    EXPECT_TRUE(from_cache);
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::And);
+    EXPECT_TRUE(from_cache);
+
+    // Same size, other content: parsed again
+    patchFile(file.Path(), std::string("INPUT(a)\nINPUT(b)\nOUTPUT(d)\nc = ").size(), "NOR");
+    std::filesystem::last_write_time(file.Path(), mtime + std::chrono::seconds(20));
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::Nor);
+    EXPECT_FALSE(from_cache);
+    EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::Nor);
+    EXPECT_TRUE(from_cache);
+
+    // Damaged: a gate type, a label ID or a fanin out of range is parsed again, and the cache rewritten.
+    // The arrays follow the 32 byte header and the 6 counts, each padded to 8 bytes.
+    const size_t types_offset = 32 + 6 * 8;
+    const size_t label_ids_offset = types_offset + 8;
+    const size_t fanins_offset = label_ids_offset + 5 * 4 + 4 + 6 * 4;
+    const std::string invalid_id(4, '\xff');
+    for (auto [offset, bytes] : {std::make_pair(types_offset + 2, std::string(1, '\x7f')),
+                                 std::make_pair(label_ids_offset + 4, invalid_id),
+                                 std::make_pair(fanins_offset, invalid_id)}) {
+        patchFile(cache_file, offset, bytes);
+        EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::Nor) << offset;
+        EXPECT_FALSE(from_cache) << offset;
+        EXPECT_EQ(typeWithCache(file.Path(), "c", from_cache), GateType::Nor) << offset;
+        EXPECT_TRUE(from_cache) << offset;
+    }
+}
+
+} // namespace ClassProject::BenchTest
+
+#endif
@@ -16,6 +16,13 @@
 
 #include "config.h"
 #include "../Manager.h"
+#include "../BddSerializer.h"
+#include "../Tracer.h"
+
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <thread>
 
 #define EXPECT_NODE_EQ(node1, topvar, hsuc, lsuc) EXPECT_EQ((node1), ::ClassProject::Test::ManagerImpl::Node((topvar), (hsuc), (lsuc)))
 #define EXPECT_NODE_NE(node1, topvar, hsuc, lsuc) EXPECT_FALSE(node1 == ::ClassProject::Test::ManagerImpl::Node((topvar), (hsuc), (lsuc)))
@@ -36,11 +43,15 @@ public:
     ManagerImpl() : Manager() {}
 
     /**
-     * @brief Returns the uniqueTable member of the Manager class
+     * @brief Returns the uniqueTable member of the Manager class as a map
      * @return std::unordered_map<BDD_ID, Node> uniqueTable
      */
     auto getMap() {
-        return uniqueTable;
+        std::unordered_map<BDD_ID, Node> map;
+        for (BDD_ID id = 0; id < nextID; id++) {
+            map.emplace(id, getNode(id));
+        }
+        return map;
     }
 #if CLASSPROJECT_USECACHE == 1
     auto getCacheIte() {
@@ -822,6 +833,732 @@ TEST_F(ManagerTest, uniqueTableSize) {
     EXPECT_EQ(mgr->uniqueTableSize(), mgr->getMap().size());
 }
 
+TEST_F(ManagerTest, NodeBudget) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    ResourceLimits limits;
+    limits.maxNodes = 6;
+    mgr->setLimits(limits);
+
+    // a * b fits into the budget, (a * b) + c needs two more nodes
+    BDD_ID f1 = mgr->and2(a, b);
+    EXPECT_EQ(mgr->uniqueTableSize(), 6);
+    EXPECT_THROW(mgr->or2(f1, c), BudgetExceeded);
+
+    // The manager stays usable and already existing nodes are still found
+    EXPECT_EQ(mgr->and2(a, b), f1);
+    limits.maxNodes = 0;
+    mgr->setLimits(limits);
+    BDD_ID f2 = mgr->or2(f1, c);
+    EXPECT_EQ(mgr->topVar(f2), a);
+    EXPECT_EQ(mgr->coFactorFalse(f2), c);
+}
+
+TEST_F(ManagerTest, MemoryBudget) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    ResourceLimits limits;
+    limits.maxMemory = mgr->estimatedMemory();
+    mgr->setLimits(limits);
+
+    try {
+        mgr->xor2(a, b);
+        FAIL() << "Expected BudgetExceeded";
+    } catch (const BudgetExceeded &e) {
+        EXPECT_EQ(e.reason(), BudgetExceeded::Reason::Memory);
+    }
+    EXPECT_EQ(mgr->getLimits().maxMemory, limits.maxMemory);
+}
+
+TEST_F(ManagerTest, BreadthFirstEngine) {
+    // Build the same functions with both engines and compare the BDDs structurally
+    ManagerImpl bfs;
+    bfs.setApplyEngine(ApplyEngine::BreadthFirst);
+    EXPECT_EQ(bfs.getApplyEngine(), ApplyEngine::BreadthFirst);
+    EXPECT_EQ(mgr->getApplyEngine(), ApplyEngine::DepthFirst);
+
+    std::function<bool(BDD_ID, BDD_ID)> equal = [&](BDD_ID f, BDD_ID g) {
+        if (mgr->isConstant(f) || bfs.isConstant(g)) {
+            return f == g;
+        }
+        return mgr->getTopVarName(f) == bfs.getTopVarName(g)
+            && equal(mgr->coFactorTrue(f), bfs.coFactorTrue(g))
+            && equal(mgr->coFactorFalse(f), bfs.coFactorFalse(g));
+    };
+
+    std::vector<BDD_ID> dfsVars, bfsVars;
+    for (int i = 0; i < 6; i++) {
+        dfsVars.push_back(mgr->createVar("x" + std::to_string(i)));
+        bfsVars.push_back(bfs.createVar("x" + std::to_string(i)));
+    }
+    // (x0 ^ x3) * (x1 + x4) + !(x2 * x5)
+    BDD_ID f1 = mgr->or2(mgr->and2(mgr->xor2(dfsVars[0], dfsVars[3]), mgr->or2(dfsVars[1], dfsVars[4])), mgr->nand2(dfsVars[2], dfsVars[5]));
+    BDD_ID g1 = bfs.or2(bfs.and2(bfs.xor2(bfsVars[0], bfsVars[3]), bfs.or2(bfsVars[1], bfsVars[4])), bfs.nand2(bfsVars[2], bfsVars[5]));
+    EXPECT_TRUE(equal(f1, g1));
+    // ite(x5 ^ x0, f1, x1 xnor x2)
+    BDD_ID f2 = mgr->ite(mgr->xor2(dfsVars[5], dfsVars[0]), f1, mgr->xnor2(dfsVars[1], dfsVars[2]));
+    BDD_ID g2 = bfs.ite(bfs.xor2(bfsVars[5], bfsVars[0]), g1, bfs.xnor2(bfsVars[1], bfsVars[2]));
+    EXPECT_TRUE(equal(f2, g2));
+    EXPECT_EQ(mgr->uniqueTableSize(), bfs.uniqueTableSize());
+
+    // Results are canonical within a manager, independent of the engine
+    bfs.setApplyEngine(ApplyEngine::DepthFirst);
+    EXPECT_EQ(bfs.or2(bfs.and2(bfs.xor2(bfsVars[0], bfsVars[3]), bfs.or2(bfsVars[1], bfsVars[4])), bfs.nand2(bfsVars[2], bfsVars[5])), g1);
+}
+
+TEST_F(ManagerTest, compact) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID f1 = mgr->or2(mgr->and2(a, b), c); // a * b + c
+    mgr->xor2(mgr->xor2(a, b), c);           // garbage
+    BDD_ID f2 = mgr->and2(b, c);
+    EXPECT_GT(mgr->uniqueTableSize(), 9);
+
+    std::vector<BDD_ID> roots{f1, f2, a};
+    mgr->compact(roots);
+
+    // Terminals, 3 variables, f1 = a ? (b + c) : c with b + c = b ? 1 : c, f2 = b ? c : 0
+    EXPECT_EQ(mgr->uniqueTableSize(), 8);
+    EXPECT_EQ(mgr->getMap().size(), 8);
+    EXPECT_EQ(roots[2], 2);
+    EXPECT_EQ(mgr->createVar("a"), 2);
+    EXPECT_EQ(mgr->createVar("b"), 3);
+    EXPECT_EQ(mgr->createVar("c"), 4);
+    a = 2; b = 3; c = 4;
+
+    // Successors are stored before their parents
+    f1 = roots[0];
+    f2 = roots[1];
+    EXPECT_EQ(mgr->topVar(f1), a);
+    EXPECT_EQ(mgr->coFactorFalse(f1), c);
+    EXPECT_LT(mgr->coFactorTrue(f1), f1);
+    EXPECT_EQ(mgr->topVar(mgr->coFactorTrue(f1)), b);
+    EXPECT_EQ(mgr->coFactorTrue(mgr->coFactorTrue(f1)), mgr->True());
+    EXPECT_EQ(mgr->coFactorFalse(mgr->coFactorTrue(f1)), c);
+    EXPECT_NODE_EQ(mgr->getMap().at(f2), b, c, mgr->False());
+
+    // The manager keeps working on the compacted tables
+    EXPECT_EQ(mgr->or2(mgr->and2(a, b), c), f1);
+    EXPECT_EQ(mgr->and2(c, b), f2);
+    EXPECT_EQ(mgr->uniqueTableSize(), 9); // a * b is rebuilt
+    EXPECT_EQ(mgr->getTopVarName(f1), "a");
+
+    std::vector<BDD_ID> invalid{100};
+    EXPECT_THROW(mgr->compact(invalid), std::out_of_range);
+}
+
+TEST_F(ManagerTest, CopyConstructor) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID f1 = mgr->and2(a, b);
+
+    // The copy must compute on its own tables, not on the ones of the original
+    Manager copy(*mgr);
+    EXPECT_EQ(copy.uniqueTableSize(), 5);
+    EXPECT_EQ(copy.and2(a, b), f1);
+    BDD_ID f2 = copy.or2(a, b);
+    EXPECT_EQ(copy.uniqueTableSize(), 6);
+    EXPECT_EQ(mgr->uniqueTableSize(), 5);
+    EXPECT_EQ(copy.topVar(f2), a);
+
+    Manager moved(std::move(copy));
+    EXPECT_EQ(moved.xor2(a, b), 7);
+    EXPECT_EQ(moved.uniqueTableSize(), 8);
+    EXPECT_EQ(mgr->uniqueTableSize(), 5);
+}
+
+TEST_F(ManagerTest, fork) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID f1 = mgr->and2(a, b);
+
+    Manager child = mgr->fork();
+    EXPECT_EQ(child.uniqueTableSize(), 6);
+    // The caches of a small fork start at the initial size of the policy
+    EXPECT_EQ(child.stats().iteCacheCapacity, mgr->getCachePolicy().entries);
+    EXPECT_LT(child.memoryBreakdown().total(), size_t(1) << 20);
+    EXPECT_EQ(child.createVar("c"), c);
+
+    // Shared nodes are found, new nodes go into the overlay of the child only
+    EXPECT_EQ(child.and2(a, b), f1);
+    BDD_ID g1 = child.or2(f1, c);
+    EXPECT_EQ(child.uniqueTableSize(), 8);
+    EXPECT_EQ(mgr->uniqueTableSize(), 6);
+    EXPECT_EQ(child.topVar(g1), a);
+    EXPECT_EQ(child.coFactorFalse(g1), c);
+
+    // The parent keeps working on the shared nodes and can be forked again
+    BDD_ID f2 = mgr->xor2(a, c);
+    EXPECT_EQ(mgr->getMap().at(f1).high, b);
+    Manager grandchild = mgr->fork();
+    EXPECT_EQ(grandchild.xor2(a, c), f2);
+    EXPECT_EQ(grandchild.and2(a, b), f1);
+    EXPECT_EQ(grandchild.uniqueTableSize(), mgr->uniqueTableSize());
+    EXPECT_THROW(child.topVar(100), std::out_of_range);
+
+    // Compaction copies the shared nodes into the own tables
+    std::vector<BDD_ID> roots{g1};
+    child.compact(roots);
+    EXPECT_EQ(child.topVar(roots[0]), a);
+    EXPECT_EQ(child.coFactorFalse(roots[0]), c);
+}
+
+TEST_F(ManagerTest, snapshot) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID f1 = mgr->and2(a, b);
+    BDD_ID f2 = mgr->or2(f1, c);
+    mgr->fork(); // part of the nodes in a shared segment
+    BDD_ID f3 = mgr->xor2(f2, a);
+
+    const std::string path = "snapshot_test.snap";
+    mgr->saveSnapshot(path, {{"f2", f2}, {"f3", f3}});
+    std::vector<std::pair<std::string, BDD_ID>> roots;
+    Manager mapped = Manager::mapSnapshot(path, &roots);
+    ASSERT_EQ(roots.size(), 2);
+    EXPECT_EQ(roots[1].first, "f3");
+    EXPECT_EQ(roots[1].second, f3);
+    EXPECT_EQ(mapped.uniqueTableSize(), mgr->uniqueTableSize());
+    EXPECT_EQ(mapped.getTopVarName(f2), "a");
+    EXPECT_EQ(mapped.createVar("c"), c);
+
+    // Mapped nodes are found through the index, new nodes go into the heap overlay
+    EXPECT_EQ(mapped.and2(a, b), f1);
+    EXPECT_EQ(mapped.xor2(f2, a), f3);
+    EXPECT_EQ(mapped.uniqueTableSize(), mgr->uniqueTableSize());
+    BDD_ID g = mapped.and2(f3, c);
+    EXPECT_EQ(mapped.uniqueTableSize(), mgr->uniqueTableSize() + 1);
+    EXPECT_EQ(mapped.or2(g, mapped.and2(f3, mapped.neg(c))), f3);
+    std::remove(path.c_str());
+
+    std::ofstream invalid(path, std::ios::binary);
+    invalid << "VDSSNAP";
+    invalid.close();
+    EXPECT_THROW(Manager::mapSnapshot(path), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(Manager::mapSnapshot(path), std::runtime_error);
+}
+
+TEST_F(ManagerTest, snapshotDamaged) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID f = mgr->and2(a, b);
+
+    const std::string path = "snapshot_damaged_test.snap";
+    mgr->saveSnapshot(path, {{"f", f}});
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    auto word = [&](const std::string &content, size_t i) {
+        uint64_t value;
+        std::memcpy(&value, content.data() + i * sizeof(uint64_t), sizeof(value));
+        return value;
+    };
+    auto setWord = [&](std::string &content, size_t i, uint64_t value) {
+        std::memcpy(&content[i * sizeof(uint64_t)], &value, sizeof(value));
+    };
+    auto write = [&](const std::string &content) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+    // Header words: magic, version, nodeCount, levelCount, indexSize, ...
+    uint64_t nodeCount = word(bytes, 2), levelCount = word(bytes, 3), indexSize = word(bytes, 4);
+    size_t nodes = 8, index = nodes + 3 * nodeCount + 3 * levelCount;
+
+    // An index without empty slots and without the node looked up must not be probed forever
+    std::string full = bytes;
+    for (size_t i = 0; i < indexSize; i++) {
+        setWord(full, index + i, 1);
+    }
+    write(full);
+    {
+        Manager mapped = Manager::mapSnapshot(path);
+        BDD_ID g = mapped.and2(a, b);
+        EXPECT_EQ(mapped.topVar(g), a);
+        EXPECT_EQ(mapped.coFactorTrue(g), b);
+        EXPECT_EQ(mapped.coFactorFalse(g), mapped.False());
+    }
+
+    // Children out of range, self-loops and back-edges, variables that are no variables, broken terminals
+    size_t last = nodes + 3 * (nodeCount - 1);
+    std::vector<std::pair<size_t, uint64_t>> damages{
+        {last + 1, nodeCount + 5}, {last + 1, nodeCount - 1}, {last + 2, nodeCount - 1},
+        {nodes + 3 * 2 + 2, 3}, {last, nodeCount - 1}, {last, 0}, {last, nodeCount + 5}, {nodes + 3 + 1, 0}};
+    size_t labels = index + indexSize, roots = labels + 3 * word(bytes, 5);
+    damages.emplace_back(labels + 2, word(bytes, 7) + 1);
+    damages.emplace_back(roots + 2, word(bytes, 7) + 1);
+    std::vector<std::pair<std::string, BDD_ID>> mappedRoots;
+    for (auto [i, value] : damages) {
+        std::string damaged = bytes;
+        setWord(damaged, i, value);
+        write(damaged);
+        EXPECT_THROW(Manager::mapSnapshot(path, &mappedRoots), std::runtime_error) << i << " " << value;
+    }
+    // Strings whose end wraps around when the length is added to the offset
+    for (size_t string : {labels, roots}) {
+        std::string wrapped = bytes;
+        setWord(wrapped, string + 1, UINT64_MAX - 1);
+        setWord(wrapped, string + 2, 4);
+        write(wrapped);
+        EXPECT_THROW(Manager::mapSnapshot(path, &mappedRoots), std::runtime_error) << string;
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(ManagerTest, operationLog) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID f = mgr->and2(a, b);
+
+    const std::string path = "operation_log_test.log";
+    mgr->startRecording(path);
+    EXPECT_THROW(mgr->startRecording(path), std::logic_error);
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID g = mgr->xor2(f, c);
+    Checkpoint token = mgr->checkpoint();
+    mgr->nor2(g, mgr->neg(a));
+    mgr->rollback(token);
+    std::vector<BDD_ID> roots{g};
+    mgr->compact(roots);
+    BDD_ID h = mgr->ite(roots[0], mgr->coFactorTrue(roots[0], mgr->topVar(roots[0])), mgr->neg(roots[0]));
+    // Existing nodes (a, b, f), createVar, xor2, checkpoint, neg, nor2, rollback, compact, coFactorTrue, neg, ite
+    EXPECT_EQ(mgr->stopRecording(), 13);
+
+    // The log replays on empty managers with any engine, the structural checksums agree
+    Manager dfs;
+    ReplayResult first = OperationReplayer::replay(path, dfs);
+    Manager bfs;
+    bfs.setApplyEngine(ApplyEngine::BreadthFirst);
+    ReplayResult second = OperationReplayer::replay(path, bfs, true);
+    EXPECT_EQ(first.operations, 13);
+    EXPECT_EQ(second.operations, 13);
+    EXPECT_NE(first.checksum, 0);
+    EXPECT_EQ(first.checksum, second.checksum);
+    EXPECT_EQ(dfs.uniqueTableSize(), mgr->uniqueTableSize());
+    EXPECT_EQ(dfs.getTopVarName(h), mgr->getTopVarName(h));
+
+    // Recording is not copied
+    mgr->startRecording(path);
+    Manager copy(*mgr);
+    EXPECT_EQ(copy.stopRecording(), 0);
+    mgr->or2(a, b);
+    EXPECT_GT(mgr->stopRecording(), 0);
+    std::remove(path.c_str());
+
+    std::ofstream invalid(path, std::ios::binary);
+    invalid << "VDSB";
+    invalid.close();
+    Manager empty;
+    EXPECT_THROW(OperationReplayer::replay(path, empty), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_F(ManagerTest, fileBackedNodeStore) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID f1 = mgr->and2(a, b);
+    mgr->setNodeStore(".");
+
+    // The existing nodes are moved into the file-backed store
+    EXPECT_EQ(mgr->uniqueTableSize(), 5);
+    EXPECT_EQ(mgr->and2(a, b), f1);
+    std::vector<BDD_ID> vars{a, b};
+    for (int i = 0; i < 8; i++) {
+        vars.push_back(mgr->createVar("x" + std::to_string(i)));
+    }
+    mgr->setApplyEngine(ApplyEngine::BreadthFirst);
+    BDD_ID f2 = mgr->False();
+    for (size_t i = 0; i + 1 < vars.size(); i += 2) {
+        f2 = mgr->or2(f2, mgr->and2(vars[i], vars[i + 1]));
+    }
+    Manager child = mgr->fork();
+    BDD_ID g = child.xor2(f2, f1);
+    EXPECT_EQ(child.coFactorFalse(g, a), child.coFactorFalse(f2, a));
+
+    Checkpoint token = mgr->checkpoint();
+    mgr->xor2(f2, vars.back());
+    mgr->rollback(token);
+    std::vector<BDD_ID> roots{f2};
+    mgr->compact(roots);
+    f2 = roots[0];
+
+    // Back into the heap
+    mgr->setNodeStore("");
+    EXPECT_EQ(mgr->ite(mgr->createVar("a"), mgr->coFactorTrue(f2, mgr->createVar("a")), mgr->coFactorFalse(f2, mgr->createVar("a"))), f2);
+    EXPECT_THROW(mgr->setNodeStore("/nonexistent-directory"), std::runtime_error);
+}
+
+TEST_F(ManagerTest, nodeStoreForksOnThreads) {
+    std::vector<BDD_ID> vars;
+    for (int i = 0; i < 12; i++) {
+        vars.push_back(mgr->createVar("x" + std::to_string(i)));
+    }
+    mgr->setNodeStore(".");
+
+    // Both forks allocate from the shared store at the same time
+    std::vector<Manager> forks;
+    forks.push_back(mgr->fork());
+    forks.push_back(mgr->fork());
+    std::vector<BDD_ID> forward(2), backward(2);
+    auto build = [&](size_t i) {
+        Manager &fork = forks[i];
+        for (int round = 0; round < 20; round++) {
+            std::vector<BDD_ID> roots;
+            fork.compact(roots);
+            BDD_ID f = fork.False();
+            BDD_ID g = fork.False();
+            for (size_t v = 0; v < vars.size(); v++) {
+                f = fork.xor2(f, fork.and2(vars[v], vars[(v + i + 1) % vars.size()]));
+                g = fork.xor2(g, fork.and2(vars[vars.size() - 1 - v], vars[(2 * vars.size() - v + i) % vars.size()]));
+            }
+            forward[i] = f;
+            backward[i] = g;
+        }
+    };
+    std::thread first(build, 0);
+    std::thread second(build, 1);
+    first.join();
+    second.join();
+    EXPECT_EQ(forward[0], backward[0]);
+    EXPECT_EQ(forward[1], backward[1]);
+}
+
+TEST_F(ManagerTest, stats) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    mgr->resetStats();
+    mgr->and2(a, b);
+    mgr->and2(a, b);
+
+    ManagerStats stats = mgr->stats();
+    EXPECT_EQ(stats.nodes, 5);
+    EXPECT_EQ(stats.peakNodes, 5);
+    EXPECT_GE(stats.uniqueChainMax, 1);
+#if CLASSPROJECT_STATS == 1 && CLASSPROJECT_USECACHE == 1
+    EXPECT_EQ(stats.iteCalls, 2);
+    EXPECT_EQ(stats.iteExpansions, 1);
+    EXPECT_EQ(stats.iteCacheHits, 1);
+    EXPECT_EQ(stats.iteCacheMisses, 1);
+    EXPECT_EQ(stats.uniqueLookups, 1);
+    EXPECT_EQ(stats.uniqueHits, 0);
+    EXPECT_EQ(stats.nodesCreated, 1);
+    EXPECT_EQ(stats.maxDepth, 1);
+#endif
+
+    std::ostringstream json;
+    stats.writeJson(json);
+    EXPECT_NE(json.str().find("\"nodes\": 5"), std::string::npos);
+
+    mgr->clear();
+    EXPECT_EQ(mgr->stats().nodesCreated, 0);
+    EXPECT_EQ(mgr->stats().peakNodes, 2);
+}
+
+TEST_F(ManagerTest, statsOfBothEngines) {
+    // The same operation on managers with the same nodes and cached results, once with each engine
+    std::vector<BDD_ID> vars;
+    for (int i = 0; i < 6; i++) {
+        vars.push_back(mgr->createVar("x" + std::to_string(i)));
+    }
+    BDD_ID f = mgr->xor2(mgr->xor2(vars[0], vars[2]), mgr->xor2(vars[4], vars[1]));
+    BDD_ID g = mgr->or2(mgr->and2(vars[3], vars[5]), mgr->and2(vars[1], vars[2]));
+    ManagerImpl bfs(*mgr);
+    bfs.setApplyEngine(ApplyEngine::BreadthFirst);
+    mgr->resetStats();
+    bfs.resetStats();
+    mgr->and2(mgr->xnor2(f, g), mgr->or2(f, vars[3]));
+    bfs.and2(bfs.xnor2(f, g), bfs.or2(f, vars[3]));
+
+    ManagerStats dfsStats = mgr->stats(), bfsStats = bfs.stats();
+    EXPECT_EQ(bfsStats.nodes, dfsStats.nodes);
+#if CLASSPROJECT_STATS == 1 && CLASSPROJECT_USECACHE == 1
+    // Every breadth-first request counts as a call, a miss is a request that is expanded
+    EXPECT_GT(bfsStats.iteCalls, 3);
+    EXPECT_EQ(bfsStats.iteCalls, dfsStats.iteCalls);
+    EXPECT_EQ(bfsStats.iteExpansions, dfsStats.iteExpansions);
+    EXPECT_EQ(bfsStats.iteCacheMisses, bfsStats.iteExpansions);
+    EXPECT_EQ(dfsStats.iteCacheMisses, dfsStats.iteExpansions);
+#endif
+}
+
+TEST_F(ManagerTest, memoryBreakdown) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("a_variable_with_a_long_label");
+    mgr->and2(a, b);
+
+    MemoryBreakdown breakdown = mgr->memoryBreakdown();
+    auto find = [&](const std::string &name) {
+        for (const auto &structure : breakdown.structures) {
+            if (structure.name == name) {
+                return structure;
+            }
+        }
+        ADD_FAILURE() << name << " missing";
+        return StructureMemory();
+    };
+    EXPECT_EQ(find("uniqueTable").entries, 5);
+    EXPECT_GE(find("uniqueTable").slots, 5);
+    EXPECT_EQ(find("reverseTable").entries, 5);
+    EXPECT_EQ(find("labelTable").entries, 4);
+    EXPECT_GT(find("reverseTable").loadFactor, 0);
+    EXPECT_EQ(find("uniqueTable").location, "heap");
+#if CLASSPROJECT_USECACHE == 1
+    EXPECT_EQ(find("iteCache").entries, 1);
+#endif
+    // The own structures of the breakdown are what the memory budget is checked against
+    size_t own = find("uniqueTable").bytes + find("reverseTable").bytes;
+#if CLASSPROJECT_USECACHE == 1
+    own += find("iteCache").bytes + find("coTrueCache").bytes + find("coFalseCache").bytes;
+#endif
+    EXPECT_EQ(mgr->estimatedMemory(), own);
+    EXPECT_GE(breakdown.total(), own);
+
+    std::ostringstream json;
+    breakdown.writeJson(json);
+    EXPECT_NE(json.str().find("\"name\": \"reverseTable\""), std::string::npos);
+
+    Manager child = mgr->fork();
+    EXPECT_EQ(child.memoryBreakdown().structures.back().name, "sharedSegments");
+}
+
+TEST_F(ManagerTest, levelProfile) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID f = mgr->and2(a, c);
+    BDD_ID g = mgr->and2(b, c);
+    BDD_ID h = mgr->and2(f, b);
+
+    LevelProfile profile = mgr->levelProfile({f, g, mgr->True()});
+    EXPECT_EQ(profile.vars, std::vector<BDD_ID>({a, b, c}));
+    EXPECT_EQ(profile.roots[0], std::vector<size_t>({1, 0, 0}));
+    EXPECT_EQ(profile.roots[1], std::vector<size_t>({0, 1, 0}));
+    EXPECT_EQ(profile.roots[2], std::vector<size_t>({0, 0, 0}));
+    EXPECT_EQ(profile.shared, std::vector<size_t>({0, 0, 1}));
+    EXPECT_EQ(profile.total, std::vector<size_t>({1, 1, 1}));
+    EXPECT_EQ(profile.nodes(), 3);
+
+    // Totals only, without a row per root
+    LevelProfile totals = mgr->levelProfile({f, g, mgr->True()}, false);
+    EXPECT_EQ(totals.vars, profile.vars);
+    EXPECT_EQ(totals.total, profile.total);
+    EXPECT_TRUE(totals.roots.empty());
+    EXPECT_TRUE(totals.shared.empty());
+
+    // A root reaching the nodes of an earlier root turns all of them into shared nodes
+    profile = mgr->levelProfile({g, h, f});
+    EXPECT_EQ(profile.roots[0], std::vector<size_t>({0, 0, 0}));
+    EXPECT_EQ(profile.roots[1], std::vector<size_t>({1, 0, 0}));
+    EXPECT_EQ(profile.roots[2], std::vector<size_t>({1, 0, 0}));
+    EXPECT_EQ(profile.shared, std::vector<size_t>({0, 1, 1}));
+    EXPECT_EQ(profile.total, std::vector<size_t>({2, 1, 1}));
+
+    std::ostringstream csv;
+    profile.writeCsv(csv, {"g", "h", "f"}, *mgr);
+    EXPECT_EQ(csv.str(), "h,0,a,1\nf,0,a,1\nshared,1,b,1\nshared,2,c,1\ntotal,0,a,2\ntotal,1,b,1\ntotal,2,c,1\n");
+}
+
+TEST_F(ManagerTest, adaptiveCacheSizing) {
+    CachePolicy policy;
+    policy.entries = 10;
+    mgr->setCachePolicy(policy);
+    EXPECT_EQ(mgr->getCachePolicy().entries, 16);
+    EXPECT_EQ(mgr->stats().iteCacheCapacity, 16);
+
+    // x0 y0 + x1 y1 + ... with all x before all y needs exponentially many nodes
+    std::vector<BDD_ID> x, y;
+    for (int i = 0; i < 15; i++) {
+        x.push_back(mgr->createVar("x" + std::to_string(i)));
+    }
+    for (int i = 0; i < 15; i++) {
+        y.push_back(mgr->createVar("y" + std::to_string(i)));
+    }
+    BDD_ID f = mgr->False();
+    for (int i = 0; i < 15; i++) {
+        f = mgr->or2(f, mgr->and2(x[i], y[i]));
+    }
+    EXPECT_GT(mgr->uniqueTableSize(), 65536);
+    EXPECT_GT(mgr->stats().iteCacheCapacity, 16);
+#if CLASSPROJECT_STATS == 1
+    ASSERT_FALSE(mgr->stats().cacheResizes.empty());
+    EXPECT_EQ(mgr->stats().cacheResizes.back().cache, "ite");
+#endif
+
+    // Kept when the nodes are dropped, so the next circuit of the same size starts with it
+    size_t grown = mgr->stats().iteCacheCapacity;
+    mgr->clear();
+    EXPECT_EQ(mgr->stats().iteCacheCapacity, grown);
+    EXPECT_EQ(mgr->stats().iteCacheEntries, 0);
+    for (int i = 0; i < 15; i++) {
+        EXPECT_EQ(mgr->createVar("x" + std::to_string(i)), x[i]);
+    }
+    for (int i = 0; i < 15; i++) {
+        EXPECT_EQ(mgr->createVar("y" + std::to_string(i)), y[i]);
+    }
+    f = mgr->False();
+    for (int i = 0; i < 15; i++) {
+        f = mgr->or2(f, mgr->and2(x[i], y[i]));
+    }
+    EXPECT_EQ(mgr->stats().iteCacheCapacity, grown);
+
+    // A fixed size is kept
+    policy.adaptive = false;
+    mgr->setCachePolicy(policy);
+    f = mgr->False();
+    for (int i = 0; i < 12; i++) {
+        f = mgr->xor2(f, mgr->createVar("x" + std::to_string(i)));
+    }
+    EXPECT_EQ(mgr->stats().iteCacheCapacity, 16);
+}
+
+TEST_F(ManagerTest, tracer) {
+    { TraceSpan ignored("ignored", "test"); }
+    Tracer::enable();
+    {
+        TraceSpan span("span", "test", "detail \"quoted\"");
+        Tracer::counter("counter", 42);
+    }
+    std::vector<BDD_ID> roots{mgr->and2(mgr->createVar("a"), mgr->createVar("b"))};
+    mgr->compact(roots);
+    Tracer::disable();
+    Tracer::counter("ignored", 1);
+
+    std::ostringstream trace;
+    Tracer::write(trace);
+    Tracer::clear();
+    std::string json = trace.str();
+    EXPECT_EQ(json.find("ignored"), std::string::npos);
+    EXPECT_NE(json.find("\"name\": \"span\", \"pid\": 1"), std::string::npos);
+    EXPECT_NE(json.find("\"ph\": \"X\", \"cat\": \"test\""), std::string::npos);
+    EXPECT_NE(json.find("\"detail\": \"detail \\\"quoted\\\"\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\": \"C\", \"args\": {\"value\": 42}"), std::string::npos);
+    EXPECT_NE(json.find("\"name\": \"compact\""), std::string::npos);
+
+    // Hours into a trace the timestamps keep their nanoseconds
+    Tracer::complete("late", "test", 2400000123456ull, 2400000124999ull);
+    std::ostringstream late;
+    Tracer::write(late);
+    Tracer::clear();
+    EXPECT_NE(late.str().find("\"ts\": 2400000123.456, \"ph\": \"X\", \"cat\": \"test\", \"dur\": 1.543"), std::string::npos);
+}
+
+TEST_F(ManagerTest, checkpointRollback) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID f1 = mgr->and2(a, b);
+
+    Checkpoint outer = mgr->checkpoint();
+    BDD_ID c = mgr->createVar("c");
+    mgr->or2(f1, c);
+    Checkpoint inner = mgr->checkpoint();
+    mgr->xor2(a, c);
+    EXPECT_GT(mgr->uniqueTableSize(), 8);
+
+    // Rolling back the outer checkpoint also closes the inner one
+    mgr->rollback(outer);
+    EXPECT_EQ(mgr->uniqueTableSize(), 5);
+    EXPECT_EQ(mgr->getMap().size(), 5);
+    EXPECT_THROW(mgr->rollback(inner), std::logic_error);
+    EXPECT_THROW(mgr->commit(outer), std::logic_error);
+
+    // Dropped nodes and cache entries are rebuilt from scratch with the same IDs
+    EXPECT_EQ(mgr->and2(a, b), f1);
+    EXPECT_EQ(mgr->createVar("c"), c);
+    BDD_ID f2 = mgr->or2(f1, c);
+    EXPECT_EQ(mgr->topVar(f2), a);
+    EXPECT_EQ(mgr->coFactorFalse(f2), c);
+
+    // Committed nodes are kept
+    Checkpoint kept = mgr->checkpoint();
+    BDD_ID f3 = mgr->xor2(a, c);
+    mgr->commit(kept);
+    EXPECT_EQ(mgr->xor2(a, c), f3);
+    EXPECT_EQ(mgr->coFactorTrue(f3, a), mgr->neg(c));
+
+    // Nodes shared with a fork can not be rolled back
+    Checkpoint shared = mgr->checkpoint();
+    mgr->nor2(a, b);
+    Manager child = mgr->fork();
+    EXPECT_THROW(mgr->rollback(shared), std::logic_error);
+}
+
+TEST_F(ManagerTest, clear) {
+    mgr->reserve(100, 10);
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    mgr->xor2(a, b);
+    Checkpoint token = mgr->checkpoint();
+    EXPECT_GT(mgr->uniqueTableSize(), 4);
+
+    mgr->clear();
+    auto map = mgr->getMap();
+    EXPECT_EQ(mgr->uniqueTableSize(), 2);
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_NODE_EQ(map.at(mgr->False()), 0, 0, 0);
+    EXPECT_NODE_EQ(map.at(mgr->True()), 1, 1, 1);
+    EXPECT_EQ(mgr->getTopVarName(mgr->True()), "True");
+    EXPECT_THROW(mgr->rollback(token), std::logic_error);
+
+    // Variables and nodes are numbered from scratch, no stale cache entry is returned
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID d = mgr->createVar("d");
+    EXPECT_EQ(c, 2);
+    EXPECT_EQ(d, 3);
+    BDD_ID f1 = mgr->and2(c, d);
+    EXPECT_EQ(f1, 4);
+    EXPECT_NODE_EQ(mgr->getMap().at(f1), c, d, mgr->False());
+    EXPECT_EQ(mgr->getTopVarName(f1), "c");
+}
+
+TEST_F(ManagerTest, BinarySerialization) {
+    BDD_ID a = mgr->createVar("a");
+    BDD_ID b = mgr->createVar("b");
+    BDD_ID c = mgr->createVar("c");
+    BDD_ID f1 = mgr->or2(mgr->and2(a, b), c);
+    BDD_ID f2 = mgr->xor2(f1, b);
+
+    std::stringstream buffer;
+    BddWriter writer(buffer, *mgr);
+    writer.write("f1", f1);
+    writer.write("f2", f2);
+    writer.write("one", mgr->True());
+    writer.finish();
+
+    // Load into a manager with the reverse variable order
+    Manager other;
+    BDD_ID c2 = other.createVar("c");
+    BDD_ID b2 = other.createVar("b");
+    BDD_ID a2 = other.createVar("a");
+    auto roots = BddReader::read(buffer, other);
+    ASSERT_EQ(roots.size(), 3);
+    EXPECT_EQ(roots[0].first, "f1");
+    EXPECT_EQ(roots[0].second, other.or2(other.and2(a2, b2), c2));
+    EXPECT_EQ(roots[1].first, "f2");
+    EXPECT_EQ(roots[1].second, other.xor2(roots[0].second, b2));
+    EXPECT_EQ(roots[2].second, other.True());
+
+    // Load into an empty manager, the same nodes are rebuilt
+    buffer.clear();
+    buffer.seekg(0);
+    Manager copy;
+    roots = BddReader::read(buffer, copy);
+    BDD_ID a3 = copy.createVar("a");
+    BDD_ID b3 = copy.createVar("b");
+    BDD_ID c3 = copy.createVar("c");
+    EXPECT_EQ(roots[0].second, copy.or2(copy.and2(a3, b3), c3));
+    EXPECT_EQ(roots[1].second, copy.xor2(roots[0].second, b3));
+
+    std::stringstream invalid("VDSX");
+    EXPECT_THROW(BddReader::read(invalid, copy), std::runtime_error);
+    std::string truncated = buffer.str().substr(0, buffer.str().size() - 5);
+    std::stringstream truncatedBuffer(truncated);
+    EXPECT_THROW(BddReader::read(truncatedBuffer, copy), std::runtime_error);
+}
+
 #if CLASSPROJECT_VISUALIZE == 1
 TEST_F(ManagerTest, printTable) {
     // Capture cout output
@@ -4,6 +4,9 @@
 
 
 #include "Tests.h"
+#if CLASSPROJECT_BENCH_TESTS == 1
+#include "BenchTests.h"
+#endif
 
 int main(int argc, char* argv[])
 {